@@ -628,6 +628,8 @@ DeepCopyPointerClasses(DeviceIntPtr from, DeviceIntPtr to)
                     TouchInitTouchPoint(to->touch, to->valuator, i);
                 if (!to->touch)
                     FatalError("[Xi] no memory for class shift.\n");
+                TouchIdMapInit(&to->touch->client_ids,
+                               to->touch->num_touches);
             }
             else
                 classes->touch = NULL;
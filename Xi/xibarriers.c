@@ -68,8 +68,8 @@ static DevPrivateKeyRec BarrierScreenPrivateKeyRec;
 typedef struct PointerBarrierClient *PointerBarrierClientPtr;
 
 struct PointerBarrierDevice {
-    struct xorg_list entry;
-    int deviceid;
+    struct xorg_list entry;     /* in BarrierScreenRec.hits while hit */
+    struct PointerBarrierClient *barrier;
     Time last_timestamp;
     int barrier_event_id;
     int release_event_id;
@@ -83,61 +83,55 @@ struct PointerBarrierClient {
     Window window;
     struct PointerBarrier barrier;
     struct xorg_list entry;
+    /* creation order, the newest barrier wins a tie in distance */
+    CARD32 serial;
     /* num_devices/device_ids are devices the barrier applies to */
     int num_devices;
     int *device_ids; /* num_devices */
 
-    /* per_device keeps track of devices actually blocked by barriers */
-    struct xorg_list per_device;
+    /* per_device keeps track of devices actually blocked by barriers,
+     * indexed by the master pointer's id */
+    struct PointerBarrierDevice per_device[MAXDEVICES];
 };
 
 typedef struct _BarrierScreen {
     struct xorg_list barriers;
+    struct BarrierIndex index;
+    /* per device id, the barriers that device is currently hitting */
+    struct xorg_list hits[MAXDEVICES];
 } BarrierScreenRec, *BarrierScreenPtr;
 
 #define GetBarrierScreen(s) ((BarrierScreenPtr)dixLookupPrivate(&(s)->devPrivates, BarrierScreenPrivateKey))
 #define GetBarrierScreenIfSet(s) GetBarrierScreen(s)
 #define SetBarrierScreen(s,p) dixSetPrivate(&(s)->devPrivates, BarrierScreenPrivateKey, p)
 
-static struct PointerBarrierDevice *AllocBarrierDevice(void)
-{
-    struct PointerBarrierDevice *pbd = NULL;
-
-    pbd = malloc(sizeof(struct PointerBarrierDevice));
-    if (!pbd)
-        return NULL;
+static CARD32 barrier_serial;
 
-    pbd->deviceid = -1; /* must be set by caller */
+static void InitBarrierDevice(struct PointerBarrierDevice *pbd,
+                              struct PointerBarrierClient *c)
+{
+    pbd->barrier = c;
     pbd->barrier_event_id = 1;
     pbd->release_event_id = 0;
     pbd->hit = FALSE;
     pbd->seen = FALSE;
     xorg_list_init(&pbd->entry);
-
-    return pbd;
 }
 
 static void FreePointerBarrierClient(struct PointerBarrierClient *c)
 {
-    struct PointerBarrierDevice *pbd = NULL, *tmp = NULL;
+    int i;
 
-    xorg_list_for_each_entry_safe(pbd, tmp, &c->per_device, entry) {
-        free(pbd);
-    }
+    /* unlink from the screen's hit lists */
+    for (i = 0; i < MAXDEVICES; i++)
+        xorg_list_del(&c->per_device[i].entry);
     free(c);
 }
 
 static struct PointerBarrierDevice *GetBarrierDevice(struct PointerBarrierClient *c, int deviceid)
 {
-    struct PointerBarrierDevice *pbd = NULL;
-
-    xorg_list_for_each_entry(pbd, &c->per_device, entry) {
-        if (pbd->deviceid == deviceid)
-            break;
-    }
-
-    BUG_WARN(!pbd);
-    return pbd;
+    BUG_RETURN_VAL(deviceid < 0 || deviceid >= MAXDEVICES, NULL);
+    return &c->per_device[deviceid];
 }
 
 static BOOL
@@ -152,6 +146,109 @@ barrier_is_vertical(const struct PointerBarrier *barrier)
     return barrier->x1 == barrier->x2;
 }
 
+/* the x of a vertical, the y of a horizontal barrier */
+static int
+barrier_position(const struct PointerBarrier *barrier)
+{
+    return barrier_is_vertical(barrier) ? barrier->x1 : barrier->y1;
+}
+
+static struct BarrierAxis *
+barrier_index_axis(struct BarrierIndex *index,
+                   const struct PointerBarrier *barrier)
+{
+    return barrier_is_vertical(barrier) ? &index->vertical : &index->horizontal;
+}
+
+/* index of the first barrier on the axis at v or later */
+static int
+barrier_axis_lower_bound(const struct BarrierAxis *axis, int v)
+{
+    int lo = 0, hi = axis->num;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+
+        if (barrier_position(axis->barriers[mid]) < v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Find the barriers on the axis that sit between v1 and v2, both
+ * included. A motion from v1 to v2 along the axis can only cross those.
+ *
+ * @param[out] first Index of the first barrier in the range
+ * @param[out] last Index after the last barrier in the range
+ */
+void
+barrier_axis_range(const struct BarrierAxis *axis, int v1, int v2,
+                   int *first, int *last)
+{
+    *first = barrier_axis_lower_bound(axis, min(v1, v2));
+    *last = barrier_axis_lower_bound(axis, max(v1, v2) + 1);
+}
+
+/**
+ * Add the barrier to the index. It must be vertical or horizontal, and
+ * must not change position while in the index.
+ *
+ * @return FALSE if the index could not grow
+ */
+Bool
+barrier_index_add(struct BarrierIndex *index, struct PointerBarrier *barrier)
+{
+    struct BarrierAxis *axis = barrier_index_axis(index, barrier);
+    int i;
+
+    if (axis->num == axis->size) {
+        int size = axis->size ? axis->size * 2 : 16;
+        struct PointerBarrier **barriers;
+
+        barriers = realloc(axis->barriers, size * sizeof(*barriers));
+        if (!barriers)
+            return FALSE;
+        axis->barriers = barriers;
+        axis->size = size;
+    }
+
+    i = barrier_axis_lower_bound(axis, barrier_position(barrier) + 1);
+    memmove(&axis->barriers[i + 1], &axis->barriers[i],
+            (axis->num - i) * sizeof(*axis->barriers));
+    axis->barriers[i] = barrier;
+    axis->num++;
+    return TRUE;
+}
+
+void
+barrier_index_remove(struct BarrierIndex *index,
+                     struct PointerBarrier *barrier)
+{
+    struct BarrierAxis *axis = barrier_index_axis(index, barrier);
+    int i;
+
+    for (i = barrier_axis_lower_bound(axis, barrier_position(barrier));
+         i < axis->num; i++) {
+        if (axis->barriers[i] == barrier) {
+            axis->num--;
+            memmove(&axis->barriers[i], &axis->barriers[i + 1],
+                    (axis->num - i) * sizeof(*axis->barriers));
+            return;
+        }
+    }
+}
+
+void
+barrier_index_free(struct BarrierIndex *index)
+{
+    free(index->vertical.barriers);
+    free(index->horizontal.barriers);
+    memset(index, 0, sizeof(*index));
+}
+
 /**
  * @return The set of barrier movement directions the movement vector
  * x1/y1 → x2/y2 represents.
@@ -314,28 +411,27 @@ barrier_blocks_device(struct PointerBarrierClient *client,
 }
 
 /**
- * Find the nearest barrier client that is blocking movement from x1/y1 to x2/y2.
- *
- * @param dir Only barriers blocking movement in direction dir are checked
- * @param x1 X start coordinate of movement vector
- * @param y1 Y start coordinate of movement vector
- * @param x2 X end coordinate of movement vector
- * @param y2 Y end coordinate of movement vector
- * @return The barrier nearest to the movement origin that blocks this movement.
+ * Test the barriers on the axis that sit between v1 and v2 against the
+ * movement from x1/y1 to x2/y2, updating nearest and min_distance with
+ * any barrier closer than nearest.
  */
-static struct PointerBarrierClient *
-barrier_find_nearest(BarrierScreenPtr cs, DeviceIntPtr dev,
-                     int dir,
-                     int x1, int y1, int x2, int y2)
+static void
+barrier_find_nearest_on_axis(struct BarrierAxis *axis, int v1, int v2,
+                             DeviceIntPtr dev, int dir,
+                             int x1, int y1, int x2, int y2,
+                             struct PointerBarrierClient **nearest,
+                             double *min_distance)
 {
-    struct PointerBarrierClient *c, *nearest = NULL;
-    double min_distance = INT_MAX;      /* can't get higher than that in X anyway */
+    int first, last;
 
-    xorg_list_for_each_entry(c, &cs->barriers, entry) {
-        struct PointerBarrier *b = &c->barrier;
+    barrier_axis_range(axis, v1, v2, &first, &last);
+    for (; first < last; first++) {
+        struct PointerBarrier *b = axis->barriers[first];
+        struct PointerBarrierClient *c;
         struct PointerBarrierDevice *pbd;
         double distance;
 
+        c = container_of(b, struct PointerBarrierClient, barrier);
         pbd = GetBarrierDevice(c, dev->id);
         if (pbd->seen)
             continue;
@@ -347,12 +443,40 @@ barrier_find_nearest(BarrierScreenPtr cs, DeviceIntPtr dev,
             continue;
 
         if (barrier_is_blocking(b, x1, y1, x2, y2, &distance)) {
-            if (min_distance > distance) {
-                min_distance = distance;
-                nearest = c;
+            if (*min_distance > distance ||
+                (*min_distance == distance && *nearest &&
+                 c->serial > (*nearest)->serial)) {
+                *min_distance = distance;
+                *nearest = c;
             }
         }
     }
+}
+
+/**
+ * Find the nearest barrier client that is blocking movement from x1/y1 to x2/y2.
+ * Only vertical barriers between x1 and x2 and horizontal barriers between
+ * y1 and y2 can block it, the others are never looked at.
+ *
+ * @param dir Only barriers blocking movement in direction dir are checked
+ * @param x1 X start coordinate of movement vector
+ * @param y1 Y start coordinate of movement vector
+ * @param x2 X end coordinate of movement vector
+ * @param y2 Y end coordinate of movement vector
+ * @return The barrier nearest to the movement origin that blocks this movement.
+ */
+static struct PointerBarrierClient *
+barrier_find_nearest(BarrierScreenPtr cs, DeviceIntPtr dev,
+                     int dir,
+                     int x1, int y1, int x2, int y2)
+{
+    struct PointerBarrierClient *nearest = NULL;
+    double min_distance = INT_MAX;      /* can't get higher than that in X anyway */
+
+    barrier_find_nearest_on_axis(&cs->index.vertical, x1, x2, dev, dir,
+                                 x1, y1, x2, y2, &nearest, &min_distance);
+    barrier_find_nearest_on_axis(&cs->index.horizontal, y1, y2, dev, dir,
+                                 x1, y1, x2, y2, &nearest, &min_distance);
 
     return nearest;
 }
@@ -411,6 +535,7 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
     };
     InternalEvent *barrier_events = events;
     DeviceIntPtr master;
+    struct PointerBarrierDevice *pbd, *tmp;
 
     if (nevents)
         *nevents = 0;
@@ -436,7 +561,6 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
 
     while (dir != 0) {
         int new_sequence;
-        struct PointerBarrierDevice *pbd;
 
         c = barrier_find_nearest(cs, master, dir, current_x, current_y, x, y);
         if (!c)
@@ -447,6 +571,9 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
         pbd = GetBarrierDevice(c, master->id);
         new_sequence = !pbd->hit;
 
+        /* everything seen is hit, so the loop below resets seen */
+        if (!pbd->hit)
+            xorg_list_add(&pbd->entry, &cs->hits[master->id]);
         pbd->seen = TRUE;
         pbd->hit = TRUE;
 
@@ -480,19 +607,17 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
         *nevents += 1;
     }
 
-    xorg_list_for_each_entry(c, &cs->barriers, entry) {
-        struct PointerBarrierDevice *pbd;
+    xorg_list_for_each_entry_safe(pbd, tmp, &cs->hits[master->id], entry) {
         int flags = 0;
 
-        pbd = GetBarrierDevice(c, master->id);
+        c = pbd->barrier;
         pbd->seen = FALSE;
-        if (!pbd->hit)
-            continue;
 
         if (barrier_inside_hit_box(&c->barrier, x, y))
             continue;
 
         pbd->hit = FALSE;
+        xorg_list_del(&pbd->entry);
 
         ev.type = ET_BarrierLeave;
 
@@ -548,7 +673,6 @@ CreatePointerBarrierClient(ClientPtr client,
     int i;
     struct PointerBarrierClient *ret;
     CARD16 *in_devices;
-    DeviceIntPtr dev;
 
     size = sizeof(*ret) + sizeof(DeviceIntPtr) * stuff->num_devices;
     ret = malloc(size);
@@ -557,7 +681,10 @@ CreatePointerBarrierClient(ClientPtr client,
         return BadAlloc;
     }
 
-    xorg_list_init(&ret->per_device);
+    /* Only master pointers can be blocked, but the slots are indexed by
+     * device id so a motion finds its state without a search */
+    for (i = 0; i < MAXDEVICES; i++)
+        InitBarrierDevice(&ret->per_device[i], ret);
 
     err = dixLookupWindow(&pWin, stuff->window, client, DixReadAccess);
     if (err != Success) {
@@ -596,25 +723,8 @@ CreatePointerBarrierClient(ClientPtr client,
         ret->device_ids[i] = device_id;
     }
 
-    /* Alloc one per master pointer, they're the ones that can be blocked */
-    xorg_list_init(&ret->per_device);
-    nt_list_for_each_entry(dev, inputInfo.devices, next) {
-        struct PointerBarrierDevice *pbd;
-
-        if (dev->type != MASTER_POINTER)
-            continue;
-
-        pbd = AllocBarrierDevice();
-        if (!pbd) {
-            err = BadAlloc;
-            goto error;
-        }
-        pbd->deviceid = dev->id;
-
-        xorg_list_add(&pbd->entry, &ret->per_device);
-    }
-
     ret->id = stuff->barrier;
+    ret->serial = ++barrier_serial;
     ret->barrier.x1 = stuff->x1;
     ret->barrier.x2 = stuff->x2;
     ret->barrier.y1 = stuff->y1;
@@ -626,6 +736,11 @@ CreatePointerBarrierClient(ClientPtr client,
         ret->barrier.directions &= ~(BarrierPositiveX | BarrierNegativeX);
     if (barrier_is_vertical(&ret->barrier))
         ret->barrier.directions &= ~(BarrierPositiveY | BarrierNegativeY);
+
+    if (!barrier_index_add(&cs->index, &ret->barrier)) {
+        err = BadAlloc;
+        goto error;
+    }
     xorg_list_add(&ret->entry, &cs->barriers);
 
     *client_out = ret;
@@ -689,6 +804,7 @@ BarrierFreeBarrier(void *data, XID id)
         mieqEnqueue(dev, (InternalEvent *) &ev);
     }
 
+    barrier_index_remove(&GetBarrierScreen(screen)->index, &c->barrier);
     xorg_list_del(&c->entry);
 
     FreePointerBarrierClient(c);
@@ -705,11 +821,12 @@ static void add_master_func(void *res, XID id, void *devid)
     b = res;
     barrier = container_of(b, struct PointerBarrierClient, barrier);
 
+    pbd = GetBarrierDevice(barrier, *deviceid);
+    if (!pbd)
+        return;
 
-    pbd = AllocBarrierDevice();
-    pbd->deviceid = *deviceid;
-
-    xorg_list_add(&pbd->entry, &barrier->per_device);
+    xorg_list_del(&pbd->entry);
+    InitBarrierDevice(pbd, barrier);
 }
 
 static void remove_master_func(void *res, XID id, void *devid)
@@ -730,6 +847,8 @@ static void remove_master_func(void *res, XID id, void *devid)
     barrier = container_of(b, struct PointerBarrierClient, barrier);
 
     pbd = GetBarrierDevice(barrier, *deviceid);
+    if (!pbd)
+        return;
 
     if (pbd->hit) {
         BarrierEvent ev = {
@@ -753,7 +872,7 @@ static void remove_master_func(void *res, XID id, void *devid)
     }
 
     xorg_list_del(&pbd->entry);
-    free(pbd);
+    InitBarrierDevice(pbd, barrier);
 }
 
 void XIBarrierNewMasterDevice(ClientPtr client, int deviceid)
@@ -904,11 +1023,14 @@ XIBarrierInit(void)
     for (i = 0; i < screenInfo.numScreens; i++) {
         ScreenPtr pScreen = screenInfo.screens[i];
         BarrierScreenPtr cs;
+        int j;
 
         cs = (BarrierScreenPtr) calloc(1, sizeof(BarrierScreenRec));
         if (!cs)
             return FALSE;
         xorg_list_init(&cs->barriers);
+        for (j = 0; j < MAXDEVICES; j++)
+            xorg_list_init(&cs->hits[j]);
         SetBarrierScreen(pScreen, cs);
     }
 
@@ -925,6 +1047,7 @@ XIBarrierReset(void)
     for (i = 0; i < screenInfo.numScreens; i++) {
         ScreenPtr pScreen = screenInfo.screens[i];
         BarrierScreenPtr cs = GetBarrierScreen(pScreen);
+        barrier_index_free(&cs->index);
         free(cs);
         SetBarrierScreen(pScreen, NULL);
     }
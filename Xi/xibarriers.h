@@ -26,6 +26,29 @@ void
 barrier_clamp_to_barrier(struct PointerBarrier *barrier, int dir, int *x,
                              int *y);
 
+/* the barriers of one orientation, sorted by the x or y they sit at */
+struct BarrierAxis {
+    struct PointerBarrier **barriers;
+    int num;
+    int size;
+};
+
+struct BarrierIndex {
+    struct BarrierAxis vertical;
+    struct BarrierAxis horizontal;
+};
+
+Bool
+barrier_index_add(struct BarrierIndex *index, struct PointerBarrier *barrier);
+void
+barrier_index_remove(struct BarrierIndex *index,
+                     struct PointerBarrier *barrier);
+void
+barrier_index_free(struct BarrierIndex *index);
+void
+barrier_axis_range(const struct BarrierAxis *axis, int v1, int v2,
+                   int *first, int *last);
+
 #include <xfixesint.h>
 
 int
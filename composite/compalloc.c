@@ -183,6 +183,7 @@ compRedirectWindow(ClientPtr pClient, WindowPtr pWin, int update)
             free(cw);
             return BadAlloc;
         }
+        DamageSetBatching(cw->damage, DAMAGE_BATCH_LIMIT);
 
         anyMarked = compMarkWindows(pWin, &pLayerWin);
 
@@ -201,6 +202,7 @@ compRedirectWindow(ClientPtr pClient, WindowPtr pWin, int update)
     if (!AddResource(ccw->id, CompositeClientWindowType, pWin))
         return BadAlloc;
     if (ccw->update == CompositeRedirectManual) {
+        SmartScheduleClientLatency(pClient, TRUE);
         if (!anyMarked)
             anyMarked = compMarkWindows(pWin, &pLayerWin);
 
@@ -272,8 +274,10 @@ compFreeClientWindow(WindowPtr pWin, XID id)
     for (prev = &cw->clients; (ccw = *prev); prev = &ccw->next) {
         if (ccw->id == id) {
             *prev = ccw->next;
-            if (ccw->update == CompositeRedirectManual)
+            if (ccw->update == CompositeRedirectManual) {
+                SmartScheduleClientLatency(clients[CLIENT_ID(id)], FALSE);
                 cw->update = CompositeRedirectAutomatic;
+            }
             free(ccw);
             break;
         }
@@ -406,6 +410,7 @@ compRedirectSubwindows(ClientPtr pClient, WindowPtr pWin, int update)
          * critical output
          */
         DamageExtSetCritical(pClient, TRUE);
+        SmartScheduleClientLatency(pClient, TRUE);
         pWin->inhibitBGPaint = TRUE;
     }
     return Success;
@@ -435,6 +440,7 @@ compFreeClientSubwindows(WindowPtr pWin, XID id)
                  * critical output
                  */
                 DamageExtSetCritical(pClient, FALSE);
+                SmartScheduleClientLatency(pClient, FALSE);
                 csw->update = CompositeRedirectAutomatic;
                 pWin->inhibitBGPaint = FALSE;
                 if (pWin->mapped)
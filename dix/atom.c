@@ -57,89 +57,148 @@ SOFTWARE.
 #include "dix.h"
 
 #define InitialTableSize 100
+#define InitialHashSize 256     /* must be a power of two */
 
+/*
+ * Atoms are found through an open-addressing hash table with linear
+ * probing.  Each slot keeps the full hash and the string length next to
+ * the atom, so a probe only touches the string on a likely match.
+ * nodeTable maps atoms back to their strings for NameForAtom.
+ */
 typedef struct _Node {
-    struct _Node *left, *right;
-    Atom a;
-    unsigned int fingerPrint;
     const char *string;
+    unsigned int len;
 } NodeRec, *NodePtr;
 
+typedef struct _AtomSlot {
+    unsigned int hash;
+    unsigned int len;
+    Atom a;                     /* None for an empty slot */
+} AtomSlotRec, *AtomSlotPtr;
+
 static Atom lastAtom = None;
-static NodePtr atomRoot = NULL;
 static unsigned long tableLength;
-static NodePtr *nodeTable;
+static NodePtr nodeTable;
+static AtomSlotPtr hashTable;
+static unsigned int hashMask;
+
+/* FNV-1a, with a final avalanche so the low bits are usable as an index */
+static unsigned int
+AtomHash(const char *string, unsigned len)
+{
+    unsigned int h = 2166136261U;
+    unsigned i;
+
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char) string[i];
+        h *= 16777619U;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+static AtomSlotPtr
+AtomFindSlot(AtomSlotPtr table, unsigned int mask, const char *string,
+             unsigned len, unsigned int hash)
+{
+    unsigned int i;
+
+    for (i = hash & mask;; i = (i + 1) & mask) {
+        AtomSlotPtr slot = &table[i];
 
-void FreeAtom(NodePtr patom);
+        if (slot->a == None)
+            return slot;
+        if (slot->hash == hash && slot->len == len &&
+            memcmp(nodeTable[slot->a].string, string, len) == 0)
+            return slot;
+    }
+}
+
+static Bool
+AtomGrowHash(void)
+{
+    unsigned int newMask = (hashMask << 1) | 1;
+    AtomSlotPtr table;
+    unsigned int i;
+
+    table = calloc(newMask + 1, sizeof(AtomSlotRec));
+    if (!table)
+        return FALSE;
+
+    for (i = 0; i <= hashMask; i++) {
+        AtomSlotPtr old = &hashTable[i];
+        unsigned int j;
+
+        if (old->a == None)
+            continue;
+        for (j = old->hash & newMask; table[j].a != None;
+             j = (j + 1) & newMask);
+        table[j] = *old;
+    }
+
+    free(hashTable);
+    hashTable = table;
+    hashMask = newMask;
+    return TRUE;
+}
 
 Atom
 MakeAtom(const char *string, unsigned len, Bool makeit)
 {
-    NodePtr *np;
-    unsigned i;
-    int comp;
-    unsigned int fp = 0;
+    AtomSlotPtr slot;
+    unsigned int hash;
+    const char *str;
+
+    hash = AtomHash(string, len);
+    slot = AtomFindSlot(hashTable, hashMask, string, len, hash);
+    if (slot->a != None)
+        return slot->a;
+    if (!makeit)
+        return None;
 
-    np = &atomRoot;
-    for (i = 0; i < (len + 1) / 2; i++) {
-        fp = fp * 27 + string[i];
-        fp = fp * 27 + string[len - 1 - i];
+    /* Keep the load factor at or below one half */
+    if ((lastAtom + 1) * 2 > hashMask) {
+        if (!AtomGrowHash())
+            return BAD_RESOURCE;
+        slot = AtomFindSlot(hashTable, hashMask, string, len, hash);
     }
-    while (*np != NULL) {
-        if (fp < (*np)->fingerPrint)
-            np = &((*np)->left);
-        else if (fp > (*np)->fingerPrint)
-            np = &((*np)->right);
-        else {                  /* now start testing the strings */
-            comp = strncmp(string, (*np)->string, (int) len);
-            if ((comp < 0) || ((comp == 0) && (len < strlen((*np)->string))))
-                np = &((*np)->left);
-            else if (comp > 0)
-                np = &((*np)->right);
-            else
-                return (*np)->a;
-        }
+
+    if ((lastAtom + 1) >= tableLength) {
+        NodePtr table;
+
+        table = realloc(nodeTable, tableLength * (2 * sizeof(NodeRec)));
+        if (!table)
+            return BAD_RESOURCE;
+        tableLength <<= 1;
+        nodeTable = table;
+    }
+
+    if (lastAtom < XA_LAST_PREDEFINED) {
+        str = string;
     }
-    if (makeit) {
-        NodePtr nd;
+    else {
+        char *copy;
 
-        nd = malloc(sizeof(NodeRec));
-        if (!nd)
+        /* copy all len bytes, the name may contain a NUL */
+        copy = malloc(len + 1);
+        if (!copy)
             return BAD_RESOURCE;
-        if (lastAtom < XA_LAST_PREDEFINED) {
-            nd->string = string;
-        }
-        else {
-            nd->string = strndup(string, len);
-            if (!nd->string) {
-                free(nd);
-                return BAD_RESOURCE;
-            }
-        }
-        if ((lastAtom + 1) >= tableLength) {
-            NodePtr *table;
-
-            table = realloc(nodeTable, tableLength * (2 * sizeof(NodePtr)));
-            if (!table) {
-                if (nd->string != string) {
-                    /* nd->string has been strdup'ed */
-                    free((char *) nd->string);
-                }
-                free(nd);
-                return BAD_RESOURCE;
-            }
-            tableLength <<= 1;
-            nodeTable = table;
-        }
-        *np = nd;
-        nd->left = nd->right = NULL;
-        nd->fingerPrint = fp;
-        nd->a = ++lastAtom;
-        nodeTable[lastAtom] = nd;
-        return nd->a;
+        memcpy(copy, string, len);
+        copy[len] = '\0';
+        str = copy;
     }
-    else
-        return None;
+
+    lastAtom++;
+    nodeTable[lastAtom].string = str;
+    nodeTable[lastAtom].len = len;
+    slot->hash = hash;
+    slot->len = len;
+    slot->a = lastAtom;
+    return lastAtom;
 }
 
 Bool
@@ -151,13 +210,9 @@ ValidAtom(Atom atom)
 const char *
 NameForAtom(Atom atom)
 {
-    NodePtr node;
-
-    if (atom > lastAtom)
-        return 0;
-    if ((node = nodeTable[atom]) == NULL)
+    if (atom == None || atom > lastAtom)
         return 0;
-    return node->string;
+    return nodeTable[atom].string;
 }
 
 void
@@ -166,32 +221,23 @@ AtomError(void)
     FatalError("initializing atoms");
 }
 
-void
-FreeAtom(NodePtr patom)
-{
-    if (patom->left)
-        FreeAtom(patom->left);
-    if (patom->right)
-        FreeAtom(patom->right);
-    if (patom->a > XA_LAST_PREDEFINED) {
-        /*
-         * All strings above XA_LAST_PREDEFINED are strdup'ed, so it's safe to
-         * cast here
-         */
-        free((char *) patom->string);
-    }
-    free(patom);
-}
-
 void
 FreeAllAtoms(void)
 {
-    if (atomRoot == NULL)
+    Atom a;
+
+    if (nodeTable == NULL)
         return;
-    FreeAtom(atomRoot);
-    atomRoot = NULL;
+    /*
+     * All strings above XA_LAST_PREDEFINED are strdup'ed, so it's safe to
+     * cast here
+     */
+    for (a = XA_LAST_PREDEFINED + 1; a <= lastAtom; a++)
+        free((char *) nodeTable[a].string);
     free(nodeTable);
     nodeTable = NULL;
+    free(hashTable);
+    hashTable = NULL;
     lastAtom = None;
 }
 
@@ -200,10 +246,15 @@ InitAtoms(void)
 {
     FreeAllAtoms();
     tableLength = InitialTableSize;
-    nodeTable = malloc(InitialTableSize * sizeof(NodePtr));
+    nodeTable = malloc(InitialTableSize * sizeof(NodeRec));
     if (!nodeTable)
         AtomError();
-    nodeTable[None] = NULL;
+    nodeTable[None].string = NULL;
+    nodeTable[None].len = 0;
+    hashMask = InitialHashSize - 1;
+    hashTable = calloc(InitialHashSize, sizeof(AtomSlotRec));
+    if (!hashTable)
+        AtomError();
     MakePredeclaredAtoms();
     if (lastAtom != XA_LAST_PREDEFINED)
         AtomError();
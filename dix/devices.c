@@ -797,6 +797,7 @@ FreeDeviceClass(int type, void **class)
         }
 
         free((*t)->touches);
+        TouchIdMapFree(&(*t)->client_ids);
         free((*t));
         break;
     }
@@ -985,6 +986,7 @@ CloseDevice(DeviceIntPtr dev)
     for (j = 0; j < dev->last.num_touches; j++)
         free(dev->last.touches[j].valuators);
     free(dev->last.touches);
+    TouchIdMapFree(&dev->last.touch_ids);
     dev->config_info = NULL;
     dixFreePrivates(dev->devPrivates, PRIVATE_DEVICE);
     free(dev);
@@ -1670,15 +1672,27 @@ InitTouchClassDeviceStruct(DeviceIntPtr device, unsigned int max_touches,
     touch->num_touches = max_touches;
     for (i = 0; i < max_touches; i++)
         TouchInitTouchPoint(touch, device->valuator, i);
+    TouchIdMapInit(&touch->client_ids, max_touches);
 
     touch->mode = mode;
     touch->sourceid = device->id;
 
+    /* The DDX touches are used from the signal handler and only grow
+     * after an event was dropped, leave room for fingers the device
+     * didn't announce. */
     device->touch = touch;
-    device->last.touches = calloc(max_touches, sizeof(*device->last.touches));
-    device->last.num_touches = touch->num_touches;
-    for (i = 0; i < touch->num_touches; i++)
+    device->last.num_touches = 2 * touch->num_touches;
+    device->last.touches = calloc(device->last.num_touches,
+                                  sizeof(*device->last.touches));
+    if (!device->last.touches) {
+        device->last.num_touches = 0;
+        device->touch = NULL;
+        TouchIdMapFree(&touch->client_ids);
+        goto err;
+    }
+    for (i = 0; i < device->last.num_touches; i++)
         TouchInitDDXTouchPoint(device, &device->last.touches[i]);
+    TouchIdMapInit(&device->last.touch_ids, device->last.num_touches);
 
     return TRUE;
 
@@ -128,6 +128,7 @@ int ProcInitialConnection();
 #include "xkbsrv.h"
 #include "site.h"
 #include "client.h"
+#include "reqstats.h"
 
 #ifdef XSERVER_DTRACE
 #include "registry.h"
@@ -223,6 +224,7 @@ UpdateCurrentTimeIf(void)
 /* in milliseconds */
 #define SMART_SCHEDULE_DEFAULT_INTERVAL	5
 #define SMART_SCHEDULE_MAX_SLICE	15
+#define SMART_SCHEDULE_DEFAULT_LATENCY	2
 
 #if defined(WIN32) && !defined(__CYGWIN__)
 Bool SmartScheduleDisable = TRUE;
@@ -234,6 +236,9 @@ long SmartScheduleInterval = SMART_SCHEDULE_DEFAULT_INTERVAL;
 long SmartScheduleMaxSlice = SMART_SCHEDULE_MAX_SLICE;
 long SmartScheduleTime;
 int SmartScheduleLatencyLimited = 0;
+int SmartSchedulePolicy = SMART_POLICY_CLASSIC;
+long SmartScheduleLatency = SMART_SCHEDULE_DEFAULT_LATENCY;
+static int SmartLatencyClients;
 static ClientPtr SmartLastClient;
 static int SmartLastIndex[SMART_MAX_PRIORITY - SMART_MIN_PRIORITY + 1];
 
@@ -243,6 +248,80 @@ long SmartLastPrint;
 
 void Dispatch(void);
 
+#define SmartIsLatencyClient(c) ((c)->smart_latency > 0)
+
+void
+SmartScheduleClientLatency(ClientPtr pClient, Bool latency)
+{
+    if (!pClient)
+        return;
+    if (latency) {
+        if (pClient->smart_latency++ == 0)
+            SmartLatencyClients++;
+        pClient->smart_sensitive = TRUE;
+    }
+    else if (pClient->smart_latency > 0) {
+        if (--pClient->smart_latency == 0)
+            SmartLatencyClients--;
+    }
+}
+
+/*
+ * Selection rank under the latency policy: latency-sensitive clients
+ * form a class above every bulk client, and a bulk client that has been
+ * kept waiting for several maximum slices is promoted into it so it
+ * cannot be starved outright.  Within a class the smart priority and
+ * round-robin order apply as before.
+ */
+static int
+SmartScheduleRank(ClientPtr pClient, long now)
+{
+    int rank = pClient->smart_priority;
+
+    if (SmartSchedulePolicy == SMART_POLICY_LATENCY &&
+        (SmartIsLatencyClient(pClient) ||
+         (pClient->smart_waiting &&
+          (now - pClient->smart_ready_tick) >= 4 * SmartScheduleMaxSlice)))
+        rank += SMART_MAX_PRIORITY - SMART_MIN_PRIORITY + 1;
+    return rank;
+}
+
+/*
+ * How long the chosen client may run.  While a latency-sensitive client
+ * is connected, bulk clients are held to the latency target so that one
+ * flooding client cannot delay the compositor by a whole slice.
+ */
+static long
+SmartScheduleClientSlice(ClientPtr pClient)
+{
+    if (SmartSchedulePolicy == SMART_POLICY_LATENCY && SmartLatencyClients) {
+        if (SmartIsLatencyClient(pClient))
+            return SmartScheduleMaxSlice;
+        if (SmartScheduleSlice > SmartScheduleLatency)
+            return SmartScheduleLatency;
+    }
+    return SmartScheduleSlice;
+}
+
+static void
+SmartScheduleClientGone(ClientPtr pClient)
+{
+    if (pClient->smart_latency > 0) {
+        pClient->smart_latency = 0;
+        SmartLatencyClients--;
+    }
+    if (SmartSchedulePolicy == SMART_POLICY_LATENCY && pClient->smart_slices)
+        LogMessageVerb(X_INFO, 3,
+                       "sched: client %d%s: %u requests in %u slices, "
+                       "%llu us busy, max wait %d ms\n",
+                       pClient->index,
+                       pClient->smart_sensitive ? " (latency)" : "",
+                       (unsigned) pClient->smart_requests,
+                       (unsigned) pClient->smart_slices,
+                       (unsigned long long) pClient->smart_busy,
+                       pClient->smart_max_wait);
+}
+
 static int
 SmartScheduleClient(int *clientReady, int nready)
 {
@@ -251,6 +330,7 @@ SmartScheduleClient(int *clientReady, int nready)
     int client;
     int bestPrio, best = 0;
     int bestRobin, robin;
+    int rank;
     long now = SmartScheduleTime;
     long idle;
 
@@ -265,15 +345,19 @@ SmartScheduleClient(int *clientReady, int nready)
             if (pClient->smart_priority < 0)
                 pClient->smart_priority++;
         }
+        if (!pClient->smart_waiting) {
+            pClient->smart_waiting = TRUE;
+            pClient->smart_ready_tick = now;
+        }
 
         /* check priority to select best client */
         robin =
             (pClient->index -
              SmartLastIndex[pClient->smart_priority -
                             SMART_MIN_PRIORITY]) & 0xff;
-        if (pClient->smart_priority > bestPrio ||
-            (pClient->smart_priority == bestPrio && robin > bestRobin)) {
-            bestPrio = pClient->smart_priority;
+        rank = SmartScheduleRank(pClient, now);
+        if (rank > bestPrio || (rank == bestPrio && robin > bestRobin)) {
+            bestPrio = rank;
             bestRobin = robin;
             best = client;
         }
@@ -289,7 +373,11 @@ SmartScheduleClient(int *clientReady, int nready)
     }
 #endif
     pClient = clients[best];
-    SmartLastIndex[bestPrio - SMART_MIN_PRIORITY] = pClient->index;
+    SmartLastIndex[pClient->smart_priority - SMART_MIN_PRIORITY] =
+        pClient->index;
+    if (now - pClient->smart_ready_tick > pClient->smart_max_wait)
+        pClient->smart_max_wait = now - pClient->smart_ready_tick;
+    pClient->smart_waiting = FALSE;
     /*
      * Set current client pointer
      */
@@ -342,7 +430,9 @@ Dispatch(void)
     ClientPtr client;
     int nready;
     HWEventQueuePtr *icheck = checkForInput;
-    long start_tick;
+    long start_tick, slice;
+    CARD64 start_time = 0, req_start = 0;
+    Bool timed;
 
     nextFreeClientID = 1;
     nClients = 0;
@@ -383,13 +473,19 @@ Dispatch(void)
             isItTimeToYield = FALSE;
 
             start_tick = SmartScheduleTime;
+            slice = SmartScheduleClientSlice(client);
+            /* busy time is only reported under the latency policy */
+            timed = SmartSchedulePolicy == SMART_POLICY_LATENCY;
+            if (timed)
+                start_time = GetTimeInMicros();
+            client->smart_slices++;
             while (!isItTimeToYield) {
                 if (*icheck[0] != *icheck[1])
                     ProcessInputEvents();
 
                 FlushIfCriticalOutputPending();
                 if (!SmartScheduleDisable &&
-                    (SmartScheduleTime - start_tick) >= SmartScheduleSlice) {
+                    (SmartScheduleTime - start_tick) >= slice) {
                     /* Penalize clients which consume ticks */
                     if (client->smart_priority > SMART_MIN_PRIORITY)
                         client->smart_priority--;
@@ -408,6 +504,7 @@ Dispatch(void)
                 }
 
                 client->sequence++;
+                client->smart_requests++;
                 client->majorOp = ((xReq *) client->requestBuffer)->reqType;
                 client->minorOp = 0;
                 if (client->majorOp >= EXTENSION_BASE) {
@@ -427,11 +524,16 @@ Dispatch(void)
                 if (result > (maxBigRequestSize << 2))
                     result = BadLength;
                 else {
+                    if (RequestStatsEnabled)
+                        req_start = GetTimeInMicros();
                     result = XaceHookDispatch(client, client->majorOp);
                     if (result == Success)
                         result =
                             (*client->requestVector[client->majorOp]) (client);
                     XaceHookAuditEnd(client, result);
+                    if (RequestStatsEnabled)
+                        RequestStatsRecord(client->majorOp, client->minorOp,
+                                           GetTimeInMicros() - req_start);
                 }
 #ifdef XSERVER_DTRACE
                 if (XSERVER_REQUEST_DONE_ENABLED())
@@ -453,8 +555,11 @@ Dispatch(void)
             }
             FlushAllOutput();
             client = clients[clientReady[nready]];
-            if (client)
+            if (client) {
                 client->smart_stop_tick = SmartScheduleTime;
+                if (timed)
+                    client->smart_busy += GetTimeInMicros() - start_time;
+            }
         }
         dispatchException &= ~DE_PRIORITYCHANGE;
     }
@@ -463,8 +568,13 @@ Dispatch(void)
 #endif
     KillAllClients();
     free(clientReady);
+    if (RequestStatsEnabled) {
+        RequestStatsDump();
+        RequestStatsReset();
+    }
     dispatchException &= ~DE_RESET;
     SmartScheduleLatencyLimited = 0;
+    SmartLatencyClients = 0;
     ResetOsBuffers();
 }
 
@@ -2131,8 +2241,16 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
             ReformatImage(pBuf, (int) (nlines * widthBytesLine),
                           BitsPerPixel(pDraw->depth), ClientOrder(client));
 
-            WriteToClient(client, (int) (nlines * widthBytesLine), pBuf);
             linesDone += nlines;
+            if (linesDone < height)
+                WriteToClient(client, (int) (nlines * widthBytesLine), pBuf);
+            else {
+                /* the last band is handed over, so a slow client doesn't
+                   make the os layer copy it */
+                WriteToClientAndFree(client, (int) (nlines * widthBytesLine),
+                                     pBuf);
+                pBuf = NULL;
+            }
         }
     }
     else {                      /* XYPixmap */
@@ -3382,6 +3500,7 @@ CloseDownClient(ClientPtr client)
         }
         TouchListenerGone(client->clientAsMask);
         FreeClientResources(client);
+        SmartScheduleClientGone(client);
         /* Disable client ID tracking. This must be done after
          * ClientStateCallback. */
         ReleaseClientIds(client);
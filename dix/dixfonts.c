@@ -314,8 +314,6 @@ doOpenFont(ClientPtr client, OFclosurePtr c)
         if (err == Suspended) {
             if (!ClientIsAsleep(client))
                 ClientSleep(client, (ClientSleepProcPtr) doOpenFont, c);
-            else
-                goto xinerama_sleep;
             return TRUE;
         }
         break;
@@ -363,7 +361,6 @@ doOpenFont(ClientPtr client, OFclosurePtr c)
                           c->fontid, FontToXError(err));
     }
     ClientWakeup(c->client);
- xinerama_sleep:
     for (i = 0; i < c->num_fpes; i++) {
         FreeFPE(c->fpe_list[i]);
     }
@@ -552,6 +549,63 @@ QueryFont(FontPtr pFont, xQueryFontReply * pReply, int nProtoCCIStructs)
     return;
 }
 
+/*
+ * Local FPEs never suspend, so listing a long font path, or opening
+ * every match for ListFontsWithInfo, used to hold up all other clients
+ * until the reply was done.  Once a list request has run for a
+ * scheduler interval, it goes to sleep and continues from the work
+ * queue after the other clients had their turn.
+ */
+static Bool fontListYielding = FALSE;
+
+static void
+FontListBlockHandler(void *data, struct timeval **wt, void *LastSelectMask)
+{
+    /* a list request is waiting on the work queue, don't wait for clients */
+    AdjustWaitForDelay(wt, 0);
+}
+
+static void
+FontListWakeupHandler(void *data, int result, void *LastSelectMask)
+{
+    RemoveBlockAndWakeupHandlers(FontListBlockHandler, FontListWakeupHandler,
+                                 NULL);
+    fontListYielding = FALSE;
+}
+
+/*
+ * @return TRUE if the request went to sleep and the caller should return
+ * its result: FALSE to stay on the work queue when it was already asleep,
+ * TRUE otherwise.
+ */
+static Bool
+FontListYield(ClientPtr client, ClientSleepProcPtr function, void *closure,
+              CARD32 start, Bool *result)
+{
+    if (client == serverClient ||
+        (int) (GetTimeInMillis() - start) < SmartScheduleInterval)
+        return FALSE;
+
+    if (ClientIsAsleep(client)) {
+        /* called from the work queue, ask to be called again */
+        if (!fontListYielding &&
+            RegisterBlockAndWakeupHandlers(FontListBlockHandler,
+                                           FontListWakeupHandler, NULL))
+            fontListYielding = TRUE;
+        *result = FALSE;
+        return TRUE;
+    }
+
+    if (!ClientSleep(client, function, closure))
+        return FALSE;
+    if (!ClientSignal(client)) {
+        ClientWakeup(client);
+        return FALSE;
+    }
+    *result = TRUE;
+    return TRUE;
+}
+
 static Bool
 doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
 {
@@ -567,6 +621,8 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
     char *bufptr;
     char *bufferStart;
     int aliascount = 0;
+    CARD32 start = GetTimeInMillis();
+    Bool yielded;
 
     if (client->clientGone) {
         if (c->current.current_fpe < c->num_fpes) {
@@ -581,6 +637,14 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
         goto finish;
 
     while (c->current.current_fpe < c->num_fpes) {
+        /* not in the middle of resolving an alias, that state is local */
+        if (!c->haveSaved &&
+            FontListYield(client, (ClientSleepProcPtr) doListFontsAndAliases,
+                          c, start, &yielded)) {
+            free(resolved);
+            return yielded;
+        }
+
         fpe = c->fpe_list[c->current.current_fpe];
         err = Successful;
 
@@ -596,8 +660,6 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
                 if (!ClientIsAsleep(client))
                     ClientSleep(client,
                                 (ClientSleepProcPtr) doListFontsAndAliases, c);
-                else
-                    goto xinerama_sleep;
                 return TRUE;
             }
 
@@ -623,8 +685,6 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
                         ClientSleep(client,
                                     (ClientSleepProcPtr) doListFontsAndAliases,
                                     c);
-                    else
-                        goto xinerama_sleep;
                     return TRUE;
                 }
                 if (err == Successful)
@@ -642,8 +702,6 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
                         ClientSleep(client,
                                     (ClientSleepProcPtr) doListFontsAndAliases,
                                     c);
-                    else
-                        goto xinerama_sleep;
                     return TRUE;
                 }
                 if (err == FontNameAlias) {
@@ -788,7 +846,6 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
 
  bail:
     ClientWakeup(client);
- xinerama_sleep:
     for (i = 0; i < c->num_fpes; i++)
         FreeFPE(c->fpe_list[i]);
     free(c->fpe_list);
@@ -865,6 +922,8 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
     int i;
     int aliascount = 0;
     xListFontsWithInfoReply finalReply;
+    CARD32 start = GetTimeInMillis();
+    Bool yielded;
 
     if (client->clientGone) {
         if (c->current.current_fpe < c->num_fpes) {
@@ -878,6 +937,11 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
     if (!c->current.patlen)
         goto finish;
     while (c->current.current_fpe < c->num_fpes) {
+        if (!c->haveSaved &&
+            FontListYield(client, (ClientSleepProcPtr) doListFontsWithInfo,
+                          c, start, &yielded))
+            return yielded;
+
         fpe = c->fpe_list[c->current.current_fpe];
         err = Successful;
         if (!c->current.list_started) {
@@ -888,8 +952,6 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
                 if (!ClientIsAsleep(client))
                     ClientSleep(client,
                                 (ClientSleepProcPtr) doListFontsWithInfo, c);
-                else
-                    goto xinerama_sleep;
                 return TRUE;
             }
             if (err == Successful)
@@ -905,8 +967,6 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
                 if (!ClientIsAsleep(client))
                     ClientSleep(client,
                                 (ClientSleepProcPtr) doListFontsWithInfo, c);
-                else
-                    goto xinerama_sleep;
                 return TRUE;
             }
         }
@@ -1040,7 +1100,6 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
     WriteSwappedDataToClient(client, length, &finalReply);
  bail:
     ClientWakeup(client);
- xinerama_sleep:
     for (i = 0; i < c->num_fpes; i++)
         FreeFPE(c->fpe_list[i]);
     free(c->reply);
@@ -1830,6 +1889,8 @@ void
 InitFonts(void)
 {
     patternCache = MakeFontPatternCache();
+    /* the block handlers went away with the last generation */
+    fontListYielding = FALSE;
 
     register_fpe_functions();
 }
@@ -3089,11 +3089,14 @@ CheckMotion(DeviceEvent *ev, DeviceIntPtr pDev)
  * Windows have restructured, we need to update the sprite position and the
  * sprite's cursor.
  */
+unsigned long windowTreeSerial;
+
 void
 WindowsRestructured(void)
 {
     DeviceIntPtr pDev = inputInfo.devices;
 
+    windowTreeSerial++;
     while (pDev) {
         if (IsMaster(pDev) || IsFloating(pDev))
             CheckMotion(NULL, pDev);
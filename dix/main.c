@@ -103,6 +103,7 @@ Equipment Corporation.
 #include "extnsionst.h"
 #include "privates.h"
 #include "registry.h"
+#include "reqstats.h"
 #include "client.h"
 #include "exevents.h"
 #ifdef PANORAMIX
@@ -161,6 +162,7 @@ dix_main(int argc, char *argv[], char *envp[])
         InitBlockAndWakeupHandlers();
         /* Perform any operating system dependent initializations you'd like */
         OsInit();
+        RequestStatsInit();
         if (serverGeneration == 1) {
             CreateWellKnownSockets();
             for (i = 1; i < MAXCLIENTS; i++)
@@ -262,6 +264,7 @@ dix_main(int argc, char *argv[], char *envp[])
         for (i = 0; i < screenInfo.numScreens; i++)
             InitRootWindow(screenInfo.screens[i]->root);
 
+        InputThreadInit();
         InitCoreDevices();
         InitInput(argc, argv);
         InitAndStartDevices();
@@ -329,6 +332,7 @@ dix_main(int argc, char *argv[], char *envp[])
             screenInfo.screens[i]->root = NullWindow;
 
         CloseDownDevices();
+        InputThreadFini();
 
         CloseDownEvents();
 
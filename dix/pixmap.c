@@ -188,6 +188,7 @@ PixmapStartDirtyTracking(PixmapPtr src,
         free(dirty_update);
         return FALSE;
     }
+    DamageSetBatching(dirty_update->damage, DAMAGE_BATCH_LIMIT);
 
     DamageRegister(&src->drawable, dirty_update->damage);
     xorg_list_add(&dirty_update->ent, &screen->pixmap_dirty_list);
@@ -67,6 +67,207 @@ SOFTWARE.
  *
  *****************************************************************/
 
+/*
+ * Windows with more than PROPERTY_INDEX_THRESHOLD properties get an
+ * atom-keyed index next to their property list.  The list is still the
+ * authoritative store and keeps its order for ListProperties and
+ * RotateProperties; the index only maps a name to the first property of
+ * that name in the list, i.e. the one a linear walk would find.  Security
+ * modules may polyinstantiate properties, so a name can appear more than
+ * once and the index keeps a count for each name.
+ *
+ * The index is an open-addressing hash table with linear probing.  If it
+ * cannot be allocated or grown it is simply dropped and lookups fall back
+ * to walking the list.
+ */
+#define PROPERTY_INDEX_THRESHOLD 16
+#define PROPERTY_INDEX_MIN_SIZE 64      /* must be a power of two */
+
+typedef struct _PropertyIndexSlot {
+    Atom name;                  /* None for an empty slot */
+    unsigned int count;         /* properties with this name */
+    PropertyPtr first;          /* first of them in list order */
+} PropertyIndexSlotRec, *PropertyIndexSlotPtr;
+
+typedef struct _PropertyIndex {
+    unsigned int mask;          /* number of slots - 1 */
+    unsigned int used;          /* slots in use */
+    PropertyIndexSlotPtr slots;
+} PropertyIndexRec, *PropertyIndexPtr;
+
+static inline unsigned int
+PropertyHash(Atom name)
+{
+    unsigned int h = name * 2654435761U;
+
+    return h ^ (h >> 16);
+}
+
+static PropertyIndexSlotPtr
+PropertyIndexFind(PropertyIndexPtr index, Atom name)
+{
+    unsigned int i;
+
+    for (i = PropertyHash(name) & index->mask;;
+         i = (i + 1) & index->mask) {
+        if (index->slots[i].name == name || index->slots[i].name == None)
+            return &index->slots[i];
+    }
+}
+
+static void
+PropertyIndexFree(WindowPtr pWin)
+{
+    if (pWin->optional && pWin->optional->propIndex) {
+        free(pWin->optional->propIndex->slots);
+        free(pWin->optional->propIndex);
+        pWin->optional->propIndex = NULL;
+    }
+}
+
+static Bool
+PropertyIndexResize(PropertyIndexPtr index, unsigned int size)
+{
+    PropertyIndexSlotPtr old = index->slots;
+    unsigned int oldSize = old ? index->mask + 1 : 0;
+    unsigned int i;
+
+    index->slots = calloc(size, sizeof(PropertyIndexSlotRec));
+    if (!index->slots) {
+        index->slots = old;
+        return FALSE;
+    }
+    index->mask = size - 1;
+    for (i = 0; i < oldSize; i++)
+        if (old[i].name != None)
+            *PropertyIndexFind(index, old[i].name) = old[i];
+    free(old);
+    return TRUE;
+}
+
+/* Account for a property that was just put at the head of the list */
+static Bool
+PropertyIndexAdd(PropertyIndexPtr index, PropertyPtr pProp)
+{
+    PropertyIndexSlotPtr slot;
+
+    if ((index->used + 1) * 2 > index->mask + 1 &&
+        !PropertyIndexResize(index, (index->mask + 1) * 2))
+        return FALSE;
+
+    slot = PropertyIndexFind(index, pProp->propertyName);
+    if (slot->name == None) {
+        slot->name = pProp->propertyName;
+        slot->count = 0;
+        index->used++;
+    }
+    slot->count++;
+    slot->first = pProp;
+    return TRUE;
+}
+
+static void
+PropertyIndexBuild(WindowPtr pWin)
+{
+    PropertyIndexPtr index;
+    PropertyPtr pProp, last = NULL;
+    int numProps = 0;
+
+    for (pProp = pWin->optional->userProps; pProp; pProp = pProp->next) {
+        last = pProp;
+        numProps++;
+    }
+    if (numProps <= PROPERTY_INDEX_THRESHOLD)
+        return;
+
+    index = calloc(1, sizeof(PropertyIndexRec));
+    if (!index)
+        return;
+    if (!PropertyIndexResize(index, PROPERTY_INDEX_MIN_SIZE)) {
+        free(index);
+        return;
+    }
+    pWin->optional->propIndex = index;
+
+    /* Walk backwards so each name ends up pointing at its first entry */
+    for (pProp = last; pProp; pProp = pProp->prev) {
+        if (!PropertyIndexAdd(index, pProp)) {
+            PropertyIndexFree(pWin);
+            return;
+        }
+    }
+}
+
+/* Account for a property that is about to be unlinked from the list */
+static void
+PropertyIndexRemove(PropertyIndexPtr index, PropertyPtr pProp)
+{
+    PropertyIndexSlotPtr slot;
+    unsigned int i, j, k;
+
+    slot = PropertyIndexFind(index, pProp->propertyName);
+    if (--slot->count > 0) {
+        if (slot->first == pProp) {
+            do
+                pProp = pProp->next;
+            while (pProp->propertyName != slot->name);
+            slot->first = pProp;
+        }
+        return;
+    }
+
+    /* Backward-shift deletion keeps probe sequences unbroken */
+    i = slot - index->slots;
+    for (j = i;;) {
+        j = (j + 1) & index->mask;
+        if (index->slots[j].name == None)
+            break;
+        k = PropertyHash(index->slots[j].name) & index->mask;
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        index->slots[i] = index->slots[j];
+        i = j;
+    }
+    index->slots[i].name = None;
+    index->slots[i].first = NULL;
+    index->used--;
+}
+
+static void
+LinkWindowProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr index = pWin->optional->propIndex;
+
+    pProp->prev = NULL;
+    pProp->next = pWin->optional->userProps;
+    if (pProp->next)
+        pProp->next->prev = pProp;
+    pWin->optional->userProps = pProp;
+
+    if (index) {
+        if (!PropertyIndexAdd(index, pProp))
+            PropertyIndexFree(pWin);
+    }
+    else
+        PropertyIndexBuild(pWin);
+}
+
+static void
+UnlinkWindowProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    if (pWin->optional->propIndex)
+        PropertyIndexRemove(pWin->optional->propIndex, pProp);
+
+    if (pProp->next)
+        pProp->next->prev = pProp->prev;
+    if (pProp->prev)
+        pProp->prev->next = pProp->next;
+    else if (!(pWin->optional->userProps = pProp->next)) {
+        PropertyIndexFree(pWin);
+        CheckWindowOptionalNeed(pWin);
+    }
+}
+
 #ifdef notdef
 static void
 PrintPropertys(WindowPtr pWin)
@@ -95,9 +296,13 @@ dixLookupProperty(PropertyPtr *result, WindowPtr pWin, Atom propertyName,
 
     client->errorValue = propertyName;
 
-    for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
-        if (pProp->propertyName == propertyName)
-            break;
+    if (pWin->optional && pWin->optional->propIndex)
+        pProp = PropertyIndexFind(pWin->optional->propIndex,
+                                  propertyName)->first;
+    else
+        for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
+            if (pProp->propertyName == propertyName)
+                break;
 
     if (pProp)
         rc = XaceHookPropertyAccess(client, pWin, &pProp, access_mode);
@@ -282,8 +487,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
             pClient->errorValue = property;
             return rc;
         }
-        pProp->next = pWin->optional->userProps;
-        pWin->optional->userProps = pProp;
+        LinkWindowProperty(pWin, pProp);
     }
     else if (rc == Success) {
         /* To append or prepend to a property the request format and type
@@ -365,7 +569,7 @@ ChangeWindowProperty(WindowPtr pWin, Atom property, Atom type, int format,
 int
 DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     int rc;
 
     rc = dixLookupProperty(&pProp, pWin, propName, client, DixDestroyAccess);
@@ -373,19 +577,7 @@ DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
         return Success;         /* Succeed if property does not exist */
 
     if (rc == Success) {
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
-
+        UnlinkWindowProperty(pWin, pProp);
         deliverPropertyNotifyEvent(pWin, PropertyDelete, pProp->propertyName);
         free(pProp->data);
         dixFreeObjectWithPrivates(pProp, PRIVATE_PROPERTY);
@@ -409,6 +601,7 @@ DeleteAllWindowProperties(WindowPtr pWin)
 
     if (pWin->optional)
         pWin->optional->userProps = NULL;
+    PropertyIndexFree(pWin);
 }
 
 static int
@@ -440,7 +633,7 @@ NullPropertyReply(ClientPtr client, ATOM propertyType, int format)
 int
 ProcGetProperty(ClientPtr client)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     unsigned long n, len, ind;
     int rc;
     WindowPtr pWin;
@@ -543,19 +736,7 @@ ProcGetProperty(ClientPtr client)
 
     if (stuff->delete && (reply.bytesAfter == 0)) {
         /* Delete the Property */
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
-
+        UnlinkWindowProperty(pWin, pProp);
         free(pProp->data);
         dixFreeObjectWithPrivates(pProp, PRIVATE_PROPERTY);
     }
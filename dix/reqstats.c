@@ -0,0 +1,226 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+#include <X11/Xproto.h>
+#include "misc.h"
+#include "os.h"
+#include "dix.h"
+#include "extension.h"
+#include "registry.h"
+#include "reqstats.h"
+
+Bool RequestStatsEnabled = FALSE;
+int RequestStatsSignalNumber = SIGUSR2;
+volatile sig_atomic_t RequestStatsDumpPending;
+static Bool requestStatsSignalInstalled;
+
+/*
+ * One table per major opcode, allocated on first use.  Core requests
+ * have a single entry; extension majors have one per minor opcode.
+ */
+static RequestStatsPtr requestStats[256];
+
+static int
+RequestStatsMinors(int major)
+{
+    return major >= EXTENSION_BASE ? 256 : 1;
+}
+
+RequestStatsPtr
+RequestStatsLookup(int major, int minor)
+{
+    major &= 0xff;
+    if (!requestStats[major]) {
+        requestStats[major] = calloc(RequestStatsMinors(major),
+                                     sizeof(RequestStatsRec));
+        if (!requestStats[major])
+            return NULL;
+    }
+    if (major < EXTENSION_BASE)
+        minor = 0;
+    return &requestStats[major][minor & 0xff];
+}
+
+static int
+RequestStatsBucket(CARD64 usec)
+{
+    int b = 0;
+
+    while (usec && b < REQSTATS_BUCKETS - 1) {
+        usec >>= 1;
+        b++;
+    }
+    return b;
+}
+
+void
+RequestStatsRecord(int major, int minor, CARD64 usec)
+{
+    RequestStatsPtr rs = RequestStatsLookup(major, minor);
+
+    if (!rs)
+        return;
+    rs->count++;
+    rs->total += usec;
+    if (usec > rs->max)
+        rs->max = usec > 0xffffffff ? 0xffffffff : usec;
+    rs->hist[RequestStatsBucket(usec)]++;
+}
+
+typedef struct {
+    int major, minor;
+    RequestStatsPtr rs;
+} RequestStatsEntry;
+
+static int
+RequestStatsCompare(const void *a, const void *b)
+{
+    const RequestStatsEntry *ea = a, *eb = b;
+
+    if (ea->rs->total != eb->rs->total)
+        return ea->rs->total < eb->rs->total ? 1 : -1;
+    if (ea->major != eb->major)
+        return ea->major - eb->major;
+    return ea->minor - eb->minor;
+}
+
+/**
+ * Log every request seen so far, most expensive in total first.
+ */
+void
+RequestStatsDump(void)
+{
+    RequestStatsEntry *entries;
+    int major, minor, n = 0, i, b;
+
+    RequestStatsDumpPending = FALSE;
+
+    for (major = 0; major < 256; major++)
+        if (requestStats[major])
+            for (minor = 0; minor < RequestStatsMinors(major); minor++)
+                if (requestStats[major][minor].count)
+                    n++;
+    if (!n)
+        return;
+
+    entries = calloc(n, sizeof(RequestStatsEntry));
+    if (!entries)
+        return;
+    n = 0;
+    for (major = 0; major < 256; major++)
+        if (requestStats[major])
+            for (minor = 0; minor < RequestStatsMinors(major); minor++)
+                if (requestStats[major][minor].count) {
+                    entries[n].major = major;
+                    entries[n].minor = minor;
+                    entries[n].rs = &requestStats[major][minor];
+                    n++;
+                }
+    qsort(entries, n, sizeof(RequestStatsEntry), RequestStatsCompare);
+
+    LogMessage(X_INFO, "Request statistics: calls, total/avg/max usec, "
+               "log2 usec histogram\n");
+    for (i = 0; i < n; i++) {
+        RequestStatsPtr rs = entries[i].rs;
+        char hist[REQSTATS_BUCKETS * 11 + 1], *h = hist;
+
+        for (b = 0; b < REQSTATS_BUCKETS; b++)
+            h += snprintf(h, hist + sizeof(hist) - h, " %u", rs->hist[b]);
+        LogMessageVerb(X_NONE, 0, "    %3d.%-3d %-36s %10llu %12llu %8llu "
+                       "%8u |%s\n", entries[i].major, entries[i].minor,
+                       LookupRequestName(entries[i].major, entries[i].minor),
+                       (unsigned long long) rs->count,
+                       (unsigned long long) rs->total,
+                       (unsigned long long) (rs->total / rs->count),
+                       (unsigned) rs->max, hist);
+    }
+    free(entries);
+}
+
+void
+RequestStatsReset(void)
+{
+    int major;
+
+    for (major = 0; major < 256; major++) {
+        free(requestStats[major]);
+        requestStats[major] = NULL;
+    }
+}
+
+static void
+RequestStatsSignal(int sig)
+{
+    RequestStatsDumpPending = TRUE;
+}
+
+/*
+ * The signal is hooked up from the first block handler, once the DDX has
+ * set up its own signals, so one it already uses is left alone.
+ */
+static void
+RequestStatsBlockHandler(void *data, OSTimePtr pTimeout, void *pReadmask)
+{
+    OsSigHandlerPtr old;
+
+    if (requestStatsSignalInstalled || !RequestStatsSignalNumber)
+        return;
+    requestStatsSignalInstalled = TRUE;
+
+    old = OsSignal(RequestStatsSignalNumber, RequestStatsSignal);
+    if (old != SIG_DFL && old != SIG_IGN && old != RequestStatsSignal) {
+        OsSignal(RequestStatsSignalNumber, old);
+        LogMessage(X_WARNING, "Request statistics: signal %d is already "
+                   "in use, choose another with -reqstatssignal\n",
+                   RequestStatsSignalNumber);
+    }
+}
+
+/*
+ * A signal interrupts WaitForSomething, so the dump is written here
+ * rather than from the dispatch loop, which an idle server never
+ * reaches.
+ */
+static void
+RequestStatsWakeupHandler(void *data, int result, void *pReadmask)
+{
+    if (RequestStatsDumpPending)
+        RequestStatsDump();
+}
+
+void
+RequestStatsInit(void)
+{
+    if (!RequestStatsEnabled)
+        return;
+    requestStatsSignalInstalled = FALSE;
+    RegisterBlockAndWakeupHandlers(RequestStatsBlockHandler,
+                                   RequestStatsWakeupHandler, NULL);
+}
@@ -108,6 +108,14 @@ Equipment Corporation.
  *	A resource ID is "hashed" by extracting and xoring subfields
  *      (varying with the size of the hash table).
  *
+ *      Each client's table grows and shrinks with the number of resources
+ *      it holds.  Resizing is incremental: the old bucket array is kept
+ *      next to the new one and a few of its buckets are moved over on
+ *      every AddResource and FreeResource, while a lookup first moves the
+ *      one old bucket it would have searched.  Resources are also linked
+ *      on per-type lists, so enumerating one type or tearing down a client
+ *      never visits empty buckets or unrelated resources.
+ *
  *      It is sometimes necessary for the server to create an ID that looks
  *      like it belongs to a client.  This ID, however,  must not be one
  *      the client actually can create, or we have the potential for conflict.
@@ -152,17 +160,17 @@ typedef const char *string;
 #define TypeNameString(t) LookupResourceName(t)
 #endif
 
-static void RebuildTable(int    /*client */
-    );
-
 #define SERVER_MINID 32
 
 #define INITBUCKETS 64
 #define INITHASHSIZE 6
-#define MAXHASHSIZE 11
+#define MAXHASHSIZE 16
+#define REHASHSTEPS 4           /* old buckets moved per add or free */
 
 typedef struct _Resource {
-    struct _Resource *next;
+    struct _Resource *next;     /* hash chain */
+    struct _Resource *typeNext; /* per-type list, newest first */
+    struct _Resource *typePrev;
     XID id;
     RESTYPE type;
     void *value;
@@ -173,6 +181,13 @@ typedef struct _ClientResource {
     int elements;
     int buckets;
     int hashsize;               /* log(2)(buckets) */
+    ResourcePtr *oldResources;  /* table being rehashed, or NULL */
+    int oldBuckets;
+    int oldHashsize;
+    int rehashPos;              /* first old bucket not yet moved */
+    ResourcePtr *typeLists;     /* indexed by type & TypeMask */
+    int numTypeLists;
+    Bool freeing;               /* inside FreeClientResources */
     XID fakeID;
     XID endFakeID;
 } ClientResourceRec;
@@ -629,6 +644,13 @@ InitClientResources(ClientPtr client)
     clientTable[i].buckets = INITBUCKETS;
     clientTable[i].elements = 0;
     clientTable[i].hashsize = INITHASHSIZE;
+    clientTable[i].oldResources = NULL;
+    clientTable[i].oldBuckets = 0;
+    clientTable[i].oldHashsize = 0;
+    clientTable[i].rehashPos = 0;
+    clientTable[i].typeLists = NULL;
+    clientTable[i].numTypeLists = 0;
+    clientTable[i].freeing = FALSE;
     /* Many IDs allocated from the server client are visible to clients,
      * so we don't use the SERVER_BIT for them, but we have to start
      * past the magic value constants used in the protocol.  For normal
@@ -662,13 +684,151 @@ HashResourceID(XID id, int numBits)
         case 11:
             return ((int)(0x7FF & (id ^ (id>>11))));
     }
+    assert(numBits >= 0 && numBits < 32);
     if (numBits >= 11)
-        return ((int)(0x7FF & (id ^ (id>>11))));
+        return ((int)(((1U << numBits) - 1) & (id ^ (id>>numBits))));
     else
-    {
-        assert(numBits >= 0);
-        return id & ~((~0) << numBits);
+        return (int)(id & ((1U << numBits) - 1));
+}
+
+/*
+ * Move one bucket of the old table into the current one.  Entries are
+ * appended, so resources sharing an ID stay newest first and are still
+ * freed in the opposite order they were added.
+ */
+static void
+RehashBucket(ClientResourceRec *rrec, int bucket)
+{
+    ResourcePtr res, next, *tail;
+
+    for (res = rrec->oldResources[bucket]; res; res = next) {
+        next = res->next;
+        res->next = NULL;
+        for (tail = &rrec->resources[HashResourceID(res->id, rrec->hashsize)];
+             *tail; tail = &(*tail)->next);
+        *tail = res;
+    }
+    rrec->oldResources[bucket] = NULL;
+}
+
+static void
+RehashSteps(ClientResourceRec *rrec, int steps)
+{
+    while (rrec->oldResources && steps-- > 0) {
+        RehashBucket(rrec, rrec->rehashPos++);
+        if (rrec->rehashPos == rrec->oldBuckets) {
+            free(rrec->oldResources);
+            rrec->oldResources = NULL;
+        }
+    }
+}
+
+/* Start moving the table over to 1 << hashsize buckets */
+static void
+StartRehash(ClientResourceRec *rrec, int hashsize)
+{
+    ResourcePtr *resources;
+
+    resources = calloc(1 << hashsize, sizeof(ResourcePtr));
+    if (!resources)
+        return;
+    rrec->oldResources = rrec->resources;
+    rrec->oldBuckets = rrec->buckets;
+    rrec->oldHashsize = rrec->hashsize;
+    rrec->rehashPos = 0;
+    rrec->resources = resources;
+    rrec->buckets = 1 << hashsize;
+    rrec->hashsize = hashsize;
+}
+
+/* Called on every add and free to advance or start a resize */
+static void
+ResizeClientTable(ClientResourceRec *rrec)
+{
+    if (rrec->freeing)
+        return;
+    if (rrec->oldResources)
+        RehashSteps(rrec, REHASHSTEPS);
+    else if (rrec->elements >= 4 * rrec->buckets &&
+             rrec->hashsize < MAXHASHSIZE)
+        StartRehash(rrec, rrec->hashsize + 1);
+    else if (rrec->elements < rrec->buckets / 4 &&
+             rrec->hashsize > INITHASHSIZE)
+        StartRehash(rrec, rrec->hashsize - 1);
+}
+
+/* Return the chain for id, moving it out of the old table first */
+static ResourcePtr *
+ResourceBucket(ClientResourceRec *rrec, XID id)
+{
+    if (rrec->oldResources) {
+        int old = HashResourceID(id, rrec->oldHashsize);
+
+        if (rrec->oldResources[old])
+            RehashBucket(rrec, old);
+    }
+    return &rrec->resources[HashResourceID(id, rrec->hashsize)];
+}
+
+static Bool
+LinkResourceType(ClientResourceRec *rrec, ResourcePtr res)
+{
+    int t = res->type & TypeMask;
+
+    if (t >= rrec->numTypeLists) {
+        ResourcePtr *lists;
+        int n = lastResourceType + 1;
+
+        lists = realloc(rrec->typeLists, n * sizeof(ResourcePtr));
+        if (!lists)
+            return FALSE;
+        memset(lists + rrec->numTypeLists, 0,
+               (n - rrec->numTypeLists) * sizeof(ResourcePtr));
+        rrec->typeLists = lists;
+        rrec->numTypeLists = n;
+    }
+    res->typePrev = NULL;
+    res->typeNext = rrec->typeLists[t];
+    if (res->typeNext)
+        res->typeNext->typePrev = res;
+    rrec->typeLists[t] = res;
+    return TRUE;
+}
+
+static void
+UnlinkResourceType(ClientResourceRec *rrec, ResourcePtr res)
+{
+    if (res->typeNext)
+        res->typeNext->typePrev = res->typePrev;
+    if (res->typePrev)
+        res->typePrev->typeNext = res->typeNext;
+    else
+        rrec->typeLists[res->type & TypeMask] = res->typeNext;
+}
+
+/* Take res out of both its hash chain and its type list */
+static void
+RemoveResource(ClientResourceRec *rrec, ResourcePtr res)
+{
+    ResourcePtr *prev;
+
+    for (prev = ResourceBucket(rrec, res->id); *prev != res;
+         prev = &(*prev)->next);
+    *prev = res->next;
+    UnlinkResourceType(rrec, res);
+    rrec->elements--;
+}
+
+/* Type list range to walk for a FindClientResourcesByType style filter */
+static int
+TypeListRange(ClientResourceRec *rrec, RESTYPE type, int *last)
+{
+    if (!type) {
+        *last = rrec->numTypeLists - 1;
+        return 0;
     }
+    *last = type & TypeMask;
+    return type & TypeMask;
 }
 
 static XID
@@ -679,7 +839,7 @@ AvailableID(int client, XID id, XID maxid, XID goodid)
     if ((goodid >= id) && (goodid <= maxid))
         return goodid;
     for (; id <= maxid; id++) {
-        res = clientTable[client].resources[HashResourceID(id, clientTable[client].hashsize)];
+        res = *ResourceBucket(&clientTable[client], id);
         while (res && (res->id != id))
             res = res->next;
         if (!res)
@@ -692,7 +852,6 @@ void
 GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
 {
     XID id, maxid;
-    ResourcePtr *resp;
     ResourcePtr res;
     int i;
     XID goodid;
@@ -702,9 +861,8 @@ GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
         id |= client ? SERVER_BIT : SERVER_MINID;
     maxid = id | RESOURCE_ID_MASK;
     goodid = 0;
-    for (resp = clientTable[client].resources, i = clientTable[client].buckets;
-         --i >= 0;) {
-        for (res = *resp++; res; res = res->next) {
+    for (i = 0; i < clientTable[client].numTypeLists; i++) {
+        for (res = clientTable[client].typeLists[i]; res; res = res->typeNext) {
             if ((res->id < id) || (res->id > maxid))
                 continue;
             if (((res->id - id) >= (maxid - res->id)) ?
@@ -803,17 +961,22 @@ AddResource(XID id, RESTYPE type, void *value)
                (unsigned long) id, type, (unsigned long) value, client);
         FatalError("client not in use\n");
     }
-    if ((rrec->elements >= 4 * rrec->buckets) && (rrec->hashsize < MAXHASHSIZE))
-        RebuildTable(client);
-    head = &rrec->resources[HashResourceID(id, clientTable[client].hashsize)];
+    ResizeClientTable(rrec);
     res = malloc(sizeof(ResourceRec));
+    if (res) {
+        res->type = type;
+        if (!LinkResourceType(rrec, res)) {
+            free(res);
+            res = NULL;
+        }
+    }
     if (!res) {
         (*resourceTypes[type & TypeMask].deleteFunc) (value, id);
         return FALSE;
     }
+    head = ResourceBucket(rrec, id);
     res->next = *head;
     res->id = id;
-    res->type = type;
     res->value = value;
     *head = res;
     rrec->elements++;
@@ -821,49 +984,6 @@ AddResource(XID id, RESTYPE type, void *value)
     return TRUE;
 }
 
-static void
-RebuildTable(int client)
-{
-    int j;
-    ResourcePtr res, next;
-    ResourcePtr **tails, *resources;
-    ResourcePtr **tptr, *rptr;
-
-    /*
-     * For now, preserve insertion order, since some ddx layers depend
-     * on resources being free in the opposite order they are added.
-     */
-
-    j = 2 * clientTable[client].buckets;
-    tails = malloc(j * sizeof(ResourcePtr *));
-    if (!tails)
-        return;
-    resources = malloc(j * sizeof(ResourcePtr));
-    if (!resources) {
-        free(tails);
-        return;
-    }
-    for (rptr = resources, tptr = tails; --j >= 0; rptr++, tptr++) {
-        *rptr = NULL;
-        *tptr = rptr;
-    }
-    clientTable[client].hashsize++;
-    for (j = clientTable[client].buckets,
-         rptr = clientTable[client].resources; --j >= 0; rptr++) {
-        for (res = *rptr; res; res = next) {
-            next = res->next;
-            res->next = NULL;
-            tptr = &tails[HashResourceID(res->id, clientTable[client].hashsize)];
-            **tptr = res;
-            *tptr = &res->next;
-        }
-    }
-    free(tails);
-    clientTable[client].buckets *= 2;
-    free(clientTable[client].resources);
-    clientTable[client].resources = resources;
-}
-
 static void
 doFreeResource(ResourcePtr res, Bool skip)
 {
@@ -879,16 +999,16 @@ void
 FreeResource(XID id, RESTYPE skipDeleteFuncType)
 {
     int cid;
+    ClientResourceRec *rrec;
     ResourcePtr res;
-    ResourcePtr *prev, *head;
-    int *eltptr;
+    ResourcePtr *prev;
     int elements;
 
     if (((cid = CLIENT_ID(id)) < MAXCLIENTS) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-        eltptr = &clientTable[cid].elements;
+        rrec = &clientTable[cid];
+        ResizeClientTable(rrec);
 
-        prev = head;
+        prev = ResourceBucket(rrec, id);
         while ((res = *prev)) {
             if (res->id == id) {
                 RESTYPE rtype = res->type;
@@ -898,12 +1018,13 @@ FreeResource(XID id, RESTYPE skipDeleteFuncType)
                                       res->value, TypeNameString(res->type));
 #endif
                 *prev = res->next;
-                elements = --*eltptr;
+                UnlinkResourceType(rrec, res);
+                elements = --rrec->elements;
 
                 doFreeResource(res, rtype == skipDeleteFuncType);
 
-                if (*eltptr != elements)
-                    prev = head;        /* prev may no longer be valid */
+                if (rrec->elements != elements)
+                    prev = ResourceBucket(rrec, id);    /* prev may no longer be valid */
             }
             else
                 prev = &res->next;
@@ -915,13 +1036,15 @@ void
 FreeResourceByType(XID id, RESTYPE type, Bool skipFree)
 {
     int cid;
+    ClientResourceRec *rrec;
     ResourcePtr res;
-    ResourcePtr *prev, *head;
+    ResourcePtr *prev;
 
     if (((cid = CLIENT_ID(id)) < MAXCLIENTS) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+        rrec = &clientTable[cid];
+        ResizeClientTable(rrec);
 
-        prev = head;
+        prev = ResourceBucket(rrec, id);
         while ((res = *prev)) {
             if (res->id == id && res->type == type) {
 #ifdef XSERVER_DTRACE
@@ -929,7 +1052,8 @@ FreeResourceByType(XID id, RESTYPE type, Bool skipFree)
                                       res->value, TypeNameString(res->type));
 #endif
                 *prev = res->next;
-                clientTable[cid].elements--;
+                UnlinkResourceType(rrec, res);
+                rrec->elements--;
 
                 doFreeResource(res, skipFree);
 
@@ -954,7 +1078,7 @@ ChangeResourceValue(XID id, RESTYPE rtype, void *value)
     ResourcePtr res;
 
     if (((cid = CLIENT_ID(id)) < MAXCLIENTS) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+        res = *ResourceBucket(&clientTable[cid], id);
 
         for (; res; res = res->next)
             if ((res->id == id) && (res->type == rtype)) {
@@ -975,24 +1099,23 @@ void
 FindClientResourcesByType(ClientPtr client,
                           RESTYPE type, FindResType func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
     ResourcePtr this, next;
-    int i, elements;
-    int *eltptr;
+    int i, last, elements;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
+    rrec = &clientTable[client->index];
+    for (i = TypeListRange(rrec, type, &last);
+         i <= last && i < rrec->numTypeLists; i++) {
+        for (this = rrec->typeLists[i]; this; this = next) {
+            next = this->typeNext;
             if (!type || this->type == type) {
-                elements = *eltptr;
+                elements = rrec->elements;
                 (*func) (this->value, this->id, cdata);
-                if (*eltptr != elements)
-                    next = resources[i];        /* start over */
+                if (rrec->elements != elements)
+                    next = rrec->typeLists[i];  /* start over */
             }
         }
     }
@@ -1010,23 +1133,21 @@ void FindSubResources(void *resource,
 void
 FindAllClientResources(ClientPtr client, FindAllRes func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
     ResourcePtr this, next;
     int i, elements;
-    int *eltptr;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
-            elements = *eltptr;
+    rrec = &clientTable[client->index];
+    for (i = 0; i < rrec->numTypeLists; i++) {
+        for (this = rrec->typeLists[i]; this; this = next) {
+            next = this->typeNext;
+            elements = rrec->elements;
             (*func) (this->value, this->id, this->type, cdata);
-            if (*eltptr != elements)
-                next = resources[i];    /* start over */
+            if (rrec->elements != elements)
+                next = rrec->typeLists[i];      /* start over */
         }
     }
 }
@@ -1036,18 +1157,19 @@ LookupClientResourceComplex(ClientPtr client,
                             RESTYPE type,
                             FindComplexResType func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
     ResourcePtr this, next;
     void *value;
-    int i;
+    int i, last;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
+    rrec = &clientTable[client->index];
+    for (i = TypeListRange(rrec, type, &last);
+         i <= last && i < rrec->numTypeLists; i++) {
+        for (this = rrec->typeLists[i]; this; this = next) {
+            next = this->typeNext;
             if (!type || this->type == type) {
                 /* workaround func freeing the type as DRI1 does */
                 value = this->value;
@@ -1062,38 +1184,30 @@ LookupClientResourceComplex(ClientPtr client,
 void
 FreeClientNeverRetainResources(ClientPtr client)
 {
-    ResourcePtr *resources;
-    ResourcePtr this;
-    ResourcePtr *prev;
-    int j, elements;
-    int *eltptr;
+    ClientResourceRec *rrec;
+    ResourcePtr this, next;
+    int i, elements;
 
     if (!client)
         return;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        prev = &resources[j];
-        while ((this = *prev)) {
-            RESTYPE rtype = this->type;
-
-            if (rtype & RC_NEVERRETAIN) {
+    rrec = &clientTable[client->index];
+    for (i = 0; i < rrec->numTypeLists; i++) {
+        for (this = rrec->typeLists[i]; this; this = next) {
+            next = this->typeNext;
+            if (this->type & RC_NEVERRETAIN) {
 #ifdef XSERVER_DTRACE
                 XSERVER_RESOURCE_FREE(this->id, this->type,
                                       this->value, TypeNameString(this->type));
 #endif
-                *prev = this->next;
-                clientTable[client->index].elements--;
-                elements = *eltptr;
+                RemoveResource(rrec, this);
+                elements = rrec->elements;
 
                 doFreeResource(this, FALSE);
 
-                if (*eltptr != elements)
-                    prev = &resources[j];       /* prev may no longer be valid */
+                if (rrec->elements != elements)
+                    next = rrec->typeLists[i];  /* next may no longer be valid */
             }
-            else
-                prev = &this->next;
         }
     }
 }
@@ -1101,7 +1215,7 @@ FreeClientNeverRetainResources(ClientPtr client)
 void
 FreeClientResources(ClientPtr client)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
     ResourcePtr this;
     int j;
 
@@ -1113,8 +1227,14 @@ FreeClientResources(ClientPtr client)
 
     HandleSaveSet(client);
 
-    resources = clientTable[client->index].resources;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
+    rrec = &clientTable[client->index];
+    rrec->freeing = TRUE;
+
+    /* Finish a pending resize, so every resource is in the one table
+       walked below.  No new resize starts until we are done. */
+    RehashSteps(rrec, rrec->oldBuckets);
+
+    for (j = 0; j < rrec->buckets; j++) {
         /* It may seem silly to update the head of this resource list as
            we delete the members, since the entire list will be deleted any way, 
            but there are some resource deletion functions "FreeClientPixels" for 
@@ -1126,7 +1246,7 @@ FreeClientResources(ClientPtr client)
 
         ResourcePtr *head;
 
-        head = &resources[j];
+        head = &rrec->resources[j];
 
         for (this = *head; this; this = *head) {
 #ifdef XSERVER_DTRACE
@@ -1134,14 +1254,21 @@ FreeClientResources(ClientPtr client)
                                   this->value, TypeNameString(this->type));
 #endif
             *head = this->next;
-            clientTable[client->index].elements--;
+            UnlinkResourceType(rrec, this);
+            rrec->elements--;
 
             doFreeResource(this, FALSE);
         }
     }
-    free(clientTable[client->index].resources);
-    clientTable[client->index].resources = NULL;
-    clientTable[client->index].buckets = 0;
+    free(rrec->resources);
+    rrec->resources = NULL;
+    free(rrec->oldResources);
+    rrec->oldResources = NULL;
+    free(rrec->typeLists);
+    rrec->typeLists = NULL;
+    rrec->numTypeLists = 0;
+    rrec->buckets = 0;
+    rrec->freeing = FALSE;
 }
 
 void
@@ -1192,7 +1319,7 @@ dixLookupResourceByType(void **result, XID id, RESTYPE rtype,
         return BadImplementation;
 
     if ((cid < MAXCLIENTS) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+        res = *ResourceBucket(&clientTable[cid], id);
 
         for (; res; res = res->next)
             if (res->id == id && res->type == rtype)
@@ -1225,7 +1352,7 @@ dixLookupResourceByClass(void **result, XID id, RESTYPE rclass,
     *result = NULL;
 
     if ((cid < MAXCLIENTS) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+        res = *ResourceBucket(&clientTable[cid], id);
 
         for (; res; res = res->next)
             if (res->id == id && (res->type & rclass))
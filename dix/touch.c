@@ -62,11 +62,147 @@ static unsigned char resize_waiting[(MAXDEVICES + 7) / 8];
  * The DDXTouchPointInfo struct is stored dev->last.touches. When the event
  * being processed, it becomes a TouchPointInfo in dev->touch-touches which
  * contains amongst other things the sprite trace and delivery information.
+ *
+ * dev->last.touches starts with room for twice the touches the device
+ * announces. It is used from the signal handler, so when it runs out the
+ * event is dropped and TouchResizeQueue grows it later.
+ * dev->last.touch_ids and dev->touch->client_ids map the active touches'
+ * ids to their index so an event finds its touch without a scan.
  */
 
+static unsigned int
+TouchIdHash(uint32_t id)
+{
+    id ^= id >> 16;
+    id *= 0x9e3779b1;
+    return id ^ (id >> 15);
+}
+
+/**
+ * Set up an empty map with room for capacity ids, twice as many slots
+ * so probe sequences stay short.
+ *
+ * @return FALSE on allocation failure, the map then stays empty
+ */
+Bool
+TouchIdMapInit(TouchIdMapPtr map, int capacity)
+{
+    unsigned int size = 8;
+    unsigned int i;
+
+    while (size < 2 * capacity)
+        size <<= 1;
+
+    memset(map, 0, sizeof(*map));
+    map->slots = malloc(size * sizeof(*map->slots));
+    if (!map->slots)
+        return FALSE;
+    for (i = 0; i < size; i++)
+        map->slots[i].index = -1;
+    map->mask = size - 1;
+    return TRUE;
+}
+
+void
+TouchIdMapFree(TouchIdMapPtr map)
+{
+    free(map->slots);
+    memset(map, 0, sizeof(*map));
+}
+
+/**
+ * @return The index stored for id, or -1 if id is not in the map
+ */
+int
+TouchIdMapFind(TouchIdMapPtr map, uint32_t id)
+{
+    unsigned int i;
+
+    if (!map->slots)
+        return -1;
+
+    for (i = TouchIdHash(id) & map->mask; map->slots[i].index >= 0;
+         i = (i + 1) & map->mask) {
+        if (map->slots[i].id == id)
+            return map->slots[i].index;
+    }
+    return -1;
+}
+
+/**
+ * Store index for id, which must not be in the map yet. A map that fills
+ * up to half its slots is grown; if that fails the map is dropped, and
+ * lookups scan from then on. The DDX map is sized so this never happens
+ * in the signal handler.
+ */
+void
+TouchIdMapAdd(TouchIdMapPtr map, uint32_t id, int index)
+{
+    unsigned int i;
+
+    if (!map->slots)
+        return;
+
+    if (2 * (map->count + 1) > map->mask + 1) {
+        TouchIdMapRec bigger;
+        unsigned int j;
+
+        if (!TouchIdMapInit(&bigger, map->mask + 1)) {
+            TouchIdMapFree(map);
+            return;
+        }
+        for (j = 0; j <= map->mask; j++)
+            if (map->slots[j].index >= 0)
+                TouchIdMapAdd(&bigger, map->slots[j].id, map->slots[j].index);
+        TouchIdMapFree(map);
+        *map = bigger;
+    }
+
+    for (i = TouchIdHash(id) & map->mask; map->slots[i].index >= 0;
+         i = (i + 1) & map->mask);
+    map->slots[i].id = id;
+    map->slots[i].index = index;
+    map->count++;
+}
+
+void
+TouchIdMapRemove(TouchIdMapPtr map, uint32_t id)
+{
+    unsigned int i, j, home;
+
+    if (!map->slots)
+        return;
+
+    for (i = TouchIdHash(id) & map->mask; map->slots[i].id != id;
+         i = (i + 1) & map->mask) {
+        if (map->slots[i].index < 0)
+            return;
+    }
+    if (map->slots[i].index < 0)
+        return;
+
+    /* Close the gap: move back any later entry of the probe sequence
+     * that would no longer be found past the hole at i. */
+    map->count--;
+    for (j = i;;) {
+        map->slots[i].index = -1;
+        for (;;) {
+            j = (j + 1) & map->mask;
+            if (map->slots[j].index < 0)
+                return;
+            home = TouchIdHash(map->slots[j].id) & map->mask;
+            if (((j - home) & map->mask) >= ((j - i) & map->mask))
+                break;
+        }
+        map->slots[i] = map->slots[j];
+        i = j;
+    }
+}
+
 /**
  * Check which devices need a bigger touch event queue and grow their
- * last.touches by half it's current size.
+ * last.touches by half it's current size, along with the id map so it
+ * never has to grow in the signal handler.
  *
  * @param client Always the serverClient
  * @param closure Always NULL
@@ -85,7 +221,9 @@ TouchResizeQueue(ClientPtr client, void *closure)
     for (i = 2; i < MAXDEVICES; i++) {
         DeviceIntPtr dev;
         DDXTouchPointInfoPtr tmp;
+        TouchIdMapRec ids;
         size_t size;
+        int j;
 
         if (!BitIsOn(resize_waiting, i))
             continue;
@@ -102,15 +240,22 @@ TouchResizeQueue(ClientPtr client, void *closure)
         size = dev->last.num_touches + dev->last.num_touches / 2 + 1;
 
         tmp = realloc(dev->last.touches, size * sizeof(*dev->last.touches));
-        if (tmp) {
-            int j;
+        if (!tmp)
+            continue;
 
-            dev->last.touches = tmp;
-            for (j = dev->last.num_touches; j < size; j++)
-                TouchInitDDXTouchPoint(dev, &dev->last.touches[j]);
-            dev->last.num_touches = size;
-        }
+        dev->last.touches = tmp;
+        for (j = dev->last.num_touches; j < size; j++)
+            TouchInitDDXTouchPoint(dev, &dev->last.touches[j]);
+        dev->last.num_touches = size;
 
+        /* Without a map the lookups scan, which is slower but correct. */
+        TouchIdMapFree(&dev->last.touch_ids);
+        if (!TouchIdMapInit(&ids, size))
+            continue;
+        for (j = 0; j < size; j++)
+            if (dev->last.touches[j].active)
+                TouchIdMapAdd(&ids, dev->last.touches[j].ddx_id, j);
+        dev->last.touch_ids = ids;
     }
     OsReleaseSignals();
 
@@ -134,10 +279,17 @@ TouchFindByDDXID(DeviceIntPtr dev, uint32_t ddx_id, Bool create)
     if (!dev->touch)
         return NULL;
 
-    for (i = 0; i < dev->last.num_touches; i++) {
-        ti = &dev->last.touches[i];
-        if (ti->active && ti->ddx_id == ddx_id)
-            return ti;
+    if (dev->last.touch_ids.slots) {
+        i = TouchIdMapFind(&dev->last.touch_ids, ddx_id);
+        if (i >= 0)
+            return &dev->last.touches[i];
+    }
+    else {
+        for (i = 0; i < dev->last.num_touches; i++) {
+            ti = &dev->last.touches[i];
+            if (ti->active && ti->ddx_id == ddx_id)
+                return ti;
+        }
     }
 
     return create ? TouchBeginDDXTouch(dev, ddx_id) : NULL;
@@ -194,6 +346,7 @@ TouchBeginDDXTouch(DeviceIntPtr dev, uint32_t ddx_id)
             next_client_id = 1;
         ti->client_id = client_id;
         ti->emulate_pointer = emulate_pointer;
+        TouchIdMapAdd(&dev->last.touch_ids, ddx_id, ti - dev->last.touches);
         return ti;
     }
 
@@ -219,6 +372,8 @@ TouchEndDDXTouch(DeviceIntPtr dev, DDXTouchPointInfoPtr ti)
     if (!t)
         return;
 
+    if (ti->active)
+        TouchIdMapRemove(&dev->last.touch_ids, ti->ddx_id);
     ti->active = FALSE;
 }
 
@@ -300,6 +455,11 @@ TouchFindByClientID(DeviceIntPtr dev, uint32_t client_id)
     if (!t)
         return NULL;
 
+    if (t->client_ids.slots) {
+        i = TouchIdMapFind(&t->client_ids, client_id);
+        return i >= 0 ? &t->touches[i] : NULL;
+    }
+
     for (i = 0; i < t->num_touches; i++) {
         ti = &t->touches[i];
         if (ti->active && ti->client_id == client_id)
@@ -344,6 +504,7 @@ TouchBeginTouch(DeviceIntPtr dev, int sourceid, uint32_t touchid,
             ti->client_id = touchid;
             ti->sourceid = sourceid;
             ti->emulate_pointer = emulate_pointer;
+            TouchIdMapAdd(&t->client_ids, touchid, i);
             return ti;
         }
     }
@@ -385,6 +546,8 @@ TouchEndTouch(DeviceIntPtr dev, TouchPointInfoPtr ti)
     for (i = 0; i < ti->num_listeners; i++)
         TouchRemoveListener(ti, ti->listeners[0].listener);
 
+    if (ti->active)
+        TouchIdMapRemove(&dev->touch->client_ids, ti->client_id);
     ti->active = FALSE;
     ti->pending_finish = FALSE;
     ti->sprite.spriteTraceGood = 0;
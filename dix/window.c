@@ -480,6 +480,8 @@ CreateRootWindow(ScreenPtr pScreen)
     pWin->optional->otherClients = NULL;
     pWin->optional->passiveGrabs = NULL;
     pWin->optional->userProps = NULL;
+    pWin->optional->propIndex = NULL;
+    pWin->optional->pickIndex = NULL;
     pWin->optional->backingBitPlanes = ~0L;
     pWin->optional->backingPixel = 0;
     pWin->optional->boundingShape = NULL;
@@ -878,6 +880,8 @@ DisposeWindowOptional(WindowPtr pWin)
         pWin->optional->deviceCursors = NULL;
     }
 
+    /* a cache, rebuilt when picking next needs it */
+    free(pWin->optional->pickIndex);
     free(pWin->optional);
     pWin->optional = NULL;
 }
@@ -3307,6 +3311,8 @@ MakeWindowOptional(WindowPtr pWin)
     optional->otherClients = NULL;
     optional->passiveGrabs = NULL;
     optional->userProps = NULL;
+    optional->propIndex = NULL;
+    optional->pickIndex = NULL;
     optional->backingBitPlanes = ~0L;
     optional->backingPixel = 0;
     optional->boundingShape = NULL;
@@ -1310,9 +1310,30 @@ extern _X_EXPORT void
 extern _X_EXPORT Bool
  fbPictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats);
 
+extern _X_EXPORT Bool
+ fbPictureCacheInit(ScreenPtr pScreen);
+
 extern _X_EXPORT void
 fbDestroyGlyphCache(void);
 
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long glyphs;       /* glyphs cached now */
+    size_t bytes;               /* bytes their images take */
+    size_t budget;              /* 0 if unbounded */
+} FbGlyphCacheStatsRec, *FbGlyphCacheStatsPtr;
+
+extern _X_EXPORT Bool
+fbGlyphCacheInit(void);
+
+extern _X_EXPORT void
+fbSetGlyphCacheBudget(size_t bytes);
+
+extern _X_EXPORT void
+fbGetGlyphCacheStats(FbGlyphCacheStatsPtr stats);
+
 /*
  * fbpixmap.c
  */
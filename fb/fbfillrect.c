@@ -26,6 +26,138 @@
 
 #include "fb.h"
 
+/* rectangles clipped and filled together on the solid path */
+#define FB_SOLID_BATCH	256
+
+/*
+ * Below this many rectangles, clipping each one against every clip box
+ * is cheaper than building a region from them.
+ */
+#define FB_SOLID_SWEEP_MIN	8
+
+/*
+ * Fill boxes, already clipped and in screen coordinates, with the
+ * solid pixel of the GC.
+ */
+static void
+fbSolidBoxes(DrawablePtr pDrawable, GCPtr pGC, BoxPtr pbox, int nbox)
+{
+    FbBits *dst;
+    FbStride dstStride;
+    int dstBpp;
+    int dstXoff, dstYoff;
+    FbGCPrivPtr pPriv = fbGetGCPrivate(pGC);
+    int width, height;
+
+    fbGetDrawable(pDrawable, dst, dstStride, dstBpp, dstXoff, dstYoff);
+
+    for (; nbox--; pbox++) {
+        width = pbox->x2 - pbox->x1;
+        height = pbox->y2 - pbox->y1;
+#ifndef FB_ACCESS_WRAPPER
+        if (pPriv->and || !pixman_fill((uint32_t *) dst, dstStride, dstBpp,
+                                       pbox->x1 + dstXoff, pbox->y1 + dstYoff,
+                                       width, height, pPriv->xor))
+#endif
+            fbSolid(dst + (pbox->y1 + dstYoff) * dstStride,
+                    dstStride,
+                    (pbox->x1 + dstXoff) * dstBpp,
+                    dstBpp, width * dstBpp, height, pPriv->and, pPriv->xor);
+    }
+
+    fbFinishAccess(pDrawable);
+}
+
+static void
+fbSolidBoxesClipped(DrawablePtr pDrawable, GCPtr pGC, RegionPtr pClip,
+                    BoxPtr pbox, int nbox)
+{
+    RegionRec region;
+    BoxPtr pclip;
+    BoxRec part;
+    int n;
+
+    if (RegionNumRects(pClip) == 1) {
+        fbSolidBoxes(pDrawable, pGC, pbox, nbox);
+        return;
+    }
+
+    /*
+     * Sorting the boxes into bands lets them be clipped in one pass over
+     * the clip instead of once per box.  Overlaps are merged, so this
+     * is only used for rops where filling twice is the same as once.
+     */
+    if (RegionInitBoxes(&region, pbox, nbox) &&
+        RegionIntersect(&region, &region, pClip)) {
+        fbSolidBoxes(pDrawable, pGC,
+                     RegionRects(&region), RegionNumRects(&region));
+        RegionUninit(&region);
+        return;
+    }
+    RegionUninit(&region);
+
+    /* Out of memory; clip each box against each clip box instead */
+    for (; nbox--; pbox++) {
+        pclip = RegionRects(pClip);
+        for (n = RegionNumRects(pClip); n--; pclip++) {
+            part.x1 = max(pbox->x1, pclip->x1);
+            part.y1 = max(pbox->y1, pclip->y1);
+            part.x2 = min(pbox->x2, pclip->x2);
+            part.y2 = min(pbox->y2, pclip->y2);
+            if (part.x1 < part.x2 && part.y1 < part.y2)
+                fbSolidBoxes(pDrawable, pGC, &part, 1);
+        }
+    }
+}
+
+/*
+ * Solid fills make up most PolyFillRectangle requests, often with
+ * hundreds of small rectangles.  Clip them against the extents in
+ * batches and fill each batch with the drawable fetched just once.
+ */
+static void
+fbPolyFillRectSolid(DrawablePtr pDrawable, GCPtr pGC, int nrect,
+                    xRectangle *prect)
+{
+    RegionPtr pClip = fbGetCompositeClip(pGC);
+    BoxPtr pextent = RegionExtents(pClip);
+    BoxRec boxes[FB_SOLID_BATCH];
+    BoxPtr pbox = boxes;
+    int xorg = pDrawable->x;
+    int yorg = pDrawable->y;
+    int x1, y1, x2, y2;
+
+    while (nrect--) {
+        x1 = prect->x + xorg;
+        y1 = prect->y + yorg;
+        x2 = x1 + (int) prect->width;
+        y2 = y1 + (int) prect->height;
+        prect++;
+
+        if (x1 < pextent->x1)
+            x1 = pextent->x1;
+        if (y1 < pextent->y1)
+            y1 = pextent->y1;
+        if (x2 > pextent->x2)
+            x2 = pextent->x2;
+        if (y2 > pextent->y2)
+            y2 = pextent->y2;
+        if (x1 >= x2 || y1 >= y2)
+            continue;
+
+        pbox->x1 = x1;
+        pbox->y1 = y1;
+        pbox->x2 = x2;
+        pbox->y2 = y2;
+        if (++pbox == &boxes[FB_SOLID_BATCH]) {
+            fbSolidBoxesClipped(pDrawable, pGC, pClip, boxes, pbox - boxes);
+            pbox = boxes;
+        }
+    }
+    if (pbox != boxes)
+        fbSolidBoxesClipped(pDrawable, pGC, pClip, boxes, pbox - boxes);
+}
+
 void
 fbPolyFillRect(DrawablePtr pDrawable, GCPtr pGC, int nrect, xRectangle *prect)
 {
@@ -38,6 +170,16 @@ fbPolyFillRect(DrawablePtr pDrawable, GCPtr pGC, int nrect, xRectangle *prect)
     int xorg, yorg;
     int n;
 
+    if (pGC->fillStyle == FillSolid) {
+        FbGCPrivPtr pPriv = fbGetGCPrivate(pGC);
+
+        if (RegionNumRects(pClip) == 1 ||
+            (nrect >= FB_SOLID_SWEEP_MIN && !(pPriv->and & pPriv->xor))) {
+            fbPolyFillRectSolid(pDrawable, pGC, nrect, prect);
+            return;
+        }
+    }
+
     xorg = pDrawable->x;
     yorg = pDrawable->y;
 
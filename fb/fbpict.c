@@ -34,6 +34,223 @@
 #include "picturestr.h"
 #include "mipict.h"
 #include "fbpict.h"
+#include "list.h"
+
+#ifndef FB_ACCESS_WRAPPER
+/*
+ * Composite-heavy clients use the same handful of pictures over and over,
+ * so fbComposite keeps the pixman image it built for each drawable
+ * picture.  A picture has two images: as a source or mask (no clip,
+ * transform adjusted for the drawable offset) and as a destination
+ * (composite clip applied).
+ *
+ * Every change to picture state reaches the screen through one of the
+ * ChangePicture* hooks or through ValidatePicture, the latter also
+ * whenever the drawable's clip or position changes, so those wrappers
+ * drop the cached images.  The backing pixmap is checked on each use, since its storage
+ * can be replaced without the picture knowing.  Pictures with an alpha
+ * map are not cached, as the alpha map's state is not tracked.
+ *
+ * With FB_ACCESS_WRAPPER every image must be bracketed by
+ * fbPrepareAccess/fbFinishAccess, so there is no cache.
+ */
+typedef struct {
+    pixman_image_t *image;
+    PixmapPtr pixmap;
+    void *bits;
+    int stride;
+    int width, height;
+    int pix_xoff, pix_yoff;     /* drawable offset within pixmap */
+    int xoff, yoff;             /* offsets image_from_pict returned */
+} FbPictImageRec, *FbPictImagePtr;
+
+typedef struct {
+    FbPictImageRec image[2];    /* as source, as destination */
+} FbPicturePrivRec, *FbPicturePrivPtr;
+
+typedef struct {
+    ChangePictureProcPtr ChangePicture;
+    ChangePictureClipProcPtr ChangePictureClip;
+    ValidatePictureProcPtr ValidatePicture;
+    ChangePictureTransformProcPtr ChangePictureTransform;
+    ChangePictureFilterProcPtr ChangePictureFilter;
+    DestroyPictureProcPtr DestroyPicture;
+} FbPictScreenPrivRec, *FbPictScreenPrivPtr;
+
+static DevPrivateKeyRec fbPicturePrivateKeyRec;
+static DevPrivateKeyRec fbPictScreenPrivateKeyRec;
+
+#define fbGetPicturePrivate(p) ((FbPicturePrivPtr) \
+    dixLookupPrivate(&(p)->devPrivates, &fbPicturePrivateKeyRec))
+#define fbGetPictScreenPrivate(s) ((FbPictScreenPrivPtr) \
+    dixLookupPrivate(&(s)->devPrivates, &fbPictScreenPrivateKeyRec))
+
+static void
+fbInvalidatePictureImages(PicturePtr pict)
+{
+    FbPicturePrivPtr priv = fbGetPicturePrivate(pict);
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (priv->image[i].image) {
+            pixman_image_unref(priv->image[i].image);
+            priv->image[i].image = NULL;
+        }
+    }
+}
+
+static pixman_image_t *
+cached_image_from_pict(PicturePtr pict, Bool has_clip, int *xoff, int *yoff)
+{
+    FbPictImagePtr c;
+    PixmapPtr pixmap;
+    pixman_image_t *image;
+    int pix_xoff, pix_yoff;
+
+    if (!pict || !pict->pDrawable || pict->alphaMap ||
+        !dixPrivateKeyRegistered(&fbPicturePrivateKeyRec))
+        return image_from_pict(pict, has_clip, xoff, yoff);
+
+    fbGetDrawablePixmap(pict->pDrawable, pixmap, pix_xoff, pix_yoff);
+    c = &fbGetPicturePrivate(pict)->image[has_clip ? 1 : 0];
+    if (c->image &&
+        c->pixmap == pixmap &&
+        c->bits == pixmap->devPrivate.ptr &&
+        c->stride == pixmap->devKind &&
+        c->width == pixmap->drawable.width &&
+        c->height == pixmap->drawable.height &&
+        c->pix_xoff == pix_xoff && c->pix_yoff == pix_yoff) {
+        *xoff = c->xoff;
+        *yoff = c->yoff;
+        return pixman_image_ref(c->image);
+    }
+
+    if (c->image) {
+        pixman_image_unref(c->image);
+        c->image = NULL;
+    }
+
+    image = image_from_pict(pict, has_clip, xoff, yoff);
+    if (image) {
+        c->image = pixman_image_ref(image);
+        c->pixmap = pixmap;
+        c->bits = pixmap->devPrivate.ptr;
+        c->stride = pixmap->devKind;
+        c->width = pixmap->drawable.width;
+        c->height = pixmap->drawable.height;
+        c->pix_xoff = pix_xoff;
+        c->pix_yoff = pix_yoff;
+        c->xoff = *xoff;
+        c->yoff = *yoff;
+    }
+    return image;
+}
+
+static void
+fbChangePicture(PicturePtr pPicture, Mask mask)
+{
+    FbPictScreenPrivPtr fbps =
+        fbGetPictScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbInvalidatePictureImages(pPicture);
+    (*fbps->ChangePicture) (pPicture, mask);
+}
+
+static int
+fbChangePictureClip(PicturePtr pPicture, int type, void *value, int n)
+{
+    FbPictScreenPrivPtr fbps =
+        fbGetPictScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbInvalidatePictureImages(pPicture);
+    return (*fbps->ChangePictureClip) (pPicture, type, value, n);
+}
+
+static void
+fbValidatePicture(PicturePtr pPicture, Mask mask)
+{
+    FbPictScreenPrivPtr fbps =
+        fbGetPictScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbInvalidatePictureImages(pPicture);
+    (*fbps->ValidatePicture) (pPicture, mask);
+}
+
+static int
+fbChangePictureTransform(PicturePtr pPicture, PictTransform * transform)
+{
+    FbPictScreenPrivPtr fbps =
+        fbGetPictScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbInvalidatePictureImages(pPicture);
+    return (*fbps->ChangePictureTransform) (pPicture, transform);
+}
+
+static int
+fbChangePictureFilter(PicturePtr pPicture, int filter, xFixed * params,
+                      int nparams)
+{
+    FbPictScreenPrivPtr fbps =
+        fbGetPictScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbInvalidatePictureImages(pPicture);
+    return (*fbps->ChangePictureFilter) (pPicture, filter, params, nparams);
+}
+
+static void
+fbDestroyPicture(PicturePtr pPicture)
+{
+    FbPictScreenPrivPtr fbps;
+
+    if (pPicture->pDrawable) {
+        fbps = fbGetPictScreenPrivate(pPicture->pDrawable->pScreen);
+        fbInvalidatePictureImages(pPicture);
+        (*fbps->DestroyPicture) (pPicture);
+    }
+}
+
+/**
+ * Wrap the picture state hooks of @pScreen so fbComposite can keep
+ * pixman images between calls.  The picture screen must already be set
+ * up; fbPictureInit calls this after miPictureInit.
+ */
+Bool
+fbPictureCacheInit(ScreenPtr pScreen)
+{
+    PictureScreenPtr ps = GetPictureScreen(pScreen);
+    FbPictScreenPrivPtr fbps;
+
+    if (!dixRegisterPrivateKey(&fbPicturePrivateKeyRec, PRIVATE_PICTURE,
+                               sizeof(FbPicturePrivRec)))
+        return FALSE;
+    if (!dixRegisterPrivateKey(&fbPictScreenPrivateKeyRec, PRIVATE_SCREEN,
+                               sizeof(FbPictScreenPrivRec)))
+        return FALSE;
+
+    fbps = fbGetPictScreenPrivate(pScreen);
+    fbps->ChangePicture = ps->ChangePicture;
+    fbps->ChangePictureClip = ps->ChangePictureClip;
+    fbps->ValidatePicture = ps->ValidatePicture;
+    fbps->ChangePictureTransform = ps->ChangePictureTransform;
+    fbps->ChangePictureFilter = ps->ChangePictureFilter;
+    fbps->DestroyPicture = ps->DestroyPicture;
+    ps->ChangePicture = fbChangePicture;
+    ps->ChangePictureClip = fbChangePictureClip;
+    ps->ValidatePicture = fbValidatePicture;
+    ps->ChangePictureTransform = fbChangePictureTransform;
+    ps->ChangePictureFilter = fbChangePictureFilter;
+    ps->DestroyPicture = fbDestroyPicture;
+    return TRUE;
+}
+#else
+#define cached_image_from_pict image_from_pict
+
+Bool
+fbPictureCacheInit(ScreenPtr pScreen)
+{
+    return TRUE;
+}
+#endif
 
 void
 fbComposite(CARD8 op,
@@ -54,9 +271,9 @@ fbComposite(CARD8 op,
     if (pMask)
         miCompositeSourceValidate(pMask);
 
-    src = image_from_pict(pSrc, FALSE, &src_xoff, &src_yoff);
-    mask = image_from_pict(pMask, FALSE, &msk_xoff, &msk_yoff);
-    dest = image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
+    src = cached_image_from_pict(pSrc, FALSE, &src_xoff, &src_yoff);
+    mask = cached_image_from_pict(pMask, FALSE, &msk_xoff, &msk_yoff);
+    dest = cached_image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
 
     if (src && dest && !(pMask && !mask)) {
         pixman_image_composite(op, src, mask, dest,
@@ -70,24 +287,141 @@ fbComposite(CARD8 op,
     free_pixman_pict(pDst, dest);
 }
 
+/*
+ * fbGlyphs keeps one pixman glyph cache for all screens.  Pixman only
+ * bounds it by glyph count, and glyph images can be large, so the cached
+ * glyphs are also kept on a list in order of use together with the bytes
+ * their images take.  With a budget set, each fbGlyphs call ends by
+ * dropping the least recently used glyphs until the cache fits.
+ *
+ * Pixman sweeps its cache on thaw once the glyphs plus removed entries
+ * in its table pass FB_GLYPH_CACHE_SWEEP, and drops glyphs without
+ * telling us.  All of its glyphs are on the list and all removals go
+ * through here, so as long as the two together stay below that the
+ * accounting is exact; past it the cache is started afresh instead.
+ */
+#define FB_GLYPH_CACHE_SWEEP 16384
+typedef struct {
+    struct xorg_list lru;       /* on glyphLRU while cached */
+    GlyphPtr glyph;
+    size_t bytes;
+} FbGlyphPrivRec, *FbGlyphPrivPtr;
+
+static DevPrivateKeyRec fbGlyphPrivateKeyRec;
+
 static pixman_glyph_cache_t *glyphCache;
+static struct xorg_list glyphLRU = { &glyphLRU, &glyphLRU };
+static FbGlyphCacheStatsRec glyphStats;
+static unsigned long glyphRemovals;     /* since glyphCache was created */
 
-void
-fbDestroyGlyphCache(void)
+static FbGlyphPrivPtr
+fbGetGlyphPrivate(GlyphPtr glyph)
+{
+    if (!dixPrivateKeyRegistered(&fbGlyphPrivateKeyRec))
+        return NULL;
+    return dixGetPrivateAddr(&glyph->devPrivates, &fbGlyphPrivateKeyRec);
+}
+
+/* glyph privates start out zeroed, so a NULL link is not on the list */
+static Bool
+fbGlyphIsTracked(FbGlyphPrivPtr priv)
+{
+    return priv->lru.next && !xorg_list_is_empty(&priv->lru);
+}
+
+static void
+fbGlyphForget(FbGlyphPrivPtr priv)
+{
+    xorg_list_del(&priv->lru);
+    glyphStats.bytes -= priv->bytes;
+    glyphStats.glyphs--;
+    priv->bytes = 0;
+}
+
+static void
+fbTrimGlyphCache(void)
+{
+    FbGlyphPrivPtr priv;
+
+    while (glyphStats.bytes > glyphStats.budget &&
+           !xorg_list_is_empty(&glyphLRU)) {
+        priv = xorg_list_last_entry(&glyphLRU, FbGlyphPrivRec, lru);
+        pixman_glyph_cache_remove(glyphCache, priv->glyph, NULL);
+        glyphRemovals++;
+        fbGlyphForget(priv);
+        glyphStats.evictions++;
+    }
+}
+
+static void
+fbFlushGlyphCache(void)
 {
+    FbGlyphPrivPtr priv, tmp;
+
     if (glyphCache)
     {
 	pixman_glyph_cache_destroy (glyphCache);
 	glyphCache = NULL;
     }
+    glyphRemovals = 0;
+    xorg_list_for_each_entry_safe(priv, tmp, &glyphLRU, lru)
+        fbGlyphForget(priv);
+}
+
+/**
+ * Set up the glyph private fbGlyphs uses to account for its cache.
+ * Must be called before any glyph is allocated; fbPictureInit does.
+ */
+Bool
+fbGlyphCacheInit(void)
+{
+    return dixRegisterPrivateKey(&fbGlyphPrivateKeyRec, PRIVATE_GLYPH,
+                                 sizeof(FbGlyphPrivRec));
+}
+
+/**
+ * Limit the glyph images cached by fbGlyphs to about @bytes; 0 lets the
+ * cache grow until pixman's own glyph count limit.
+ */
+void
+fbSetGlyphCacheBudget(size_t bytes)
+{
+    glyphStats.budget = bytes;
+    if (glyphCache && bytes)
+        fbTrimGlyphCache();
+}
+
+void
+fbGetGlyphCacheStats(FbGlyphCacheStatsPtr stats)
+{
+    *stats = glyphStats;
+}
+
+void
+fbDestroyGlyphCache(void)
+{
+    if (glyphCache)
+        LogMessageVerb(X_INFO, 3, "fb: glyph cache: %lu hits, %lu misses, "
+                       "%lu evictions, %lu glyphs in %lu of %lu bytes\n",
+                       glyphStats.hits, glyphStats.misses,
+                       glyphStats.evictions, glyphStats.glyphs,
+                       (unsigned long) glyphStats.bytes,
+                       (unsigned long) glyphStats.budget);
+    fbFlushGlyphCache();
 }
 
 void
 fbUnrealizeGlyph(ScreenPtr pScreen,
 		 GlyphPtr pGlyph)
 {
+    FbGlyphPrivPtr priv = fbGetGlyphPrivate(pGlyph);
+
     if (glyphCache)
 	pixman_glyph_cache_remove (glyphCache, pGlyph, NULL);
+    if (priv && fbGlyphIsTracked(priv)) {
+        glyphRemovals++;
+        fbGlyphForget(priv);
+    }
 }
 
 void
@@ -107,6 +441,7 @@ fbGlyphs(CARD8 op,
     pixman_image_t *srcImage, *dstImage;
     int srcXoff, srcYoff, dstXoff, dstYoff;
     GlyphPtr glyph;
+    FbGlyphPrivPtr priv;
     int n_glyphs;
     int x, y;
     int i, n;
@@ -138,12 +473,25 @@ fbGlyphs(CARD8 op,
 	    const void *g;
 
             glyph = *glyphs++;
+	    priv = fbGetGlyphPrivate(glyph);
 
-	    if (!(g = pixman_glyph_cache_lookup (glyphCache, glyph, NULL))) {
+	    if ((g = pixman_glyph_cache_lookup (glyphCache, glyph, NULL))) {
+		glyphStats.hits++;
+		if (priv && fbGlyphIsTracked(priv)) {
+		    xorg_list_del(&priv->lru);
+		    xorg_list_add(&priv->lru, &glyphLRU);
+		}
+	    }
+	    else {
 		pixman_image_t *glyphImage;
 		PicturePtr pPicture;
 		int xoff, yoff;
 
+		glyphStats.misses++;
+		/* pixman dropped it behind our back */
+		if (priv && fbGlyphIsTracked(priv))
+		    fbGlyphForget(priv);
+
 		pPicture = GetGlyphPicture(glyph, pScreen);
 		if (!pPicture) {
 		    n_glyphs--;
@@ -158,6 +506,15 @@ fbGlyphs(CARD8 op,
 					      glyph->info.y,
 					      glyphImage);
 
+		if (g && priv) {
+		    priv->glyph = glyph;
+		    priv->bytes = pixman_image_get_stride(glyphImage) *
+			pixman_image_get_height(glyphImage);
+		    xorg_list_add(&priv->lru, &glyphLRU);
+		    glyphStats.bytes += priv->bytes;
+		    glyphStats.glyphs++;
+		}
+
 		free_pixman_pict(pPicture, glyphImage);
 
 		if (!g)
@@ -211,7 +568,15 @@ out_free_src:
     free_pixman_pict(pSrc, srcImage);
 
 out:
+    /* the glyphs of this call are the most recent, so they go last */
+    if (glyphStats.budget)
+	fbTrimGlyphCache();
     pixman_glyph_cache_thaw(glyphCache);
+    /* pixman may have swept glyphs we still count, forget them all */
+    if (glyphStats.glyphs + glyphRemovals > FB_GLYPH_CACHE_SWEEP) {
+	glyphStats.evictions += glyphStats.glyphs;
+	fbFlushGlyphCache();
+    }
     if (pglyphs != stack_glyphs)
 	free(pglyphs);
 }
@@ -501,6 +866,8 @@ fbPictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats)
 
     if (!miPictureInit(pScreen, formats, nformats))
         return FALSE;
+    if (!fbGlyphCacheInit())
+        return FALSE;
     ps = GetPictureScreen(pScreen);
     ps->Composite = fbComposite;
     ps->Glyphs = fbGlyphs;
@@ -512,5 +879,5 @@ fbPictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats)
     ps->AddTriangles = fbAddTriangles;
     ps->Triangles = fbTriangles;
 
-    return TRUE;
+    return fbPictureCacheInit(pScreen);
 }
@@ -31,6 +31,7 @@
 extern int KdTsPhyScreen;
 
 const char *fbdevDevicePath = NULL;
+int fbdevShadowThreads = 0;
 
 static Bool
 fbdevInitialize(KdCardInfo * card, FbdevPriv * priv)
@@ -712,6 +713,10 @@ fbdevFinishInitScreen(ScreenPtr pScreen)
     if (!shadowSetup(pScreen))
         return FALSE;
 
+    if (fbdevShadowThreads > 1 &&
+        !shadowSetUpdateThreads(pScreen, fbdevShadowThreads))
+        ErrorF("Cannot start shadow update threads, updating serially\n");
+
 #ifdef RANDR
     if (!fbdevRandRInit(pScreen))
         return FALSE;
@@ -24,6 +24,8 @@
 #include <kdrive-config.h>
 #endif
 #include <fbdev.h>
+#include <errno.h>
+#include <limits.h>
 
 void
 InitCard(char *name)
@@ -57,6 +59,9 @@ ddxUseMsg(void)
     ErrorF("\nXfbdev Device Usage:\n");
     ErrorF
         ("-fb path         Framebuffer device to use. Defaults to /dev/fb0\n");
+    ErrorF
+        ("-shadowthreads n Update the framebuffer from the shadow on n threads\n"
+         "                 (applies to every screen)\n");
     ErrorF("\n");
 }
 
@@ -72,6 +77,25 @@ ddxProcessArgument(int argc, char **argv, int i)
         exit(1);
     }
 
+    if (!strcmp(argv[i], "-shadowthreads")) {
+        if (i + 1 < argc) {
+            char *end;
+            long n;
+
+            errno = 0;
+            n = strtol(argv[i + 1], &end, 10);
+            if (argv[i + 1][0] == '\0' || *end != '\0' || errno ||
+                n < 0 || n > INT_MAX) {
+                UseMsg();
+                FatalError("Invalid -shadowthreads: %s\n", argv[i + 1]);
+            }
+            fbdevShadowThreads = n;
+            return 2;
+        }
+        UseMsg();
+        exit(1);
+    }
+
     return KdProcessArgument(argc, argv, i);
 }
 
@@ -43,7 +43,9 @@
 #include <execinfo.h>
 #endif
 
+#include <errno.h>
 #include <signal.h>
+#include <stdint.h>
 
 typedef struct _kdDepths {
     CARD8 depth;
@@ -444,6 +446,8 @@ KdUseMsg(void)
         ("-origin X,Y      Locates the next screen in the the virtual screen (Xinerama)\n");
     ErrorF("-switchCmd       Command to execute on vt switch\n");
     ErrorF("-zap             Terminate server on Ctrl+Alt+Backspace\n");
+    ErrorF
+        ("-glyphcache KB    Limit the images of cached glyphs to KB kilobytes\n");
     ErrorF
         ("vtxx             Use virtual terminal xx instead of the next available\n");
 }
@@ -536,6 +540,24 @@ KdProcessArgument(int argc, char **argv, int i)
             UseMsg();
         return 2;
     }
+    if (!strcmp(argv[i], "-glyphcache")) {
+        if ((i + 1) < argc) {
+            char *end;
+            long kb;
+
+            errno = 0;
+            kb = strtol(argv[i + 1], &end, 10);
+            if (argv[i + 1][0] == '\0' || *end != '\0' || errno ||
+                kb < 0 || (unsigned long) kb > SIZE_MAX / 1024) {
+                UseMsg();
+                FatalError("Invalid -glyphcache: %s\n", argv[i + 1]);
+            }
+            fbSetGlyphCacheBudget((size_t) kb * 1024);
+        }
+        else
+            UseMsg();
+        return 2;
+    }
     if (!strncmp(argv[i], "vt", 2) &&
         sscanf(argv[i], "vt%2d", &kdVirtualTerminal) == 1) {
         return 1;
@@ -293,7 +293,8 @@ xf86Wakeup(void *blockData, int err, void *pReadmask)
 
 /*
  * xf86SigioReadInput --
- *    signal handler for the SIGIO signal.
+ *    signal handler for the SIGIO signal, also used as the input
+ *    thread's read procedure.
  */
 static void
 xf86SigioReadInput(int fd, void *closure)
@@ -313,7 +314,11 @@ xf86SigioReadInput(int fd, void *closure)
 void
 xf86AddEnabledDevice(InputInfoPtr pInfo)
 {
-    if (!xf86InstallSIGIOHandler(pInfo->fd, xf86SigioReadInput, pInfo)) {
+    if (InputThreadRegisterDev(pInfo->fd, xf86SigioReadInput, pInfo))
+        return;
+    /* A SIGIO handler would race the input thread's producers in mieq */
+    if (InputThreadRunning() ||
+        !xf86InstallSIGIOHandler(pInfo->fd, xf86SigioReadInput, pInfo)) {
         AddEnabledDevice(pInfo->fd);
     }
 }
@@ -325,6 +330,8 @@ xf86AddEnabledDevice(InputInfoPtr pInfo)
 void
 xf86RemoveEnabledDevice(InputInfoPtr pInfo)
 {
+    if (InputThreadUnregisterDev(pInfo->fd))
+        return;
     if (!xf86RemoveSIGIOHandler(pInfo->fd)) {
         RemoveEnabledDevice(pInfo->fd);
     }
@@ -422,6 +422,8 @@ xf86CrtcRotate(xf86CrtcPtr crtc)
                                                             pScreen);
                 if (!xf86_config->rotation_damage)
                     goto bail2;
+                DamageSetBatching(xf86_config->rotation_damage,
+                                  DAMAGE_BATCH_LIMIT);
 
                 /* Wrap block handler */
                 if (!xf86_config->BlockHandler) {
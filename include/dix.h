@@ -516,6 +516,9 @@ TryClientEvents(ClientPtr /*client */ ,
 extern _X_EXPORT void
 WindowsRestructured(void);
 
+/* bumped whenever viewable windows may have moved, restacked or mapped */
+extern _X_EXPORT unsigned long windowTreeSerial;
+
 extern int
 SetClientPointer(ClientPtr /* client */ ,
                  DeviceIntPtr /* device */ );
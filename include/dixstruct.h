@@ -106,6 +106,15 @@ typedef struct _Client {
 
     int smart_start_tick;
     int smart_stop_tick;
+    int smart_ready_tick;       /* when first seen ready but not yet run */
+    int smart_max_wait;         /* longest ready-to-run delay, msec */
+    int smart_latency;          /* latency-sensitive references */
+    unsigned int smart_waiting:1;
+    unsigned int smart_sensitive:1;     /* was ever latency sensitive */
+    unsigned int smart_presents:1;      /* has used PresentPixmap */
+    CARD32 smart_requests;
+    CARD32 smart_slices;
+    CARD64 smart_busy;          /* usec spent dispatching requests */
 
     DeviceIntPtr clientPtr;
     ClientIdPtr clientIds;
@@ -131,6 +140,8 @@ extern _X_EXPORT long SmartScheduleInterval;
 extern _X_EXPORT long SmartScheduleSlice;
 extern _X_EXPORT long SmartScheduleMaxSlice;
 extern _X_EXPORT Bool SmartScheduleDisable;
+extern _X_EXPORT int SmartSchedulePolicy;
+extern _X_EXPORT long SmartScheduleLatency;
 extern _X_EXPORT void
 SmartScheduleStartTimer(void);
 extern _X_EXPORT void
@@ -139,6 +150,17 @@ SmartScheduleStopTimer(void);
 #define SMART_MAX_PRIORITY  (20)
 #define SMART_MIN_PRIORITY  (-20)
 
+#define SMART_POLICY_CLASSIC    0
+#define SMART_POLICY_LATENCY    1
+
+/*
+ * Mark a client as latency sensitive (compositing manager, Present
+ * client).  Calls nest; each TRUE must be matched by a FALSE.  Under
+ * the latency policy such clients run ahead of bulk clients.
+ */
+extern _X_EXPORT void
+SmartScheduleClientLatency(ClientPtr /* pClient */ , Bool /* latency */ );
+
 extern _X_EXPORT void
 SmartScheduleInit(void);
 
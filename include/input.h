@@ -128,6 +128,7 @@ typedef struct _SpriteRec *SpritePtr;
 typedef struct _TouchClassRec *TouchClassPtr;
 typedef struct _TouchPointInfo *TouchPointInfoPtr;
 typedef struct _DDXTouchPointInfo *DDXTouchPointInfoPtr;
+typedef struct _TouchIdMap *TouchIdMapPtr;
 typedef union _GrabMask GrabMask;
 
 typedef struct _ValuatorMask ValuatorMask;
@@ -552,6 +553,11 @@ enum TouchListenerType {
     LISTENER_POINTER_REGULAR,
 };
 
+extern Bool TouchIdMapInit(TouchIdMapPtr map, int capacity);
+extern void TouchIdMapFree(TouchIdMapPtr map);
+extern int TouchIdMapFind(TouchIdMapPtr map, uint32_t id);
+extern void TouchIdMapAdd(TouchIdMapPtr map, uint32_t id, int index);
+extern void TouchIdMapRemove(TouchIdMapPtr map, uint32_t id);
 extern void TouchInitDDXTouchPoint(DeviceIntPtr dev,
                                    DDXTouchPointInfoPtr ddxtouch);
 extern DDXTouchPointInfoPtr TouchBeginDDXTouch(DeviceIntPtr dev,
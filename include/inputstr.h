@@ -336,11 +336,23 @@ typedef struct _DDXTouchPointInfo {
     ValuatorMask *valuators;    /* last axis values as posted, pre-transform */
 } DDXTouchPointInfoRec;
 
+/* Touch id to array index, open addressed. An empty map (no slots)
+ * makes the lookups fall back to scanning the touch array. */
+typedef struct _TouchIdMap {
+    struct _TouchIdSlot {
+        uint32_t id;
+        int index;              /* -1 if the slot is free */
+    } *slots;
+    unsigned int mask;          /* number of slots - 1 */
+    int count;                  /* ids in the map */
+} TouchIdMapRec;
+
 typedef struct _TouchClassRec {
     int sourceid;
     TouchPointInfoPtr touches;
     unsigned short num_touches; /* number of allocated touches */
     unsigned short max_touches; /* maximum number of touches, may be 0 */
+    TouchIdMapRec client_ids;   /* client_id of the active touches */
     CARD8 mode;                 /* ::XIDirectTouch, XIDependentTouch */
     /* for pointer-emulation */
     CARD8 buttonsDown;          /* number of buttons down */
@@ -580,6 +592,7 @@ typedef struct _DeviceIntRec {
         ValuatorMask *scroll;
         int num_touches;        /* size of the touches array */
         DDXTouchPointInfoPtr touches;
+        TouchIdMapRec touch_ids;        /* ddx_id of the active touches */
     } last;
 
     /* Input device property handling. */
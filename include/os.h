@@ -119,6 +119,10 @@ extern _X_EXPORT void SetCriticalOutputPending(void);
 extern _X_EXPORT int WriteToClient(ClientPtr /*who */ , int /*count */ ,
                                    const void * /*buf */ );
 
+extern _X_EXPORT int WriteToClientAndFree(ClientPtr /*who */ ,
+                                          int /*count */ ,
+                                          void * /*buf */ );
+
 extern _X_EXPORT void ResetOsBuffers(void);
 
 extern _X_EXPORT void InitConnectionLimits(void);
@@ -349,6 +353,41 @@ OsBlockSIGIO(void);
 extern _X_EXPORT void
 OsReleaseSIGIO(void);
 
+/*
+ * The input lock serialises the input thread against the main thread.
+ * It is recursive; OsBlockSIGIO takes it too, so existing SIGIO
+ * critical sections also exclude the input thread.  Inside a SIGIO
+ * handler it does nothing, the handler is kept out by signal masking.
+ */
+#ifdef INPUTTHREAD
+extern _X_EXPORT void
+input_lock(void);
+
+extern _X_EXPORT void
+input_unlock(void);
+#else
+static inline void input_lock(void) {}
+static inline void input_unlock(void) {}
+#endif
+
+typedef void (*InputThreadProcPtr) (int /* fd */ , void * /* data */ );
+
+extern _X_EXPORT Bool
+InputThreadRegisterDev(int /* fd */ , InputThreadProcPtr /* proc */ ,
+                       void * /* data */ );
+
+extern _X_EXPORT Bool
+InputThreadUnregisterDev(int /* fd */ );
+
+extern _X_EXPORT Bool
+InputThreadRunning(void);
+
+extern void
+InputThreadInit(void);
+
+extern void
+InputThreadFini(void);
+
 extern void
 OsResetSignals(void);
 
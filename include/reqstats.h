@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DIX_REQSTATS_H
+#define DIX_REQSTATS_H
+
+#include <signal.h>
+#include "misc.h"
+
+/*
+ * Per-request statistics: a call count, total and maximum time, and a
+ * log2 histogram of the time spent in each request's dispatch
+ * procedure, kept per major and (for extensions) minor opcode.
+ * Enabled with -reqstats; dumped to the log on a signal (SIGUSR2 unless
+ * -reqstatssignal picks another) and at reset.
+ */
+
+/* bucket 0 is < 1us, bucket n is [2^(n-1), 2^n) us, the last is open */
+#define REQSTATS_BUCKETS 16
+
+typedef struct _RequestStats {
+    CARD64 count;
+    CARD64 total;               /* usec */
+    CARD32 max;                 /* usec */
+    CARD32 hist[REQSTATS_BUCKETS];
+} RequestStatsRec, *RequestStatsPtr;
+
+extern Bool RequestStatsEnabled;
+extern int RequestStatsSignalNumber;
+extern volatile sig_atomic_t RequestStatsDumpPending;
+
+extern void RequestStatsInit(void);
+extern void RequestStatsRecord(int major, int minor, CARD64 usec);
+extern RequestStatsPtr RequestStatsLookup(int major, int minor);
+extern void RequestStatsDump(void);
+extern void RequestStatsReset(void);
+
+#endif                          /* DIX_REQSTATS_H */
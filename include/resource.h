@@ -278,8 +278,8 @@ extern _X_EXPORT RESTYPE TypeMask;
 
     @note This function is really only for handling
     INITHASHSIZE..MAXHASHSIZE bit hashes, but will handle any number
-    of bits by either masking numBits lower bits of the ID or by
-    providing at most MAXHASHSIZE hashes.
+    of bits by masking numBits lower bits of the ID.  From 11 bits up
+    the bits above numBits are folded in before masking.
 */
 extern _X_EXPORT int HashResourceID(XID id,
                                     int numBits);
@@ -438,6 +438,9 @@ extern _X_EXPORT int miValidateTree(WindowPtr /*pParent */ ,
                                     VTKind      /*kind */
     );
 
+extern _X_EXPORT Bool miIncrementalValidate;
+extern _X_EXPORT int miValidateTreeVisited;
+
 extern _X_EXPORT void miWideLine(DrawablePtr /*pDrawable */ ,
                                  GCPtr /*pGC */ ,
                                  int /*mode */ ,
@@ -106,6 +106,15 @@ wait_for_server_init(void)
         pthread_mutex_unlock(&serverRunningMutex);
     }
 }
+
+#define mieqLock()      pthread_mutex_lock(&miEventQueueMutex)
+#define mieqUnlock()    pthread_mutex_unlock(&miEventQueueMutex)
+#else
+/* The input lock serialises the input thread against the main thread.
+ * It does nothing inside a SIGIO handler, which stays the single
+ * lock-free producer it always was. */
+#define mieqLock()      input_lock()
+#define mieqUnlock()    input_unlock()
 #endif
 
 static size_t
@@ -122,7 +131,7 @@ mieqNumEnqueued(EventQueuePtr eventQueue)
     return n_enqueued;
 }
 
-/* Pre-condition: Called with miEventQueueMutex held */
+/* Pre-condition: Called with the queue locked */
 static Bool
 mieqGrowQueue(EventQueuePtr eventQueue, size_t new_nevents)
 {
@@ -252,8 +261,8 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
 
 #ifdef XQUARTZ
     wait_for_server_init();
-    pthread_mutex_lock(&miEventQueueMutex);
 #endif
+    mieqLock();
 
     verify_internal_event(e);
 
@@ -296,9 +305,7 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
             xorg_backtrace();
         }
 
-#ifdef XQUARTZ
-        pthread_mutex_unlock(&miEventQueueMutex);
-#endif
+        mieqUnlock();
         return;
     }
 
@@ -319,9 +326,7 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
 
     miEventQueue.lastMotion = isMotion;
     miEventQueue.tail = (oldtail + 1) % miEventQueue.nevents;
-#ifdef XQUARTZ
-    pthread_mutex_unlock(&miEventQueueMutex);
-#endif
+    mieqUnlock();
 }
 
 /**
@@ -342,31 +347,23 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
 void
 mieqSwitchScreen(DeviceIntPtr pDev, ScreenPtr pScreen, Bool set_dequeue_screen)
 {
-#ifdef XQUARTZ
-    pthread_mutex_lock(&miEventQueueMutex);
-#endif
+    mieqLock();
     EnqueueScreen(pDev) = pScreen;
     if (set_dequeue_screen)
         DequeueScreen(pDev) = pScreen;
-#ifdef XQUARTZ
-    pthread_mutex_unlock(&miEventQueueMutex);
-#endif
+    mieqUnlock();
 }
 
 void
 mieqSetHandler(int event, mieqHandler handler)
 {
-#ifdef XQUARTZ
-    pthread_mutex_lock(&miEventQueueMutex);
-#endif
+    mieqLock();
     if (handler && miEventQueue.handlers[event])
         ErrorF("[mi] mieq: warning: overriding existing handler %p with %p for "
                "event %d\n", miEventQueue.handlers[event], handler, event);
 
     miEventQueue.handlers[event] = handler;
-#ifdef XQUARTZ
-    pthread_mutex_unlock(&miEventQueueMutex);
-#endif
+    mieqUnlock();
 }
 
 /**
@@ -595,9 +592,7 @@ mieqProcessInputEvents(void)
     DeviceIntPtr dev = NULL, master = NULL;
     size_t n_enqueued;
 
-#ifdef XQUARTZ
-    pthread_mutex_lock(&miEventQueueMutex);
-#endif
+    mieqLock();
 
     /* Grow our queue if we are reaching capacity: < 2 * QUEUE_RESERVED_SIZE remaining */
     n_enqueued = mieqNumEnqueued(&miEventQueue);
@@ -627,9 +622,7 @@ mieqProcessInputEvents(void)
 
         miEventQueue.head = (miEventQueue.head + 1) % miEventQueue.nevents;
 
-#ifdef XQUARTZ
-        pthread_mutex_unlock(&miEventQueueMutex);
-#endif
+        mieqUnlock();
 
         master = (dev) ? GetMaster(dev, MASTER_ATTACHED) : NULL;
 
@@ -659,11 +652,7 @@ mieqProcessInputEvents(void)
               event.device_event.flags & TOUCH_POINTER_EMULATED)))
             miPointerUpdateSprite(dev);
 
-#ifdef XQUARTZ
-        pthread_mutex_lock(&miEventQueueMutex);
-#endif
+        mieqLock();
     }
-#ifdef XQUARTZ
-    pthread_mutex_unlock(&miEventQueueMutex);
-#endif
+    mieqUnlock();
 }
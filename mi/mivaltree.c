@@ -102,6 +102,79 @@ Equipment Corporation.
 
 #include    "globals.h"
 
+/*
+ * With incremental validation, a marked window that has not itself moved,
+ * been resized or reshaped and was viewable before only has its clips
+ * recomputed where its new borderClip differs from the old one.  Outside
+ * that area the old clipList still holds, and children that don't reach
+ * into it, or into any marked child, are left out of the region work
+ * entirely.  This is what a popup moving over a window with many
+ * children hits.
+ */
+Bool miIncrementalValidate = TRUE;
+
+/*
+ * Windows the last miValidateTree computed clips for, or clipped their
+ * siblings against.
+ */
+int miValidateTreeVisited;
+
+static Bool
+miBoxesOverlap(BoxPtr a, BoxPtr b)
+{
+    return a->x1 < b->x2 && b->x1 < a->x2 && a->y1 < b->y2 && b->y1 < a->y2;
+}
+
+static void
+miBoxExtend(BoxPtr box, BoxPtr by)
+{
+    box->x1 = min(box->x1, by->x1);
+    box->y1 = min(box->y1, by->y1);
+    box->x2 = max(box->x2, by->x2);
+    box->y2 = max(box->y2, by->y2);
+}
+
+/*
+ * An unmarked child outside the interesting area covers nothing whose
+ * clip is being recomputed and keeps its own clips.  A marked one is
+ * always visited, even with an empty or far away borderSize, as its
+ * valdata has to be filled in for miHandleValidateExposures.
+ */
+static Bool
+miChildOfInterest(WindowPtr pChild, BoxPtr interest)
+{
+    return pChild->valdata ||
+        miBoxesOverlap(RegionExtents(&pChild->borderSize), interest);
+}
+
+/*
+ * Nothing changed for pParent or below; just leave the marked windows
+ * with empty exposures for miHandleValidateExposures.
+ */
+static void
+miTreeUnchanged(WindowPtr pParent)
+{
+    WindowPtr pChild = pParent;
+
+    while (1) {
+        if (pChild->viewable) {
+            if (pChild->valdata) {
+                RegionNull(&pChild->valdata->after.borderExposed);
+                RegionNull(&pChild->valdata->after.exposed);
+            }
+            if (pChild->firstChild) {
+                pChild = pChild->firstChild;
+                continue;
+            }
+        }
+        while (!pChild->nextSib && (pChild != pParent))
+            pChild = pChild->parent;
+        if (pChild == pParent)
+            break;
+        pChild = pChild->nextSib;
+    }
+}
+
 /*
  * Compute the visibility of a shaped window
  */
@@ -215,6 +288,9 @@ miComputeClips(WindowPtr pParent,
     RegionRec childUnion;
     Bool overlap;
     RegionPtr borderVisible;
+    Bool incremental;
+    RegionRec changed;          /* where universe differs from borderClip */
+    BoxRec interest;            /* changed area plus marked children */
 
     /*
      * Figure out the new visibility of this window.
@@ -280,6 +356,7 @@ miComputeClips(WindowPtr pParent,
         newVis = VisibilityFullyObscured;
         break;
     }
+    miValidateTreeVisited++;
     pParent->visibility = newVis;
     if (oldVis != newVis &&
         ((pParent->
@@ -358,6 +435,33 @@ miComputeClips(WindowPtr pParent,
     }
 
     borderVisible = pParent->valdata->before.borderVisible;
+
+    incremental = miIncrementalValidate && kind != VTBroken &&
+        !dx && !dy && !pParent->valdata->before.resized && !borderVisible &&
+        oldVis != VisibilityNotViewable;
+#ifdef COMPOSITE
+    if (pParent->redirectDraw != RedirectDrawNone)
+        incremental = FALSE;
+#endif
+    if (incremental) {
+        RegionNull(&changed);
+        RegionNull(&childUniverse);
+        RegionSubtract(&changed, universe, &pParent->borderClip);
+        RegionSubtract(&childUniverse, &pParent->borderClip, universe);
+        RegionUnion(&changed, &changed, &childUniverse);
+        RegionUninit(&childUniverse);
+        if (!RegionNotEmpty(&changed)) {
+            RegionUninit(&changed);
+            miTreeUnchanged(pParent);
+            return;
+        }
+        interest = *RegionExtents(&changed);
+        for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib)
+            if (pChild->viewable && pChild->valdata &&
+                RegionNotEmpty(&pChild->borderSize))
+                miBoxExtend(&interest, RegionExtents(&pChild->borderSize));
+    }
+
     RegionNull(&pParent->valdata->after.borderExposed);
     RegionNull(&pParent->valdata->after.exposed);
 
@@ -410,19 +514,24 @@ miComputeClips(WindowPtr pParent,
             ((pChild->drawable.y == pParent->lastChild->drawable.y) &&
              (pChild->drawable.x < pParent->lastChild->drawable.x))) {
             for (; pChild; pChild = pChild->nextSib) {
-                if (pChild->viewable && !TreatAsTransparent(pChild))
+                if (pChild->viewable && !TreatAsTransparent(pChild) &&
+                    (!incremental || miChildOfInterest(pChild, &interest)))
                     RegionAppend(&childUnion, &pChild->borderSize);
             }
         }
         else {
             for (pChild = pParent->lastChild; pChild; pChild = pChild->prevSib) {
-                if (pChild->viewable && !TreatAsTransparent(pChild))
+                if (pChild->viewable && !TreatAsTransparent(pChild) &&
+                    (!incremental || miChildOfInterest(pChild, &interest)))
                     RegionAppend(&childUnion, &pChild->borderSize);
             }
         }
         RegionValidate(&childUnion, &overlap);
 
         for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+            if (pChild->viewable && incremental &&
+                !miChildOfInterest(pChild, &interest))
+                continue;
             if (pChild->viewable) {
                 /*
                  * If the child is viewable, we want to remove its extents
@@ -439,6 +548,8 @@ miComputeClips(WindowPtr pParent,
                     miComputeClips(pChild, pScreen, &childUniverse, kind,
                                    exposed);
                 }
+                else
+                    miValidateTreeVisited++;
                 /*
                  * Once the child has been processed, we remove its extents
                  * from the current universe, thus denying its space to any
@@ -454,6 +565,21 @@ miComputeClips(WindowPtr pParent,
         RegionUninit(&childUniverse);
     }                           /* if any children */
 
+    /*
+     * Incrementally, 'universe' is only right inside the changed area;
+     * the old clipList is still good everywhere else.
+     */
+    if (incremental) {
+        RegionRec kept;
+
+        RegionNull(&kept);
+        RegionIntersect(universe, universe, &changed);
+        RegionSubtract(&kept, &pParent->clipList, &changed);
+        RegionUnion(universe, universe, &kept);
+        RegionUninit(&kept);
+        RegionUninit(&changed);
+    }
+
     /*
      * 'universe' now contains the new clipList for the parent window.
      *
@@ -571,6 +697,10 @@ miValidateTree(WindowPtr pParent,       /* Parent to validate */
     if (pChild == NullWindow)
         pChild = pParent->firstChild;
 
+    /* DDXen may move windows without going through WindowsRestructured */
+    windowTreeSerial++;
+    miValidateTreeVisited = 0;
+
     RegionNull(&childClip);
     RegionNull(&exposed);
 
@@ -748,5 +878,7 @@ miValidateTree(WindowPtr pParent,       /* Parent to validate */
     RegionUninit(&exposed);
     if (pScreen->ClipNotify)
         (*pScreen->ClipNotify) (pParent, 0, 0);
+    LogMessageVerb(X_INFO, 10, "ValidateTree: %d windows visited\n",
+                   miValidateTreeVisited);
     return 1;
 }
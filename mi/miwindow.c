@@ -760,49 +760,271 @@ miSegregateChildren(WindowPtr pWin, RegionPtr pReg, int depth)
     }
 }
 
-WindowPtr
-miSpriteTrace(SpritePtr pSprite, int x, int y)
+/*
+ * Can the pointer at x/y be in pWin?  Tests the border box, the bounding
+ * and input shapes, and whether the window is mapped at all.
+ */
+static Bool
+miPointInWindow(WindowPtr pWin, int x, int y)
 {
-    WindowPtr pWin;
     BoxRec box;
 
-    pWin = DeepestSpriteWin(pSprite)->firstChild;
-    while (pWin) {
-        if ((pWin->mapped) &&
-            (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
-            (x < pWin->drawable.x + (int) pWin->drawable.width +
-             wBorderWidth(pWin)) &&
-            (y >= pWin->drawable.y - wBorderWidth(pWin)) &&
-            (y < pWin->drawable.y + (int) pWin->drawable.height +
-             wBorderWidth(pWin))
-            /* When a window is shaped, a further check
-             * is made to see if the point is inside
-             * borderSize
-             */
-            && (!wBoundingShape(pWin) || PointInBorderSize(pWin, x, y))
-            && (!wInputShape(pWin) ||
-                RegionContainsPoint(wInputShape(pWin),
-                                    x - pWin->drawable.x,
-                                    y - pWin->drawable.y, &box))
+    return (pWin->mapped) &&
+        (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
+        (x < pWin->drawable.x + (int) pWin->drawable.width +
+         wBorderWidth(pWin)) &&
+        (y >= pWin->drawable.y - wBorderWidth(pWin)) &&
+        (y < pWin->drawable.y + (int) pWin->drawable.height +
+         wBorderWidth(pWin))
+        /* When a window is shaped, a further check
+         * is made to see if the point is inside
+         * borderSize
+         */
+        && (!wBoundingShape(pWin) || PointInBorderSize(pWin, x, y))
+        && (!wInputShape(pWin) ||
+            RegionContainsPoint(wInputShape(pWin),
+                                x - pWin->drawable.x,
+                                y - pWin->drawable.y, &box))
 #ifdef ROOTLESS
-            /* In rootless mode windows may be offscreen, even when
-             * they're in X's stack. (E.g. if the native window system
-             * implements some form of virtual desktop system).
-             */
-            && !pWin->rootlessUnhittable
+        /* In rootless mode windows may be offscreen, even when
+         * they're in X's stack. (E.g. if the native window system
+         * implements some form of virtual desktop system).
+         */
+        && !pWin->rootlessUnhittable
 #endif
-            ) {
-            if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
-                pSprite->spriteTraceSize += 10;
-                pSprite->spriteTrace = realloc(pSprite->spriteTrace,
-                                               pSprite->spriteTraceSize *
-                                               sizeof(WindowPtr));
-            }
-            pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
-            pWin = pWin->firstChild;
+        ;
+}
+
+/*
+ * Picking walks the children of each window along the trace front to
+ * back, which is slow for parents with hundreds of toplevels.  When that
+ * walk gets long, the parent gets a grid over the border boxes of its
+ * mapped children.  Each cell lists the children overlapping it in
+ * stacking order, so picking only tests those.  Children that cover
+ * many cells sit on one list of big windows instead, which is merged
+ * with the cell's list by stacking order.
+ *
+ * The index is only a filter: every candidate still goes through
+ * miPointInWindow.  It is rebuilt when windowTreeSerial has changed,
+ * but only once the same serial has been seen twice, so dragging a
+ * window around doesn't rebuild it on every motion event.
+ */
+#define PICK_INDEX_THRESHOLD	32      /* siblings walked before indexing */
+#define PICK_INDEX_MAX_DIM	64      /* cells per row and column */
+#define PICK_INDEX_BIG_CELLS	16      /* cells covered by a big window */
+
+typedef struct _WindowPickIndex {
+    unsigned long serial;       /* windowTreeSerial it was built for */
+    unsigned long pending;      /* newer serial already seen once */
+    int x, y;                   /* top left corner of the grid */
+    int cellWidth, cellHeight;
+    int cols, rows;
+    int nbig;
+    WindowPtr *children;        /* mapped children, front to back */
+    int *big;                   /* ranks into children */
+    int *cellStart;             /* cols * rows + 1 offsets into cellRanks */
+    int *cellRanks;
+} WindowPickIndexRec, *WindowPickIndexPtr;
+
+static void
+miPickIndexSpan(WindowPickIndexPtr index, WindowPtr pWin,
+                int *cx1, int *cy1, int *cx2, int *cy2)
+{
+    int bw = wBorderWidth(pWin);
+
+    *cx1 = (pWin->drawable.x - bw - index->x) / index->cellWidth;
+    *cy1 = (pWin->drawable.y - bw - index->y) / index->cellHeight;
+    *cx2 = (pWin->drawable.x + (int) pWin->drawable.width + bw - 1 -
+            index->x) / index->cellWidth;
+    *cy2 = (pWin->drawable.y + (int) pWin->drawable.height + bw - 1 -
+            index->y) / index->cellHeight;
+}
+
+static Bool
+miPickIndexIsBig(int cx1, int cy1, int cx2, int cy2)
+{
+    return (cx2 - cx1 + 1) * (cy2 - cy1 + 1) > PICK_INDEX_BIG_CELLS;
+}
+
+/*
+ * Build the index of pParent's mapped children; the whole index is one
+ * allocation so the window code can free it without knowing its layout.
+ */
+static WindowPickIndexPtr
+miPickIndexBuild(WindowPtr pParent)
+{
+    WindowPickIndexRec grid;
+    WindowPickIndexPtr index;
+    WindowPtr pWin;
+    int x1 = MAXSHORT, y1 = MAXSHORT, x2 = MINSHORT, y2 = MINSHORT;
+    int cx1, cy1, cx2, cy2, cx, cy, c;
+    int n = 0, nbig = 0, entries = 0, ncells, dim, rank;
+    size_t size;
+
+    for (pWin = pParent->firstChild; pWin; pWin = pWin->nextSib) {
+        int bw = wBorderWidth(pWin);
+
+        if (!pWin->mapped)
+            continue;
+        n++;
+        x1 = min(x1, pWin->drawable.x - bw);
+        y1 = min(y1, pWin->drawable.y - bw);
+        x2 = max(x2, pWin->drawable.x + (int) pWin->drawable.width + bw);
+        y2 = max(y2, pWin->drawable.y + (int) pWin->drawable.height + bw);
+    }
+    if (x1 >= x2 || y1 >= y2)
+        x1 = y1 = 0, x2 = y2 = 1;
+
+    /* about one child per cell */
+    dim = 1;
+    while (dim * dim < n && dim < PICK_INDEX_MAX_DIM)
+        dim++;
+    memset(&grid, 0, sizeof(grid));
+    grid.x = x1;
+    grid.y = y1;
+    grid.cellWidth = (x2 - x1 + dim - 1) / dim;
+    grid.cellHeight = (y2 - y1 + dim - 1) / dim;
+    grid.cols = (x2 - x1 + grid.cellWidth - 1) / grid.cellWidth;
+    grid.rows = (y2 - y1 + grid.cellHeight - 1) / grid.cellHeight;
+    ncells = grid.cols * grid.rows;
+
+    for (pWin = pParent->firstChild; pWin; pWin = pWin->nextSib) {
+        if (!pWin->mapped)
+            continue;
+        miPickIndexSpan(&grid, pWin, &cx1, &cy1, &cx2, &cy2);
+        if (miPickIndexIsBig(cx1, cy1, cx2, cy2))
+            nbig++;
+        else
+            entries += (cx2 - cx1 + 1) * (cy2 - cy1 + 1);
+    }
+
+    size = sizeof(WindowPickIndexRec) + n * sizeof(WindowPtr) +
+        (nbig + ncells + 1 + entries) * sizeof(int);
+    index = calloc(1, size);
+    if (!index)
+        return NULL;
+    *index = grid;
+    index->serial = index->pending = windowTreeSerial;
+    index->children = (WindowPtr *) (index + 1);
+    index->big = (int *) (index->children + n);
+    index->cellStart = index->big + nbig;
+    index->cellRanks = index->cellStart + ncells + 1;
+
+    /* count the entries of each cell, then turn the counts into offsets */
+    rank = 0;
+    for (pWin = pParent->firstChild; pWin; pWin = pWin->nextSib) {
+        if (!pWin->mapped)
+            continue;
+        index->children[rank] = pWin;
+        miPickIndexSpan(index, pWin, &cx1, &cy1, &cx2, &cy2);
+        if (miPickIndexIsBig(cx1, cy1, cx2, cy2))
+            index->big[index->nbig++] = rank;
+        else
+            for (cy = cy1; cy <= cy2; cy++)
+                for (cx = cx1; cx <= cx2; cx++)
+                    index->cellStart[cy * grid.cols + cx + 1]++;
+        rank++;
+    }
+    for (c = 0; c < ncells; c++)
+        index->cellStart[c + 1] += index->cellStart[c];
+
+    /* fill in stacking order, using cellStart as the insertion points */
+    for (rank = 0; rank < n; rank++) {
+        miPickIndexSpan(index, index->children[rank], &cx1, &cy1, &cx2, &cy2);
+        if (miPickIndexIsBig(cx1, cy1, cx2, cy2))
+            continue;
+        for (cy = cy1; cy <= cy2; cy++)
+            for (cx = cx1; cx <= cx2; cx++)
+                index->cellRanks[index->cellStart[cy * grid.cols + cx]++] =
+                    rank;
+    }
+    memmove(index->cellStart + 1, index->cellStart, ncells * sizeof(int));
+    index->cellStart[0] = 0;
+
+    return index;
+}
+
+static WindowPtr
+miPickIndexLookup(WindowPickIndexPtr index, int x, int y)
+{
+    WindowPtr pWin;
+    int cx, cy, c, i, end, j, rank;
+
+    if (x < index->x || y < index->y)
+        return NULL;
+    cx = (x - index->x) / index->cellWidth;
+    cy = (y - index->y) / index->cellHeight;
+    if (cx >= index->cols || cy >= index->rows)
+        return NULL;
+
+    c = cy * index->cols + cx;
+    i = index->cellStart[c];
+    end = index->cellStart[c + 1];
+    j = 0;
+    while (i < end || j < index->nbig) {
+        if (j == index->nbig ||
+            (i < end && index->cellRanks[i] < index->big[j]))
+            rank = index->cellRanks[i++];
+        else
+            rank = index->big[j++];
+        pWin = index->children[rank];
+        if (miPointInWindow(pWin, x, y))
+            return pWin;
+    }
+    return NULL;
+}
+
+/*
+ * Find the frontmost child of pParent the pointer at x/y is in.
+ */
+static WindowPtr
+miPickChild(WindowPtr pParent, int x, int y)
+{
+    WindowPickIndexPtr index = NULL;
+    WindowPtr pWin;
+    int walked = 0;
+
+    if (pParent->optional)
+        index = pParent->optional->pickIndex;
+
+    if (index) {
+        if (index->serial == windowTreeSerial)
+            return miPickIndexLookup(index, x, y);
+        if (index->pending == windowTreeSerial) {
+            free(index);
+            index = pParent->optional->pickIndex = miPickIndexBuild(pParent);
+            if (index)
+                return miPickIndexLookup(index, x, y);
         }
         else
-            pWin = pWin->nextSib;
+            index->pending = windowTreeSerial;
+    }
+
+    for (pWin = pParent->firstChild; pWin; pWin = pWin->nextSib, walked++)
+        if (miPointInWindow(pWin, x, y))
+            break;
+
+    if (!index && walked >= PICK_INDEX_THRESHOLD &&
+        MakeWindowOptional(pParent))
+        pParent->optional->pickIndex = miPickIndexBuild(pParent);
+
+    return pWin;
+}
+
+WindowPtr
+miSpriteTrace(SpritePtr pSprite, int x, int y)
+{
+    WindowPtr pWin;
+
+    pWin = DeepestSpriteWin(pSprite);
+    while ((pWin = miPickChild(pWin, x, y))) {
+        if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
+            pSprite->spriteTraceSize += 10;
+            pSprite->spriteTrace = realloc(pSprite->spriteTrace,
+                                           pSprite->spriteTraceSize *
+                                           sizeof(WindowPtr));
+        }
+        pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
     }
     return DeepestSpriteWin(pSprite);
 }
@@ -25,6 +25,7 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 
 #include    <X11/X.h>
 #include    "scrnintstr.h"
@@ -119,6 +120,91 @@ getDrawableDamageRef(DrawablePtr pDrawable)
     DamagePtr	*pPrev = (DamagePtr *) \
 	dixLookupPrivateAddr(&(pWindow)->devPrivates, damageWinPrivateKey)
 
+/*
+ * Batched damage: rather than a RegionUnion into pDamage->damage for
+ * every drawing op, the boxes are appended to a flat buffer and merged
+ * in one pass when the region is looked at or the buffer fills up.
+ * Once merged, a region with more than batchLimit boxes is reduced to
+ * its bounding box, so neither the buffer nor the region can grow
+ * without bound under a stream of tiny ops.
+ */
+static void
+damageBatchFlush(DamagePtr pDamage)
+{
+    RegionRec batch;
+
+    if (pDamage->batchCount) {
+        if (!RegionInitBoxes(&batch, pDamage->batchBoxes,
+                             pDamage->batchCount)) {
+            RegionUninit(&batch);
+            RegionInit(&batch, &pDamage->batchExtents, 1);
+        }
+        RegionUnion(&pDamage->damage, &pDamage->damage, &batch);
+        RegionUninit(&batch);
+        pDamage->batchCount = 0;
+    }
+
+    if (pDamage->batchLimit &&
+        RegionNumRects(&pDamage->damage) > pDamage->batchLimit) {
+        BoxRec extents = *RegionExtents(&pDamage->damage);
+
+        RegionReset(&pDamage->damage, &extents);
+    }
+}
+
+static void
+damageAccumulate(DamagePtr pDamage, RegionPtr pRegion)
+{
+    int n = RegionNumRects(pRegion);
+    BoxPtr pExtents;
+
+    if (!pDamage->batchLimit) {
+        RegionUnion(&pDamage->damage, &pDamage->damage, pRegion);
+        return;
+    }
+
+    if (!n)
+        return;
+
+    if (pDamage->batchCount + n > pDamage->batchLimit) {
+        damageBatchFlush(pDamage);
+        if (n > pDamage->batchLimit) {
+            RegionUnion(&pDamage->damage, &pDamage->damage, pRegion);
+            damageBatchFlush(pDamage);
+            return;
+        }
+    }
+
+    if (pDamage->batchCount + n > pDamage->batchSize) {
+        int size = max(pDamage->batchSize * 2, pDamage->batchCount + n);
+        BoxPtr boxes;
+
+        size = min(max(size, 16), pDamage->batchLimit);
+        boxes = realloc(pDamage->batchBoxes, size * sizeof(BoxRec));
+        if (!boxes) {
+            damageBatchFlush(pDamage);
+            RegionUnion(&pDamage->damage, &pDamage->damage, pRegion);
+            return;
+        }
+        pDamage->batchBoxes = boxes;
+        pDamage->batchSize = size;
+    }
+
+    memcpy(pDamage->batchBoxes + pDamage->batchCount, RegionRects(pRegion),
+           n * sizeof(BoxRec));
+
+    pExtents = RegionExtents(pRegion);
+    if (!pDamage->batchCount)
+        pDamage->batchExtents = *pExtents;
+    else {
+        pDamage->batchExtents.x1 = min(pDamage->batchExtents.x1, pExtents->x1);
+        pDamage->batchExtents.y1 = min(pDamage->batchExtents.y1, pExtents->y1);
+        pDamage->batchExtents.x2 = max(pDamage->batchExtents.x2, pExtents->x2);
+        pDamage->batchExtents.y2 = max(pDamage->batchExtents.y2, pExtents->y2);
+    }
+    pDamage->batchCount += n;
+}
+
 #if DAMAGE_DEBUG_ENABLE
 static void
 _damageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion, Bool clip,
@@ -263,7 +349,7 @@ damageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion, Bool clip,
             if (pDamage->damageReport)
                 DamageReportDamage(pDamage, pDamageRegion);
             else
-                RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+                damageAccumulate(pDamage, pDamageRegion);
         }
 
         /*
@@ -291,8 +377,7 @@ damageRegionProcessPending(DrawablePtr pDrawable)
             if (pDamage->damageReport)
                 DamageReportDamage(pDamage, &pDamage->pendingDamage);
             else
-                RegionUnion(&pDamage->damage, &pDamage->damage,
-                            &pDamage->pendingDamage);
+                damageAccumulate(pDamage, &pDamage->pendingDamage);
         }
 
         if (pDamage->reportAfter)
@@ -1699,6 +1784,10 @@ DamageCreate(DamageReportFunc damageReport,
     pDamage->isWindow = FALSE;
     pDamage->pDrawable = 0;
     pDamage->reportAfter = FALSE;
+    pDamage->batchLimit = 0;
+    pDamage->batchCount = 0;
+    pDamage->batchSize = 0;
+    pDamage->batchBoxes = NULL;
 
     pDamage->damageReport = damageReport;
     pDamage->damageDestroy = damageDestroy;
@@ -1810,6 +1899,7 @@ DamageDestroy(DamagePtr pDamage)
     (*pScrPriv->funcs.Destroy) (pDamage);
     RegionUninit(&pDamage->damage);
     RegionUninit(&pDamage->pendingDamage);
+    free(pDamage->batchBoxes);
     dixFreeObjectWithPrivates(pDamage, PRIVATE_DAMAGE);
 }
 
@@ -1820,6 +1910,7 @@ DamageSubtract(DamagePtr pDamage, const RegionPtr pRegion)
     RegionRec pixmapClip;
     DrawablePtr pDrawable = pDamage->pDrawable;
 
+    damageBatchFlush(pDamage);
     RegionSubtract(&pDamage->damage, &pDamage->damage, pRegion);
     if (pDrawable) {
         if (pDrawable->type == DRAWABLE_WINDOW)
@@ -1847,11 +1938,13 @@ void
 DamageEmpty(DamagePtr pDamage)
 {
     RegionEmpty(&pDamage->damage);
+    pDamage->batchCount = 0;
 }
 
 RegionPtr
 DamageRegion(DamagePtr pDamage)
 {
+    damageBatchFlush(pDamage);
     return &pDamage->damage;
 }
 
@@ -1892,6 +1985,28 @@ DamageSetReportAfterOp(DamagePtr pDamage, Bool reportAfter)
     pDamage->reportAfter = reportAfter;
 }
 
+/**
+ * Accumulate damage in a box buffer that is only merged into the damage
+ * region when it is looked at, keeping at most @maxBoxes boxes in either;
+ * past that the region collapses to its bounding box.  This suits
+ * consumers that repaint the damaged area once per frame and can afford
+ * to repaint a little more than was drawn.  A @maxBoxes of 0 turns
+ * batching off again.  Reports still happen per op, but DeltaRegion and
+ * BoundingBox damage merge the batch before every report.
+ */
+void
+DamageSetBatching(DamagePtr pDamage, int maxBoxes)
+{
+    damageBatchFlush(pDamage);
+    if (maxBoxes <= 0) {
+        free(pDamage->batchBoxes);
+        pDamage->batchBoxes = NULL;
+        pDamage->batchSize = 0;
+        maxBoxes = 0;
+    }
+    pDamage->batchLimit = maxBoxes;
+}
+
 DamageScreenFuncsPtr
 DamageGetScreenFuncs(ScreenPtr pScreen)
 {
@@ -1908,10 +2023,11 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
 
     switch (pDamage->damageLevel) {
     case DamageReportRawRegion:
-        RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        damageAccumulate(pDamage, pDamageRegion);
         (*pDamage->damageReport) (pDamage, pDamageRegion, pDamage->closure);
         break;
     case DamageReportDeltaRegion:
+        damageBatchFlush(pDamage);
         RegionNull(&tmpRegion);
         RegionSubtract(&tmpRegion, pDamageRegion, &pDamage->damage);
         if (RegionNotEmpty(&tmpRegion)) {
@@ -1921,6 +2037,7 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
         RegionUninit(&tmpRegion);
         break;
     case DamageReportBoundingBox:
+        damageBatchFlush(pDamage);
         tmpBox = *RegionExtents(&pDamage->damage);
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
         if (!BOX_SAME(&tmpBox, RegionExtents(&pDamage->damage))) {
@@ -1929,15 +2046,17 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
         }
         break;
     case DamageReportNonEmpty:
-        was_empty = !RegionNotEmpty(&pDamage->damage);
-        RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        was_empty = !RegionNotEmpty(&pDamage->damage) && !pDamage->batchCount;
+        damageAccumulate(pDamage, pDamageRegion);
+        if (was_empty)
+            damageBatchFlush(pDamage);
         if (was_empty && RegionNotEmpty(&pDamage->damage)) {
             (*pDamage->damageReport) (pDamage, &pDamage->damage,
                                       pDamage->closure);
         }
         break;
     case DamageReportNone:
-        RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        damageAccumulate(pDamage, pDamageRegion);
         break;
     }
 }
@@ -110,6 +110,12 @@ extern _X_EXPORT void
 extern _X_EXPORT void
  DamageSetReportAfterOp(DamagePtr pDamage, Bool reportAfter);
 
+/* Box count a batched damage normalizes at, and the most it keeps. */
+#define DAMAGE_BATCH_LIMIT 256
+
+extern _X_EXPORT void
+ DamageSetBatching(DamagePtr pDamage, int maxBoxes);
+
 extern _X_EXPORT DamageScreenFuncsPtr DamageGetScreenFuncs(ScreenPtr);
 
 #endif                          /* _DAMAGE_H_ */
@@ -50,6 +50,13 @@ typedef struct _damage {
     RegionRec pendingDamage;    /* will be flushed post submission at the latest */
     ScreenPtr pScreen;
     PrivateRec *devPrivates;
+
+    /* boxes not yet merged into damage, see DamageSetBatching */
+    int batchLimit;
+    int batchCount;
+    int batchSize;
+    BoxPtr batchBoxes;
+    BoxRec batchExtents;
 } DamageRec;
 
 typedef struct _damageScrPriv {
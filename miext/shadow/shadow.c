@@ -36,6 +36,11 @@
 #include    "gcstruct.h"
 #include    "shadow.h"
 
+#ifdef SHADOW_THREADS
+#include <pthread.h>
+#include <signal.h>
+#endif
+
 static DevPrivateKeyRec shadowScrPrivateKeyRec;
 
 #define shadowScrPrivateKey (&shadowScrPrivateKeyRec)
@@ -49,6 +54,221 @@ static DevPrivateKeyRec shadowScrPrivateKeyRec;
     real->mem = priv->mem; \
 }
 
+#ifdef SHADOW_THREADS
+
+/*
+ * Bands shorter than SHADOW_BAND_MIN_ROWS are not worth waking a worker
+ * for.  Band edges fall SHADOW_BAND_ALIGN shadow rows apart, lined up
+ * with the destination words the edge rows land in, so the update procs,
+ * which widen boxes to whole FbBits, never write the same destination
+ * word from two bands.  See shadowBandPhase.
+ */
+#define SHADOW_BAND_MIN_ROWS	64
+#define SHADOW_BAND_ALIGN	32
+#define SHADOW_MAX_THREADS	16
+
+typedef struct _shadowBand {
+    shadowBufRec buf;           /* the screen's, with pDamage narrowed */
+    DamageRec damage;
+} shadowBandRec, *shadowBandPtr;
+
+typedef struct _shadowThreads {
+    ScreenPtr pScreen;
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;
+    Bool exiting;
+    int nbands;
+    int next;
+    int pending;
+    int nworkers;
+    pthread_t workers[SHADOW_MAX_THREADS - 1];
+    shadowBandRec bands[SHADOW_MAX_THREADS];
+} shadowThreadsRec, *shadowThreadsPtr;
+
+static void
+shadowRunBands(shadowThreadsPtr pool)
+{
+    shadowBandPtr band;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->next < pool->nbands) {
+        band = &pool->bands[pool->next++];
+        pthread_mutex_unlock(&pool->mutex);
+        (*band->buf.update) (pool->pScreen, &band->buf);
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void *
+shadowWorker(void *arg)
+{
+    shadowThreadsPtr pool = arg;
+    unsigned long generation = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->exiting && pool->generation == generation)
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        if (pool->exiting)
+            break;
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+        shadowRunBands(pool);
+        pthread_mutex_lock(&pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+static void
+shadowFreeThreads(shadowThreadsPtr pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->exiting = TRUE;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->nworkers; i++)
+        pthread_join(pool->workers[i], NULL);
+    for (i = 0; i < SHADOW_MAX_THREADS; i++)
+        RegionUninit(&pool->bands[i].damage.damage);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+static shadowThreadsPtr
+shadowCreateThreads(ScreenPtr pScreen, int nthreads)
+{
+    shadowThreadsPtr pool;
+    sigset_t all, old;
+    int i;
+
+    pool = calloc(1, sizeof(shadowThreadsRec));
+    if (!pool)
+        return NULL;
+    pool->pScreen = pScreen;
+    for (i = 0; i < SHADOW_MAX_THREADS; i++)
+        RegionNull(&pool->bands[i].damage.damage);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    /* Workers inherit our mask; signals stay on the main thread. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (i = 0; i < nthreads - 1; i++) {
+        if (pthread_create(&pool->workers[i], NULL, shadowWorker, pool) != 0)
+            break;
+        pool->nworkers++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (!pool->nworkers) {
+        shadowFreeThreads(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+/*
+ * Shadow row y lands in destination column y when the screen is turned a
+ * quarter, or in column height - y when the rotation also runs the shadow
+ * rows right to left.  Destination words start on column multiples of
+ * SHADOW_BAND_ALIGN, so band edges have to sit at the matching phase.
+ * Other rotations keep shadow rows in separate destination rows.
+ */
+static int
+shadowBandPhase(shadowBufPtr pBuf)
+{
+    int height = pBuf->pPixmap->drawable.height;
+    Bool reflect = (pBuf->randr & SHADOW_REFLECT_Y) != 0;
+
+    switch (pBuf->randr & SHADOW_ROTATE_ALL) {
+    case SHADOW_ROTATE_90:
+        return reflect ? height % SHADOW_BAND_ALIGN : 0;
+    case SHADOW_ROTATE_270:
+        return reflect ? 0 : height % SHADOW_BAND_ALIGN;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Cut the damage into horizontal bands and update them in parallel,
+ * this thread taking its share.  Returns once every band is on the
+ * screen, or FALSE without touching anything when the damage is too
+ * small to split.
+ */
+static Bool
+shadowRedisplayBands(ScreenPtr pScreen, shadowBufPtr pBuf, RegionPtr pRegion)
+{
+    shadowThreadsPtr pool = pBuf->threads;
+    BoxPtr extents = RegionExtents(pRegion);
+    int phase = shadowBandPhase(pBuf);
+    int top = ((extents->y1 - phase) & ~(SHADOW_BAND_ALIGN - 1)) + phase;
+    int nbands, rows, y;
+    int n = 0;
+
+    if (!pool)
+        return FALSE;
+    nbands = min(pool->nworkers + 1,
+                 (extents->y2 - extents->y1) / SHADOW_BAND_MIN_ROWS);
+    if (nbands < 2)
+        return FALSE;
+    rows = (extents->y2 - top + nbands - 1) / nbands;
+    rows = (rows + SHADOW_BAND_ALIGN - 1) & ~(SHADOW_BAND_ALIGN - 1);
+
+    for (y = top; y < extents->y2; y += rows) {
+        shadowBandPtr band = &pool->bands[n];
+        BoxRec box;
+        RegionRec clip;
+
+        box.x1 = extents->x1;
+        box.x2 = extents->x2;
+        box.y1 = max(y, extents->y1);
+        box.y2 = min(y + rows, extents->y2);
+        RegionInit(&clip, &box, 1);
+        if (!RegionIntersect(&band->damage.damage, pRegion, &clip))
+            return FALSE;
+        if (!RegionNotEmpty(&band->damage.damage))
+            continue;
+
+        band->buf = *pBuf;
+        band->buf.pDamage = &band->damage;
+        band->buf.damage = band->damage.damage;     /* bc */
+        n++;
+    }
+    if (n < 2)
+        return FALSE;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->nbands = n;
+    pool->next = 0;
+    pool->pending = n;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    shadowRunBands(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending)
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+    return TRUE;
+}
+
+#endif /* SHADOW_THREADS */
+
 static void
 shadowRedisplay(ScreenPtr pScreen)
 {
@@ -59,7 +279,10 @@ shadowRedisplay(ScreenPtr pScreen)
         return;
     pRegion = DamageRegion(pBuf->pDamage);
     if (RegionNotEmpty(pRegion)) {
-        (*pBuf->update) (pScreen, pBuf);
+#ifdef SHADOW_THREADS
+        if (!shadowRedisplayBands(pScreen, pBuf, pRegion))
+#endif
+            (*pBuf->update) (pScreen, pBuf);
         DamageEmpty(pBuf->pDamage);
     }
 }
@@ -103,6 +326,7 @@ shadowCloseScreen(ScreenPtr pScreen)
     unwrap(pBuf, pScreen, GetImage);
     unwrap(pBuf, pScreen, CloseScreen);
     shadowRemove(pScreen, pBuf->pPixmap);
+    shadowSetUpdateThreads(pScreen, 0);
     DamageDestroy(pBuf->pDamage);
 #ifdef BACKWARDS_COMPATIBILITY
     RegionUninit(&pBuf->damage);        /* bc */
@@ -160,6 +384,7 @@ shadowSetup(ScreenPtr pScreen)
         free(pBuf);
         return FALSE;
     }
+    DamageSetBatching(pBuf->pDamage, DAMAGE_BATCH_LIMIT);
 
     wrap(pBuf, pScreen, CloseScreen);
     wrap(pBuf, pScreen, GetImage);
@@ -168,6 +393,7 @@ shadowSetup(ScreenPtr pScreen)
     pBuf->pPixmap = 0;
     pBuf->closure = 0;
     pBuf->randr = 0;
+    pBuf->threads = NULL;
 #ifdef BACKWARDS_COMPATIBILITY
     RegionNull(&pBuf->damage);  /* bc */
 #endif
@@ -231,6 +457,33 @@ shadowRemove(ScreenPtr pScreen, PixmapPtr pPixmap)
                                  (void *) pScreen);
 }
 
+Bool
+shadowSetUpdateThreads(ScreenPtr pScreen, int nthreads)
+{
+    shadowBufPtr pBuf;
+
+    if (!dixPrivateKeyRegistered(shadowScrPrivateKey))
+        return FALSE;
+    pBuf = shadowGetBuf(pScreen);
+    if (!pBuf)
+        return FALSE;
+#ifdef SHADOW_THREADS
+    if (pBuf->threads) {
+        shadowFreeThreads(pBuf->threads);
+        pBuf->threads = NULL;
+    }
+    if (nthreads > 1) {
+        pBuf->threads = shadowCreateThreads(pScreen,
+                                            min(nthreads, SHADOW_MAX_THREADS));
+        if (!pBuf->threads)
+            return FALSE;
+    }
+    return TRUE;
+#else
+    return nthreads <= 1;
+#endif
+}
+
 Bool
 shadowInit(ScreenPtr pScreen, ShadowUpdateProc update, ShadowWindowProc window)
 {
@@ -56,6 +56,9 @@ typedef struct _shadowBuf {
     /* screen wrappers */
     GetImageProcPtr GetImage;
     CloseScreenProcPtr CloseScreen;
+
+    /* update workers, see shadowSetUpdateThreads */
+    struct _shadowThreads *threads;
 } shadowBufRec;
 
 /* Match defines from randr extension */
@@ -95,6 +98,16 @@ shadowInit(ScreenPtr pScreen, ShadowUpdateProc update, ShadowWindowProc window);
 
 extern _X_EXPORT void *shadowAlloc(int width, int height, int bpp);
 
+/*
+ * Split large updates into horizontal bands and run the update proc on
+ * up to nthreads of them at once, the server thread included.  The
+ * update and window procs must then be safe to call concurrently on
+ * disjoint parts of the screen; banked window procs are not.  A count
+ * of 0 or 1 goes back to updating on the server thread alone.
+ */
+extern _X_EXPORT Bool
+ shadowSetUpdateThreads(ScreenPtr pScreen, int nthreads);
+
 extern _X_EXPORT void
  shadowUpdateAfb4(ScreenPtr pScreen, shadowBufPtr pBuf);
 
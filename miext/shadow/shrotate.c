@@ -37,6 +37,7 @@
 #include    "gcstruct.h"
 #include    "shadow.h"
 #include    "fb.h"
+#include    "shrotblock.h"
 
 /*
  * These indicate which way the source (shadow) is scanned when
@@ -83,6 +84,19 @@ shadowUpdateRotatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
     pixelsPerBits = (sizeof(FbBits) * 8) / shaBpp;
     pixelsMask = ~(pixelsPerBits - 1);
     shaMask = FbBitsMask(FB_UNIT - shaBpp, shaBpp);
+
+    /* plain quarter turns of 16 and 32bpp shadows are done a tile at a time */
+    if (!(pBuf->randr & (SHADOW_REFLECT_X | SHADOW_REFLECT_Y))) {
+        int rotate = 0;
+
+        if ((pBuf->randr & SHADOW_ROTATE_ALL) == SHADOW_ROTATE_90)
+            rotate = 90;
+        else if ((pBuf->randr & SHADOW_ROTATE_ALL) == SHADOW_ROTATE_270)
+            rotate = 270;
+        if (rotate && shadowRotateBlocked(pScreen, pBuf, rotate, pixelsPerBits))
+            return;
+    }
+
     /*
      * Compute rotation related constants to walk the shadow
      */
@@ -0,0 +1,485 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <string.h>
+
+#include    <X11/X.h>
+#include    "scrnintstr.h"
+#include    "windowstr.h"
+#include    "regionstr.h"
+#include    "shadow.h"
+#include    "fb.h"
+#include    "shrotblock.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define USE_SSE2
+#include <emmintrin.h>
+#ifdef __SSE2__
+#define SSE2_TARGET
+#else
+#define SSE2_TARGET __attribute__((target("sse2")))
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define USE_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * Tiles are TILE_W screen pixels wide, so each write through the window
+ * is a 256 byte run for 32bpp, and one cache line of shadow scanline
+ * tall.
+ */
+#define TILE_W      64
+#define TILE_BYTES  64
+#define TILE_H(bpp) (TILE_BYTES / ((bpp) >> 3))
+
+/*
+ * A kernel fills a tw x th tile so that tile[r * tw + c] is
+ * src[r * dr + c * dc]: dr is +1 or -1, walking along a shadow scanline,
+ * and dc is plus or minus the shadow stride.
+ */
+typedef void (*RotateTile16Proc) (CARD16 *tile, const CARD16 *src,
+                                  FbStride dr, FbStride dc, int tw, int th);
+typedef void (*RotateTile32Proc) (CARD32 *tile, const CARD32 *src,
+                                  FbStride dr, FbStride dc, int tw, int th);
+
+typedef struct {
+    RotateTile16Proc tile16;
+    RotateTile32Proc tile32;
+} RotateKernelRec;
+
+static void
+rotateTile16Scalar(CARD16 *tile, const CARD16 *src,
+                   FbStride dr, FbStride dc, int tw, int th)
+{
+    int r, c;
+
+    for (r = 0; r < th; r++)
+        for (c = 0; c < tw; c++)
+            tile[r * tw + c] = src[r * dr + c * dc];
+}
+
+static void
+rotateTile32Scalar(CARD32 *tile, const CARD32 *src,
+                   FbStride dr, FbStride dc, int tw, int th)
+{
+    int r, c;
+
+    for (r = 0; r < th; r++)
+        for (c = 0; c < tw; c++)
+            tile[r * tw + c] = src[r * dr + c * dc];
+}
+
+/*
+ * The SIMD kernels transpose square blocks: block row j is loaded from
+ * the shadow scanline for tile column c + j, so lane k of transposed
+ * row k holds tile row r + k, or r + n - 1 - k when walking the scanline
+ * backwards.  Whatever is left over at the right and bottom edges of the
+ * tile is done one pixel at a time.
+ */
+#define ROTATE_EDGES(tile, src, dr, dc, tw, th, n) {                    \
+    int _r, _c;                                                         \
+    for (_r = 0; _r < (th); _r++)                                       \
+        for (_c = (_r < ((th) & ~((n) - 1)) ? ((tw) & ~((n) - 1)) : 0); \
+             _c < (tw); _c++)                                           \
+            (tile)[_r * (tw) + _c] = (src)[_r * (dr) + _c * (dc)];      \
+}
+
+#ifdef USE_SSE2
+static SSE2_TARGET void
+rotateTile16SSE2(CARD16 *tile, const CARD16 *src,
+                 FbStride dr, FbStride dc, int tw, int th)
+{
+    int r, c, k;
+
+    for (r = 0; r + 8 <= th; r += 8) {
+        for (c = 0; c + 8 <= tw; c += 8) {
+            const CARD16 *p = src + r * dr + c * dc - (dr < 0 ? 7 : 0);
+            __m128i a, b, d, e, f, g, h, i;
+            __m128i ab0, ab1, cd0, cd1, ef0, ef1, gh0, gh1;
+            __m128i abcd0, abcd1, abcd2, abcd3, efgh0, efgh1, efgh2, efgh3;
+            __m128i o[8];
+
+            a = _mm_loadu_si128((const __m128i *) (p + 0 * dc));
+            b = _mm_loadu_si128((const __m128i *) (p + 1 * dc));
+            d = _mm_loadu_si128((const __m128i *) (p + 2 * dc));
+            e = _mm_loadu_si128((const __m128i *) (p + 3 * dc));
+            f = _mm_loadu_si128((const __m128i *) (p + 4 * dc));
+            g = _mm_loadu_si128((const __m128i *) (p + 5 * dc));
+            h = _mm_loadu_si128((const __m128i *) (p + 6 * dc));
+            i = _mm_loadu_si128((const __m128i *) (p + 7 * dc));
+
+            ab0 = _mm_unpacklo_epi16(a, b);
+            ab1 = _mm_unpackhi_epi16(a, b);
+            cd0 = _mm_unpacklo_epi16(d, e);
+            cd1 = _mm_unpackhi_epi16(d, e);
+            ef0 = _mm_unpacklo_epi16(f, g);
+            ef1 = _mm_unpackhi_epi16(f, g);
+            gh0 = _mm_unpacklo_epi16(h, i);
+            gh1 = _mm_unpackhi_epi16(h, i);
+
+            abcd0 = _mm_unpacklo_epi32(ab0, cd0);
+            abcd1 = _mm_unpackhi_epi32(ab0, cd0);
+            abcd2 = _mm_unpacklo_epi32(ab1, cd1);
+            abcd3 = _mm_unpackhi_epi32(ab1, cd1);
+            efgh0 = _mm_unpacklo_epi32(ef0, gh0);
+            efgh1 = _mm_unpackhi_epi32(ef0, gh0);
+            efgh2 = _mm_unpacklo_epi32(ef1, gh1);
+            efgh3 = _mm_unpackhi_epi32(ef1, gh1);
+
+            o[0] = _mm_unpacklo_epi64(abcd0, efgh0);
+            o[1] = _mm_unpackhi_epi64(abcd0, efgh0);
+            o[2] = _mm_unpacklo_epi64(abcd1, efgh1);
+            o[3] = _mm_unpackhi_epi64(abcd1, efgh1);
+            o[4] = _mm_unpacklo_epi64(abcd2, efgh2);
+            o[5] = _mm_unpackhi_epi64(abcd2, efgh2);
+            o[6] = _mm_unpacklo_epi64(abcd3, efgh3);
+            o[7] = _mm_unpackhi_epi64(abcd3, efgh3);
+
+            for (k = 0; k < 8; k++)
+                _mm_storeu_si128((__m128i *)
+                                 (tile + (r + (dr < 0 ? 7 - k : k)) * tw + c),
+                                 o[k]);
+        }
+    }
+    ROTATE_EDGES(tile, src, dr, dc, tw, th, 8);
+}
+
+static SSE2_TARGET void
+rotateTile32SSE2(CARD32 *tile, const CARD32 *src,
+                 FbStride dr, FbStride dc, int tw, int th)
+{
+    int r, c, k;
+
+    for (r = 0; r + 4 <= th; r += 4) {
+        for (c = 0; c + 4 <= tw; c += 4) {
+            const CARD32 *p = src + r * dr + c * dc - (dr < 0 ? 3 : 0);
+            __m128i a, b, d, e, ab0, ab1, de0, de1;
+            __m128i o[4];
+
+            a = _mm_loadu_si128((const __m128i *) (p + 0 * dc));
+            b = _mm_loadu_si128((const __m128i *) (p + 1 * dc));
+            d = _mm_loadu_si128((const __m128i *) (p + 2 * dc));
+            e = _mm_loadu_si128((const __m128i *) (p + 3 * dc));
+
+            ab0 = _mm_unpacklo_epi32(a, b);
+            ab1 = _mm_unpackhi_epi32(a, b);
+            de0 = _mm_unpacklo_epi32(d, e);
+            de1 = _mm_unpackhi_epi32(d, e);
+
+            o[0] = _mm_unpacklo_epi64(ab0, de0);
+            o[1] = _mm_unpackhi_epi64(ab0, de0);
+            o[2] = _mm_unpacklo_epi64(ab1, de1);
+            o[3] = _mm_unpackhi_epi64(ab1, de1);
+
+            for (k = 0; k < 4; k++)
+                _mm_storeu_si128((__m128i *)
+                                 (tile + (r + (dr < 0 ? 3 - k : k)) * tw + c),
+                                 o[k]);
+        }
+    }
+    ROTATE_EDGES(tile, src, dr, dc, tw, th, 4);
+}
+
+static Bool
+haveSSE2(void)
+{
+#ifdef __SSE2__
+    return TRUE;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+#endif
+
+#ifdef USE_NEON
+static void
+rotateTile16NEON(CARD16 *tile, const CARD16 *src,
+                 FbStride dr, FbStride dc, int tw, int th)
+{
+    int r, c, k;
+
+    for (r = 0; r + 8 <= th; r += 8) {
+        for (c = 0; c + 8 <= tw; c += 8) {
+            const CARD16 *p = src + r * dr + c * dc - (dr < 0 ? 7 : 0);
+            uint16x8x2_t ab, cd, ef, gh;
+            uint32x4x2_t abcd0, abcd1, efgh0, efgh1;
+            uint16x8_t o[8];
+
+            ab = vtrnq_u16(vld1q_u16(p + 0 * dc), vld1q_u16(p + 1 * dc));
+            cd = vtrnq_u16(vld1q_u16(p + 2 * dc), vld1q_u16(p + 3 * dc));
+            ef = vtrnq_u16(vld1q_u16(p + 4 * dc), vld1q_u16(p + 5 * dc));
+            gh = vtrnq_u16(vld1q_u16(p + 6 * dc), vld1q_u16(p + 7 * dc));
+
+            /* lanes 0,4 and 2,6 in abcd0/efgh0, 1,5 and 3,7 in abcd1/efgh1 */
+            abcd0 = vtrnq_u32(vreinterpretq_u32_u16(ab.val[0]),
+                              vreinterpretq_u32_u16(cd.val[0]));
+            abcd1 = vtrnq_u32(vreinterpretq_u32_u16(ab.val[1]),
+                              vreinterpretq_u32_u16(cd.val[1]));
+            efgh0 = vtrnq_u32(vreinterpretq_u32_u16(ef.val[0]),
+                              vreinterpretq_u32_u16(gh.val[0]));
+            efgh1 = vtrnq_u32(vreinterpretq_u32_u16(ef.val[1]),
+                              vreinterpretq_u32_u16(gh.val[1]));
+
+#define COMBINE(half, x, y) \
+    vreinterpretq_u16_u32(vcombine_u32(vget_##half##_u32(x), \
+                                       vget_##half##_u32(y)))
+            o[0] = COMBINE(low, abcd0.val[0], efgh0.val[0]);
+            o[1] = COMBINE(low, abcd1.val[0], efgh1.val[0]);
+            o[2] = COMBINE(low, abcd0.val[1], efgh0.val[1]);
+            o[3] = COMBINE(low, abcd1.val[1], efgh1.val[1]);
+            o[4] = COMBINE(high, abcd0.val[0], efgh0.val[0]);
+            o[5] = COMBINE(high, abcd1.val[0], efgh1.val[0]);
+            o[6] = COMBINE(high, abcd0.val[1], efgh0.val[1]);
+            o[7] = COMBINE(high, abcd1.val[1], efgh1.val[1]);
+#undef COMBINE
+
+            for (k = 0; k < 8; k++)
+                vst1q_u16(tile + (r + (dr < 0 ? 7 - k : k)) * tw + c, o[k]);
+        }
+    }
+    ROTATE_EDGES(tile, src, dr, dc, tw, th, 8);
+}
+
+static void
+rotateTile32NEON(CARD32 *tile, const CARD32 *src,
+                 FbStride dr, FbStride dc, int tw, int th)
+{
+    int r, c, k;
+
+    for (r = 0; r + 4 <= th; r += 4) {
+        for (c = 0; c + 4 <= tw; c += 4) {
+            const CARD32 *p = src + r * dr + c * dc - (dr < 0 ? 3 : 0);
+            uint32x4x2_t ab, de;
+            uint32x4_t o[4];
+
+            ab = vtrnq_u32(vld1q_u32(p + 0 * dc), vld1q_u32(p + 1 * dc));
+            de = vtrnq_u32(vld1q_u32(p + 2 * dc), vld1q_u32(p + 3 * dc));
+
+            o[0] = vcombine_u32(vget_low_u32(ab.val[0]),
+                                vget_low_u32(de.val[0]));
+            o[1] = vcombine_u32(vget_low_u32(ab.val[1]),
+                                vget_low_u32(de.val[1]));
+            o[2] = vcombine_u32(vget_high_u32(ab.val[0]),
+                                vget_high_u32(de.val[0]));
+            o[3] = vcombine_u32(vget_high_u32(ab.val[1]),
+                                vget_high_u32(de.val[1]));
+
+            for (k = 0; k < 4; k++)
+                vst1q_u32(tile + (r + (dr < 0 ? 3 - k : k)) * tw + c, o[k]);
+        }
+    }
+    ROTATE_EDGES(tile, src, dr, dc, tw, th, 4);
+}
+#endif
+
+static const RotateKernelRec rotateKernels[] = {
+    [SHADOW_ROTATE_KERNEL_NONE] = {NULL, NULL},
+    [SHADOW_ROTATE_KERNEL_SCALAR] = {rotateTile16Scalar, rotateTile32Scalar},
+#ifdef USE_SSE2
+    [SHADOW_ROTATE_KERNEL_SSE2] = {rotateTile16SSE2, rotateTile32SSE2},
+#endif
+#ifdef USE_NEON
+    [SHADOW_ROTATE_KERNEL_NEON] = {rotateTile16NEON, rotateTile32NEON},
+#endif
+};
+
+static int rotateKernel = -1;
+
+static Bool
+rotateKernelAvailable(ShadowRotateKernel kernel)
+{
+    switch (kernel) {
+    case SHADOW_ROTATE_KERNEL_NONE:
+    case SHADOW_ROTATE_KERNEL_SCALAR:
+        return TRUE;
+#ifdef USE_SSE2
+    case SHADOW_ROTATE_KERNEL_SSE2:
+        return haveSSE2();
+#endif
+#ifdef USE_NEON
+    case SHADOW_ROTATE_KERNEL_NEON:
+        return TRUE;
+#endif
+    default:
+        return FALSE;
+    }
+}
+
+ShadowRotateKernel
+shadowRotateGetKernel(void)
+{
+    if (rotateKernel < 0) {
+        if (rotateKernelAvailable(SHADOW_ROTATE_KERNEL_NEON))
+            rotateKernel = SHADOW_ROTATE_KERNEL_NEON;
+        else if (rotateKernelAvailable(SHADOW_ROTATE_KERNEL_SSE2))
+            rotateKernel = SHADOW_ROTATE_KERNEL_SSE2;
+        else
+            rotateKernel = SHADOW_ROTATE_KERNEL_SCALAR;
+    }
+    return rotateKernel;
+}
+
+Bool
+shadowRotateSetKernel(ShadowRotateKernel kernel)
+{
+    if (!rotateKernelAvailable(kernel))
+        return FALSE;
+    rotateKernel = kernel;
+    return TRUE;
+}
+
+/*
+ * Copy one tile row to the screen, mapping as much of the scanline at a
+ * time as the window allows.
+ */
+static Bool
+shadowRotateWriteRow(ScreenPtr pScreen, shadowBufPtr pBuf, int row,
+                     CARD32 offset, CARD8 *bits, CARD32 len)
+{
+    CARD8 *win;
+    CARD32 winSize;
+
+    while (len) {
+        win = (CARD8 *) (*pBuf->window) (pScreen, row, offset,
+                                         SHADOW_WINDOW_WRITE,
+                                         &winSize, pBuf->closure);
+        if (!win || !winSize)
+            return FALSE;
+        if (winSize > len)
+            winSize = len;
+        memcpy(win, bits, winSize);
+        offset += winSize;
+        bits += winSize;
+        len -= winSize;
+    }
+    return TRUE;
+}
+
+Bool
+shadowRotateBlocked(ScreenPtr pScreen, shadowBufPtr pBuf, int rotate,
+                    int align)
+{
+    RegionPtr damage = shadowDamage(pBuf);
+    PixmapPtr pShadow = pBuf->pPixmap;
+    int nbox = RegionNumRects(damage);
+    BoxPtr pbox = RegionRects(damage);
+    const RotateKernelRec *kernel;
+    FbBits *shaBits;
+    FbStride shaStride;
+    int shaBpp;
+    _X_UNUSED int shaXoff, shaYoff;
+    int shaWidth = pShadow->drawable.width;
+    int shaHeight = pShadow->drawable.height;
+    int bytes, tileHeight;
+    int scr_x1, scr_x2, scr_y1, scr_y2;
+    int scr_x, scr_y, tw, th, r;
+    FbStride sha, dr, dc;
+    CARD32 tile[TILE_W * TILE_BYTES / sizeof(CARD32)];
+
+    if (rotate != 90 && rotate != 270)
+        return FALSE;
+    kernel = &rotateKernels[shadowRotateGetKernel()];
+    if (!kernel->tile32)
+        return FALSE;
+
+    fbGetDrawable(&pShadow->drawable, shaBits, shaStride, shaBpp, shaXoff,
+                  shaYoff);
+    if (shaBpp != 16 && shaBpp != 32)
+        return FALSE;
+    /* the screen is shaHeight wide; it must not need widening */
+    if (shaHeight % align)
+        return FALSE;
+
+    bytes = shaBpp >> 3;
+    tileHeight = TILE_H(shaBpp);
+    shaStride = shaStride * sizeof(FbBits) / bytes;
+
+    /*
+     * 90:  screen (x, y) is shadow (shaWidth - 1 - y, x)
+     * 270: screen (x, y) is shadow (y, shaHeight - 1 - x)
+     */
+    if (rotate == 90) {
+        dr = -1;
+        dc = shaStride;
+    }
+    else {
+        dr = 1;
+        dc = -shaStride;
+    }
+
+    while (nbox--) {
+        if (rotate == 90) {
+            scr_x1 = pbox->y1;
+            scr_x2 = pbox->y2;
+            scr_y1 = shaWidth - pbox->x2;
+            scr_y2 = shaWidth - pbox->x1;
+        }
+        else {
+            scr_x1 = shaHeight - pbox->y2;
+            scr_x2 = shaHeight - pbox->y1;
+            scr_y1 = pbox->x1;
+            scr_y2 = pbox->x2;
+        }
+        pbox++;
+
+        scr_x1 -= scr_x1 % align;
+        scr_x2 += (align - scr_x2 % align) % align;
+
+        for (scr_y = scr_y1; scr_y < scr_y2; scr_y += tileHeight) {
+            th = min(tileHeight, scr_y2 - scr_y);
+            for (scr_x = scr_x1; scr_x < scr_x2; scr_x += TILE_W) {
+                tw = min(TILE_W, scr_x2 - scr_x);
+                if (rotate == 90)
+                    sha = (FbStride) scr_x * shaStride +
+                        (shaWidth - 1 - scr_y);
+                else
+                    sha = (FbStride) (shaHeight - 1 - scr_x) * shaStride +
+                        scr_y;
+
+                if (bytes == 4)
+                    (*kernel->tile32) (tile, (CARD32 *) shaBits + sha,
+                                       dr, dc, tw, th);
+                else
+                    (*kernel->tile16) ((CARD16 *) tile,
+                                       (CARD16 *) shaBits + sha,
+                                       dr, dc, tw, th);
+
+                for (r = 0; r < th; r++)
+                    if (!shadowRotateWriteRow(pScreen, pBuf, scr_y + r,
+                                              scr_x * bytes,
+                                              (CARD8 *) tile + r * tw * bytes,
+                                              tw * bytes))
+                        return TRUE;
+            }
+        }
+    }
+    return TRUE;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _SHROTBLOCK_H_
+#define _SHROTBLOCK_H_
+
+#include "shadow.h"
+
+/*
+ * Cache-blocked rotation of 16 and 32bpp shadows by 90 and 270 degrees.
+ * The rotated image is built a tile at a time from short runs of
+ * shadow scanlines and written out through the shadow window a tile row
+ * at a time.  The transpose kernel is chosen at first use from what the
+ * CPU supports.
+ */
+
+typedef enum {
+    SHADOW_ROTATE_KERNEL_NONE,  /* leave it to the per-pixel loops */
+    SHADOW_ROTATE_KERNEL_SCALAR,
+    SHADOW_ROTATE_KERNEL_SSE2,
+    SHADOW_ROTATE_KERNEL_NEON,
+} ShadowRotateKernel;
+
+/*
+ * Update the damaged part of the screen for the given rotation.  @align
+ * is the pixel granularity of the screen writes; the damaged range of
+ * each screen scanline is widened to a multiple of it.  Returns FALSE,
+ * without touching the screen, when the shadow depth or rotation is not
+ * handled here.
+ */
+extern Bool
+shadowRotateBlocked(ScreenPtr pScreen, shadowBufPtr pBuf, int rotate,
+                    int align);
+
+extern ShadowRotateKernel
+shadowRotateGetKernel(void);
+
+/* Returns FALSE if @kernel is not available on this CPU. */
+extern Bool
+shadowRotateSetKernel(ShadowRotateKernel kernel);
+
+#endif                          /* _SHROTBLOCK_H_ */
@@ -44,6 +44,7 @@
 #include    "gcstruct.h"
 #include    "shadow.h"
 #include    "fb.h"
+#include    "shrotblock.h"
 
 #define DANDEBUG         0
 
@@ -111,6 +112,11 @@ FUNC(ScreenPtr pScreen, shadowBufPtr pBuf)
     Data *winBase = NULL, *win;
     CARD32 winSize;
 
+#if ROTATE == 90 || ROTATE == 270
+    if (sizeof(Data) > 1 && shadowRotateBlocked(pScreen, pBuf, ROTATE, 1))
+        return;
+#endif
+
     fbGetDrawable(&pShadow->drawable, shaBits, shaStride, shaBpp, shaXoff,
                   shaYoff);
     shaBase = (Data *) shaBits;
@@ -30,6 +30,7 @@
 #include    "gcstruct.h"
 #include    "shadow.h"
 #include    "fb.h"
+#include    "shrotblock.h"
 
 #if ROTATE == 270
 
@@ -69,6 +70,9 @@ FUNC(ScreenPtr pScreen, shadowBufPtr pBuf)
     Data *winBase, *win, *winLine;
     CARD32 winSize;
 
+    if (shadowRotateBlocked(pScreen, pBuf, ROTATE, 1))
+        return;
+
     fbGetDrawable(&pShadow->drawable, shaBits, shaStride, shaBpp, shaXoff,
                   shaYoff);
     shaBase = (Data *) shaBits;
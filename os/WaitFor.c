@@ -74,6 +74,10 @@ SOFTWARE.
 #endif
 #include "busfault.h"
 
+#ifdef HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+#endif
+
 #ifdef WIN32
 /* Error codes from windows sockets differ from fileio error codes  */
 #undef EINTR
@@ -125,6 +129,200 @@ static void DoTimer(OsTimerPtr timer, CARD32 now, OsTimerPtr *prev);
 static void CheckAllTimers(void);
 static OsTimerPtr timers = NULL;
 
+int PollBackend = POLL_BACKEND_SELECT;
+
+#ifdef HAVE_EPOLL_CREATE1
+/*
+ * epoll backend.
+ *
+ * The epoll set mirrors the select masks instead of replacing them: before
+ * each wait the read and write masks are diffed word by word against what
+ * is registered, and only the descriptors whose bits changed are passed to
+ * epoll_ctl.  Block handlers can therefore keep adding descriptors to the
+ * mask, and the ready descriptors are written back into the masks so that
+ * wakeup handlers see what select() would have reported.
+ *
+ * Readiness is level-triggered: ReadRequestFromClient does not drain the
+ * socket, so an edge-triggered set would lose wakeups.
+ */
+static int epollFd = -1;
+static fd_set epollRead;        /* registered for EPOLLIN */
+static fd_set epollWrite;       /* registered for EPOLLOUT */
+static struct epoll_event *epollEvents;
+static int epollMaxEvents;
+
+static Bool
+EpollInit(int nfds)
+{
+    epollEvents = calloc(nfds, sizeof(struct epoll_event));
+    if (!epollEvents)
+        return FALSE;
+    epollMaxEvents = nfds;
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        free(epollEvents);
+        epollEvents = NULL;
+        return FALSE;
+    }
+    FD_ZERO(&epollRead);
+    FD_ZERO(&epollWrite);
+    return TRUE;
+}
+
+static void
+EpollFini(void)
+{
+    close(epollFd);
+    epollFd = -1;
+    free(epollEvents);
+    epollEvents = NULL;
+    epollMaxEvents = 0;
+}
+
+static Bool
+EpollUpdate(int fd, Bool readable, Bool writable)
+{
+    struct epoll_event ev;
+    Bool registered = FD_ISSET(fd, &epollRead) || FD_ISSET(fd, &epollWrite);
+    int r;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (readable ? EPOLLIN : 0) | (writable ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+
+    if (!ev.events)
+        r = epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, &ev);
+    else {
+        r = epoll_ctl(epollFd, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                      fd, &ev);
+        /* The descriptor was closed and reused behind our back */
+        if (r < 0 && errno == ENOENT)
+            r = epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+        else if (r < 0 && errno == EEXIST)
+            r = epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+    FD_CLR(fd, &epollRead);
+    FD_CLR(fd, &epollWrite);
+    if (r < 0 && ev.events)
+        return FALSE;
+    if (readable)
+        FD_SET(fd, &epollRead);
+    if (writable)
+        FD_SET(fd, &epollWrite);
+    return TRUE;
+}
+
+/*
+ * Drop a descriptor from the epoll set.  Called whenever connection.c stops
+ * listening on a descriptor, so that a closed and reused fd number is
+ * registered afresh.
+ */
+void
+PollForgetFd(int fd)
+{
+    struct epoll_event ev;
+
+    if (epollFd < 0 || fd < 0 || fd >= epollMaxEvents)
+        return;
+    if (FD_ISSET(fd, &epollRead) || FD_ISSET(fd, &epollWrite)) {
+        memset(&ev, 0, sizeof(ev));
+        (void) epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, &ev);
+        FD_CLR(fd, &epollRead);
+        FD_CLR(fd, &epollWrite);
+    }
+}
+
+/*
+ * select()-compatible wait on the epoll set.  Returns the number of bits
+ * set in readfds/writefds, or -1 with errno set.  A descriptor epoll
+ * refuses for any reason but being closed, such as a regular file
+ * (EPERM), would fail again on every wait, so the server switches to
+ * select for good, which can wait on anything.
+ */
+static int
+EpollSelect(int nfds, fd_set *readfds, fd_set *writefds, struct timeval *wt)
+{
+    int i, n, ready, timeout;
+    int words = howmany(nfds, NFDBITS);
+
+    for (i = 0; i < words; i++) {
+        fd_mask want_r = readfds->fds_bits[i];
+        fd_mask want_w = writefds ? writefds->fds_bits[i] : 0;
+        fd_mask changed = (want_r ^ epollRead.fds_bits[i]) |
+            (want_w ^ epollWrite.fds_bits[i]);
+
+        while (changed) {
+            int bit = mffs(changed) - 1;
+            fd_mask m = ((fd_mask) 1) << bit;
+
+            if (!EpollUpdate(i * NFDBITS + bit,
+                             (want_r & m) != 0, (want_w & m) != 0)) {
+                if (errno == EBADF)
+                    return -1;
+                ErrorF("WaitForSomething(): epoll cannot watch fd %d: %s, "
+                       "using select\n", i * NFDBITS + bit, strerror(errno));
+                EpollFini();
+                PollBackend = POLL_BACKEND_SELECT;
+                return Select(nfds, readfds, writefds, NULL, wt);
+            }
+            changed &= ~m;
+        }
+    }
+
+    if (wt)
+        timeout = wt->tv_sec * MILLI_PER_SECOND +
+            (wt->tv_usec + 999) / (1000000 / MILLI_PER_SECOND);
+    else
+        timeout = -1;
+
+    n = epoll_wait(epollFd, epollEvents, epollMaxEvents, timeout);
+    if (n < 0)
+        return n;
+
+    FD_ZERO(readfds);
+    if (writefds)
+        FD_ZERO(writefds);
+    ready = 0;
+    for (i = 0; i < n; i++) {
+        int fd = epollEvents[i].data.fd;
+        uint32_t events = epollEvents[i].events;
+
+        if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+            FD_ISSET(fd, &epollRead)) {
+            FD_SET(fd, readfds);
+            ready++;
+        }
+        if (writefds && (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) &&
+            FD_ISSET(fd, &epollWrite)) {
+            FD_SET(fd, writefds);
+            ready++;
+        }
+    }
+    return ready;
+}
+#else
+void
+PollForgetFd(int fd)
+{
+}
+#endif
+
+static int
+WaitForFds(int nfds, fd_set *readfds, fd_set *writefds, struct timeval *wt)
+{
+#ifdef HAVE_EPOLL_CREATE1
+    if (PollBackend == POLL_BACKEND_EPOLL) {
+        if (epollFd >= 0 || EpollInit(nfds))
+            return EpollSelect(nfds, readfds, writefds, wt);
+        ErrorF("WaitForSomething(): epoll unavailable, using select\n");
+        PollBackend = POLL_BACKEND_SELECT;
+    }
+#endif
+    return Select(nfds, readfds, writefds, NULL, wt);
+}
+
 /*****************
  * WaitForSomething:
  *     Make the server suspend until there is
@@ -221,16 +419,16 @@ WaitForSomething(int *pClientsReady)
         else if (AnyClientsWriteBlocked) {
             XFD_COPYSET(&ClientsWriteBlocked, &clientsWritable);
 #ifndef _F_EXCLUDE_NON_MASK_SELECTED_FD_FROM_MAXCLIENTS_
-            i = Select(MaxClients, &LastSelectMask, &clientsWritable, NULL, wt);
+            i = WaitForFds(MaxClients, &LastSelectMask, &clientsWritable, wt);
 #else
-            i = Select(FD_SETSIZE, &LastSelectMask, &clientsWritable, NULL, wt);
+            i = WaitForFds(FD_SETSIZE, &LastSelectMask, &clientsWritable, wt);
 #endif
         }
         else {
 #ifndef _F_EXCLUDE_NON_MASK_SELECTED_FD_FROM_MAXCLIENTS_
-            i = Select(MaxClients, &LastSelectMask, NULL, NULL, wt);
+            i = WaitForFds(MaxClients, &LastSelectMask, NULL, wt);
 #else
-            i = Select(FD_SETSIZE, &LastSelectMask, NULL, NULL, wt);
+            i = WaitForFds(FD_SETSIZE, &LastSelectMask, NULL, wt);
 #endif
         }
         selecterr = GetErrno();
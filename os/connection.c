@@ -498,6 +498,7 @@ ResetWellKnownSockets(void)
                  */
 
                 FD_CLR(ListenTransFds[i], &WellKnownConnections);
+                PollForgetFd(ListenTransFds[i]);
                 ListenTransFds[i] = ListenTransFds[ListenTransCount - 1];
                 ListenTransConns[i] = ListenTransConns[ListenTransCount - 1];
                 ListenTransCount -= 1;
@@ -511,6 +512,7 @@ ResetWellKnownSockets(void)
                 int newfd = _XSERVTransGetConnectionNumber(ListenTransConns[i]);
 
                 FD_CLR(ListenTransFds[i], &WellKnownConnections);
+                PollForgetFd(ListenTransFds[i]);
                 ListenTransFds[i] = newfd;
                 FD_SET(newfd, &WellKnownConnections);
             }
@@ -532,8 +534,10 @@ CloseWellKnownConnections(void)
 {
     int i;
 
-    for (i = 0; i < ListenTransCount; i++)
+    for (i = 0; i < ListenTransCount; i++) {
+        PollForgetFd(ListenTransFds[i]);
         _XSERVTransClose(ListenTransConns[i]);
+    }
 }
 
 static void
@@ -779,6 +783,9 @@ AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
     oc->fd = fd;
     oc->input = (ConnectionInputPtr) NULL;
     oc->output = (ConnectionOutputPtr) NULL;
+    oc->inputHighWater = 0;
+    oc->inputPeak = 0;
+    oc->inputGrows = 0;
     oc->auth_id = None;
     oc->conn_time = conn_time;
     if (!(client = NextAvailableClient((void *) oc))) {
@@ -961,6 +968,7 @@ CloseDownFileDescriptor(OsCommPtr oc)
 {
     int connection = oc->fd;
 
+    PollForgetFd(connection);
     if (oc->trans_conn) {
         _XSERVTransDisconnect(oc->trans_conn);
         _XSERVTransClose(oc->trans_conn);
@@ -1065,6 +1073,7 @@ CloseDownConnection(ClientPtr client)
     XdmcpCloseDisplay(oc->fd);
 #endif
     CloseDownFileDescriptor(oc);
+    LogInputStats(client);
     FreeOsBuffers(oc);
     free(client->osPrivate);
     client->osPrivate = (void *) NULL;
@@ -1090,6 +1099,7 @@ AddEnabledDevice(int fd)
 void
 RemoveGeneralSocket(int fd)
 {
+    PollForgetFd(fd);
     FD_CLR(fd, &AllSockets);
     if (GrabInProgress)
         FD_CLR(fd, &SavedAllSockets);
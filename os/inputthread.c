@@ -0,0 +1,515 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * Input thread
+ *
+ * Devices registered here are read on a dedicated thread instead of from
+ * the SIGIO handler or the main loop.  The thread polls the device fds,
+ * calls the device's read procedure with the input lock held (which is
+ * where events are posted into mieq and the hardware cursor is moved),
+ * and then pokes an eventfd so that a main thread sleeping in
+ * WaitForSomething wakes up and processes the queued events.
+ *
+ * OsBlockSIGIO also takes the input lock, so every section of the server
+ * that used to hold off the SIGIO handler also holds off the input
+ * thread.  SIGIO handlers themselves never touch the lock: a mutex is not
+ * async-signal-safe, and the handler may interrupt the main thread while
+ * it holds the lock.  They stay lock-free as before, kept apart from the
+ * main thread by signal masking, and never race the input thread because
+ * no device is read from a handler while the thread runs.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <X11/Xos.h>
+#include <X11/Xpoll.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "misc.h"
+#include "os.h"
+#include "dix.h"
+#include "osdep.h"
+#include "globals.h"
+
+Bool InputThreadEnable = TRUE;
+
+#ifdef INPUTTHREAD
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+typedef struct _InputThreadDevice {
+    struct _InputThreadDevice *next;
+    InputThreadProcPtr readInputProc;
+    void *readInputArgs;
+    int fd;
+} InputThreadDeviceRec, *InputThreadDevicePtr;
+
+typedef struct {
+    pthread_t thread;
+    Bool running;
+    Bool exiting;
+    InputThreadDevicePtr devices;
+    Bool devicesChanged;        /* thread must rebuild its poll set */
+    int controlPipe[2];         /* main -> thread: list changed, exit */
+    int wakeFd[2];              /* thread -> main: events are queued */
+} InputThreadInfoRec;
+
+static InputThreadInfoRec inputThreadInfo = {
+    .controlPipe = {-1, -1},
+    .wakeFd = {-1, -1},
+};
+
+static pthread_mutex_t input_mutex;
+static Bool input_mutex_initialized;
+static pthread_t input_main_thread;
+
+/*
+ * The lock may be taken before InputThreadInit (OsBlockSIGIO during early
+ * startup), so it is created lazily.  InputThreadInit also creates it
+ * before starting the thread, so the lazy path only ever runs on the
+ * main thread.
+ */
+static void
+InputMutexInit(void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    if (pthread_mutex_init(&input_mutex, &attr) != 0)
+        FatalError("input thread: cannot create input lock\n");
+    pthread_mutexattr_destroy(&attr);
+    input_main_thread = pthread_self();
+    input_mutex_initialized = TRUE;
+}
+
+/* Signals are blocked on the input thread, so only the main thread can
+ * be inside a handler. */
+static Bool
+InputLockInSignal(void)
+{
+    return inSignalContext && input_mutex_initialized &&
+        pthread_equal(pthread_self(), input_main_thread);
+}
+
+void
+input_lock(void)
+{
+    if (!input_mutex_initialized)
+        InputMutexInit();
+    if (InputLockInSignal())
+        return;
+    pthread_mutex_lock(&input_mutex);
+}
+
+void
+input_unlock(void)
+{
+    if (InputLockInSignal())
+        return;
+    pthread_mutex_unlock(&input_mutex);
+}
+
+Bool
+InputThreadRunning(void)
+{
+    return inputThreadInfo.running;
+}
+
+static void
+InputThreadPoke(int fd)
+{
+    char c = 0;
+
+    while (write(fd, &c, 1) < 0 && errno == EINTR)
+        ;
+}
+
+static void
+InputThreadDrain(int fd)
+{
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+/* Wake the main thread.  Called from the input thread only. */
+static void
+InputThreadWakeMain(void)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t one = 1;
+
+    while (write(inputThreadInfo.wakeFd[1], &one, sizeof(one)) < 0 &&
+           errno == EINTR)
+        ;
+#else
+    InputThreadPoke(inputThreadInfo.wakeFd[1]);
+#endif
+}
+
+/**
+ * Register @fd to be read on the input thread.  @proc is called with the
+ * input lock held whenever @fd is readable.
+ *
+ * @return FALSE if the input thread is not running; the caller should
+ * fall back to SIGIO or the main loop.
+ */
+Bool
+InputThreadRegisterDev(int fd, InputThreadProcPtr proc, void *data)
+{
+    InputThreadDevicePtr dev;
+
+    if (!inputThreadInfo.running || fd < 0)
+        return FALSE;
+
+    dev = calloc(1, sizeof(InputThreadDeviceRec));
+    if (!dev)
+        return FALSE;
+
+    dev->fd = fd;
+    dev->readInputProc = proc;
+    dev->readInputArgs = data;
+
+    input_lock();
+    dev->next = inputThreadInfo.devices;
+    inputThreadInfo.devices = dev;
+    inputThreadInfo.devicesChanged = TRUE;
+    input_unlock();
+
+    InputThreadPoke(inputThreadInfo.controlPipe[1]);
+    return TRUE;
+}
+
+/**
+ * Stop reading @fd on the input thread.  Once this returns, the device's
+ * read procedure will not be called again.
+ *
+ * @return FALSE if @fd was not registered with the input thread.
+ */
+Bool
+InputThreadUnregisterDev(int fd)
+{
+    InputThreadDevicePtr *prev, dev = NULL;
+
+    if (!inputThreadInfo.running)
+        return FALSE;
+
+    input_lock();
+    for (prev = &inputThreadInfo.devices; *prev; prev = &(*prev)->next) {
+        if ((*prev)->fd == fd) {
+            dev = *prev;
+            *prev = dev->next;
+            inputThreadInfo.devicesChanged = TRUE;
+            break;
+        }
+    }
+    input_unlock();
+
+    if (!dev)
+        return FALSE;
+
+    free(dev);
+    InputThreadPoke(inputThreadInfo.controlPipe[1]);
+    return TRUE;
+}
+
+/*
+ * Rebuild the poll set from the device list.  Called with the input lock
+ * held.  Slot 0 is always the control pipe.
+ */
+static int
+InputThreadBuildPollSet(struct pollfd **pfds, int *size)
+{
+    InputThreadDevicePtr dev;
+    int n = 1;
+
+    for (dev = inputThreadInfo.devices; dev; dev = dev->next)
+        n++;
+
+    if (n > *size) {
+        struct pollfd *p = realloc(*pfds, n * sizeof(struct pollfd));
+
+        if (!p)
+            return 0;
+        *pfds = p;
+        *size = n;
+    }
+
+    (*pfds)[0].fd = inputThreadInfo.controlPipe[0];
+    (*pfds)[0].events = POLLIN;
+    n = 1;
+    for (dev = inputThreadInfo.devices; dev; dev = dev->next) {
+        (*pfds)[n].fd = dev->fd;
+        (*pfds)[n].events = POLLIN;
+        n++;
+    }
+    inputThreadInfo.devicesChanged = FALSE;
+    return n;
+}
+
+static void *
+InputThreadDoWork(void *arg)
+{
+    struct pollfd *pfds = NULL;
+    int size = 0, n = 0, i;
+
+    for (;;) {
+        Bool posted = FALSE;
+
+        input_lock();
+        if (inputThreadInfo.exiting) {
+            input_unlock();
+            break;
+        }
+        if (inputThreadInfo.devicesChanged || n == 0) {
+            int built = InputThreadBuildPollSet(&pfds, &size);
+
+            /* Out of memory: keep the old set and try again later */
+            if (built)
+                n = built;
+        }
+        input_unlock();
+
+        if (poll(pfds, n, -1) < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            ErrorFSigSafe("input thread: poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        if (pfds[0].revents & POLLIN)
+            InputThreadDrain(pfds[0].fd);
+
+        input_lock();
+        /*
+         * The device list may have changed while we were polling, so
+         * look every ready fd up again rather than trusting the set.
+         */
+        for (i = 1; i < n; i++) {
+            InputThreadDevicePtr dev, next;
+            Bool found = FALSE;
+
+            if (pfds[i].revents & POLLNVAL) {
+                /* closed before being unregistered; stop polling it */
+                pfds[i].fd = -1;
+                continue;
+            }
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            /* several devices may share one fd */
+            for (dev = inputThreadInfo.devices; dev; dev = next) {
+                next = dev->next;
+                if (dev->fd == pfds[i].fd) {
+                    dev->readInputProc(dev->fd, dev->readInputArgs);
+                    found = TRUE;
+                }
+            }
+            if (found)
+                posted = TRUE;
+            else
+                inputThreadInfo.devicesChanged = TRUE;
+        }
+        input_unlock();
+
+        if (posted)
+            InputThreadWakeMain();
+    }
+
+    free(pfds);
+    return NULL;
+}
+
+static void
+InputThreadWakeupHandler(void *data, int result, void *pReadmask)
+{
+    int fd = inputThreadInfo.wakeFd[0];
+
+    if (result > 0 && FD_ISSET(fd, (fd_set *) pReadmask))
+        InputThreadDrain(fd);
+}
+
+static void
+InputThreadBlockHandler(void *data, OSTimePtr pTimeout, void *pReadmask)
+{
+}
+
+static Bool
+InputThreadOpenFds(void)
+{
+    int i;
+
+    if (pipe(inputThreadInfo.controlPipe) < 0)
+        return FALSE;
+#ifdef HAVE_SYS_EVENTFD_H
+    inputThreadInfo.wakeFd[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inputThreadInfo.wakeFd[0] < 0)
+        return FALSE;
+    inputThreadInfo.wakeFd[1] = inputThreadInfo.wakeFd[0];
+#else
+    if (pipe(inputThreadInfo.wakeFd) < 0)
+        return FALSE;
+#endif
+    for (i = 0; i < 2; i++) {
+        fcntl(inputThreadInfo.controlPipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(inputThreadInfo.controlPipe[i], F_SETFD, FD_CLOEXEC);
+        fcntl(inputThreadInfo.wakeFd[i], F_SETFL, O_NONBLOCK);
+        fcntl(inputThreadInfo.wakeFd[i], F_SETFD, FD_CLOEXEC);
+    }
+    return TRUE;
+}
+
+static void
+InputThreadCloseFds(void)
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (inputThreadInfo.controlPipe[i] >= 0)
+            close(inputThreadInfo.controlPipe[i]);
+        inputThreadInfo.controlPipe[i] = -1;
+    }
+    if (inputThreadInfo.wakeFd[0] >= 0)
+        close(inputThreadInfo.wakeFd[0]);
+    if (inputThreadInfo.wakeFd[1] >= 0 &&
+        inputThreadInfo.wakeFd[1] != inputThreadInfo.wakeFd[0])
+        close(inputThreadInfo.wakeFd[1]);
+    inputThreadInfo.wakeFd[0] = inputThreadInfo.wakeFd[1] = -1;
+}
+
+/**
+ * Start the input thread.  Called once per server generation, before
+ * the input devices are enabled.
+ */
+void
+InputThreadInit(void)
+{
+    sigset_t all, old;
+
+    if (!InputThreadEnable || inputThreadInfo.running)
+        return;
+
+    if (!InputThreadOpenFds()) {
+        ErrorF("input thread: cannot create wakeup fds: %s\n",
+               strerror(errno));
+        InputThreadCloseFds();
+        return;
+    }
+
+    if (!input_mutex_initialized)
+        InputMutexInit();
+
+    /* The thread inherits our mask; signals stay on the main thread. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    inputThreadInfo.exiting = FALSE;
+    inputThreadInfo.devicesChanged = TRUE;
+    if (pthread_create(&inputThreadInfo.thread, NULL,
+                       InputThreadDoWork, NULL) != 0) {
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        ErrorF("input thread: cannot create thread, "
+               "reading input on the main thread\n");
+        InputThreadCloseFds();
+        return;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    AddGeneralSocket(inputThreadInfo.wakeFd[0]);
+    RegisterBlockAndWakeupHandlers(InputThreadBlockHandler,
+                                   InputThreadWakeupHandler, NULL);
+    inputThreadInfo.running = TRUE;
+}
+
+/**
+ * Stop the input thread.  Devices should have been unregistered by
+ * CloseDownDevices; any left over are dropped.
+ */
+void
+InputThreadFini(void)
+{
+    InputThreadDevicePtr dev, next;
+
+    if (!inputThreadInfo.running)
+        return;
+
+    input_lock();
+    inputThreadInfo.exiting = TRUE;
+    input_unlock();
+    InputThreadPoke(inputThreadInfo.controlPipe[1]);
+    pthread_join(inputThreadInfo.thread, NULL);
+
+    RemoveBlockAndWakeupHandlers(InputThreadBlockHandler,
+                                 InputThreadWakeupHandler, NULL);
+    RemoveGeneralSocket(inputThreadInfo.wakeFd[0]);
+    InputThreadCloseFds();
+
+    for (dev = inputThreadInfo.devices; dev; dev = next) {
+        next = dev->next;
+        free(dev);
+    }
+    inputThreadInfo.devices = NULL;
+    inputThreadInfo.running = FALSE;
+}
+
+#else                           /* INPUTTHREAD */
+
+Bool
+InputThreadRunning(void)
+{
+    return FALSE;
+}
+
+Bool
+InputThreadRegisterDev(int fd, InputThreadProcPtr proc, void *data)
+{
+    return FALSE;
+}
+
+Bool
+InputThreadUnregisterDev(int fd)
+{
+    return FALSE;
+}
+
+void
+InputThreadInit(void)
+{
+}
+
+void
+InputThreadFini(void)
+{
+}
+
+#endif                          /* INPUTTHREAD */
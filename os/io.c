@@ -92,15 +92,35 @@ typedef struct _connectionInput {
     unsigned int ignoreBytes;   /* bytes to ignore before the next request */
 } ConnectionInput;
 
+/*
+ * Output that could not be written right away and no longer belongs in
+ * the connection's flat buffer.  A chunk either holds a buffer handed
+ * over by WriteToClientAndFree, which is sent in place and freed once
+ * written, or a copy of data queued behind such a buffer.
+ */
+typedef struct _connectionOutputChunk {
+    struct _connectionOutputChunk *next;
+    char *data;
+    int size;                   /* bytes allocated after the header, or 0
+                                   if data was handed over by the caller */
+    int count;                  /* bytes of data */
+    int pad;                    /* zero bytes to send after data */
+    int written;                /* bytes of data + pad already sent */
+} ConnectionOutputChunk, *ConnectionOutputChunkPtr;
+
 typedef struct _connectionOutput {
     struct _connectionOutput *next;
     unsigned char *buf;
     int size;
     int count;
+    ConnectionOutputChunkPtr chunks;    /* sent after buf, in order */
+    ConnectionOutputChunkPtr lastChunk;
 } ConnectionOutput;
 
 static ConnectionInputPtr AllocateInputBuffer(void);
 static ConnectionOutputPtr AllocateOutputBuffer(void);
+static int DoWriteToClient(ClientPtr who, int count, const void *buf,
+                           Bool handOver);
 
 /* If EAGAIN and EWOULDBLOCK are distinct errno values, then we check errno
  * for both EAGAIN and EWOULDBLOCK, because some supposedly POSIX
@@ -134,6 +154,34 @@ static OsCommPtr AvailableInput = (OsCommPtr) NULL;
 #define MAX_TIMES_PER         10
 #define BUFSIZE 4096
 #define BUFWATERMARK 8192
+#define OUTPUT_IOVECS 16        /* iovecs gathered per write */
+
+/*
+ * Input buffers come in a few size classes, so clients streaming big
+ * requests reuse warm buffers rather than going through realloc and free
+ * on every request.  Larger requests get a buffer of their own size.
+ * Only the small classes keep spare buffers, and never more than
+ * INPUT_POOL_BYTES in all, so an idle server does not hold on to the
+ * memory a burst of huge requests needed.
+ */
+#define INPUT_CLASSES 4
+static const int InputClassSize[INPUT_CLASSES] = {
+    BUFSIZE, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024
+};
+static const int InputClassPoolMax[INPUT_CLASSES] = { 16, 8, 0, 0 };
+#define INPUT_POOL_BYTES (512 * 1024)
+static char *InputPool[INPUT_CLASSES];
+static int InputPoolCount[INPUT_CLASSES];
+static int InputPoolBytes;
+
+/*
+ * Every INPUT_TRIM_INTERVAL ms while any client holds a buffer bigger
+ * than BUFSIZE, its high water mark decays and a drained buffer shrinks
+ * to what the client still needs, whether or not it sends anything.
+ */
+#define INPUT_TRIM_INTERVAL 1000
+static OsTimerPtr InputTrimTimer;
+static Bool InputTrimPending;
 
 /*
  *   A lot of the code in this file manipulates a ConnectionInputPtr:
@@ -211,10 +259,136 @@ YieldControlDeath(void)
     timesThisConnection = 0;
 }
 
-/* If an input buffer was empty, either free it if it is too big or link it
- * into our list of free input buffers.  This means that different clients can
- * share the same input buffer (at different times).  This was done to save
- * memory.
+/* Smallest class holding size bytes, or INPUT_CLASSES if none does */
+static int
+InputClass(int size)
+{
+    int i;
+
+    for (i = 0; i < INPUT_CLASSES; i++)
+        if (size <= InputClassSize[i])
+            break;
+    return i;
+}
+
+/* Get a buffer of at least size bytes, returning its real size in *got */
+static char *
+GetInputBuffer(int size, int *got)
+{
+    int i = InputClass(size);
+    char *buf;
+
+    if (i == INPUT_CLASSES) {
+        *got = size;
+        return malloc(size);
+    }
+    *got = InputClassSize[i];
+    if ((buf = InputPool[i])) {
+        InputPool[i] = *(char **) buf;
+        InputPoolCount[i]--;
+        InputPoolBytes -= InputClassSize[i];
+        return buf;
+    }
+    return malloc(InputClassSize[i]);
+}
+
+static void
+PutInputBuffer(char *buf, int size)
+{
+    int i = InputClass(size);
+
+    if (i < INPUT_CLASSES && size == InputClassSize[i] &&
+        InputPoolCount[i] < InputClassPoolMax[i] &&
+        InputPoolBytes + size <= INPUT_POOL_BYTES) {
+        *(char **) buf = InputPool[i];
+        InputPool[i] = buf;
+        InputPoolCount[i]++;
+        InputPoolBytes += size;
+    }
+    else
+        free(buf);
+}
+
+static void ArmInputTrim(void);
+
+/* Move the unread input of oci into a buffer of size bytes */
+static Bool
+ResizeInputBuffer(ConnectionInputPtr oci, int size)
+{
+    int gotnow = oci->bufcnt + oci->buffer - oci->bufptr;
+    char *ibuf;
+
+    ibuf = GetInputBuffer(size, &size);
+    if (!ibuf)
+        return FALSE;
+    memcpy(ibuf, oci->bufptr, gotnow);
+    PutInputBuffer(oci->buffer, oci->size);
+    oci->buffer = ibuf;
+    oci->size = size;
+    oci->bufptr = ibuf;
+    oci->bufcnt = gotnow;
+    if (size > BUFSIZE)
+        ArmInputTrim();
+    return TRUE;
+}
+
+/*
+ * Let the high water mark of each client with a big input buffer decay,
+ * or drop it if all is set, and shrink the buffers holding nothing but
+ * the last request.  Returns how many big buffers are left.
+ */
+static int
+TrimInputBuffers(Bool all)
+{
+    int i, big = 0;
+
+    for (i = 1; i < currentMaxClients; i++) {
+        ClientPtr client = clients[i];
+        OsCommPtr oc;
+        ConnectionInputPtr oci;
+
+        if (!client || !(oc = client->osPrivate) || !(oci = oc->input) ||
+            oci->size <= BUFSIZE)
+            continue;
+
+        oc->inputHighWater = all ? 0 : oc->inputHighWater >> 1;
+        if (oci->bufcnt + oci->buffer - oci->bufptr == oci->lenLastReq &&
+            InputClass(oc->inputHighWater) < InputClass(oci->size)) {
+            oci->bufptr += oci->lenLastReq;
+            oci->lenLastReq = 0;
+            ResizeInputBuffer(oci, max(oc->inputHighWater, BUFSIZE));
+        }
+        if (oci->size > BUFSIZE)
+            big++;
+    }
+    return big;
+}
+
+static CARD32
+InputTrimTimeout(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    if (TrimInputBuffers(FALSE))
+        return INPUT_TRIM_INTERVAL;
+    InputTrimPending = FALSE;
+    return 0;
+}
+
+static void
+ArmInputTrim(void)
+{
+    if (InputTrimPending)
+        return;
+    InputTrimTimer = TimerSet(InputTrimTimer, 0, INPUT_TRIM_INTERVAL,
+                              InputTrimTimeout, NULL);
+    InputTrimPending = InputTrimTimer != NULL;
+}
+
+/* If an input buffer was empty, either return it to the pool if it is too
+ * big or link it into our list of free input buffers.  This means that
+ * different clients can share the same input buffer (at different times).
+ * This was done to save memory.  A client whose recent requests still
+ * need its big buffer keeps it, and the high water mark decays every time
+ * the buffer drains, so one that stops sending big requests lets go of it.
  */
 static void
 NextAvailableInput(OsCommPtr oc)
@@ -223,15 +397,18 @@ NextAvailableInput(OsCommPtr oc)
         if (AvailableInput != oc) {
             ConnectionInputPtr aci = AvailableInput->input;
 
-            if (aci->size > BUFWATERMARK) {
-                free(aci->buffer);
-                free(aci);
-            }
-            else {
+            AvailableInput->inputHighWater >>= 1;
+            if (aci->size == BUFSIZE) {
                 aci->next = FreeInputs;
                 FreeInputs = aci;
+                AvailableInput->input = NULL;
+            }
+            else if (InputClass(AvailableInput->inputHighWater) <
+                     InputClass(aci->size)) {
+                PutInputBuffer(aci->buffer, aci->size);
+                free(aci);
+                AvailableInput->input = NULL;
             }
-            AvailableInput->input = NULL;
         }
         AvailableInput = NULL;
     }
@@ -331,24 +508,25 @@ ReadRequestFromClient(ClientPtr client)
             oci->lenLastReq = gotnow;
             return needed;
         }
-        if ((gotnow == 0) || ((oci->bufptr - oci->buffer + needed) > oci->size)) {
+        if (needed > oc->inputHighWater)
+            oc->inputHighWater = needed;
+        if (needed > oc->inputPeak)
+            oc->inputPeak = needed;
+        if (needed > oci->size) {
+            /* move to a buffer of the next size class that fits */
+            if (!ResizeInputBuffer(oci, needed)) {
+                YieldControlDeath();
+                return -1;
+            }
+            oc->inputGrows++;
+        }
+        else if ((gotnow == 0) ||
+                 ((oci->bufptr - oci->buffer + needed) > oci->size)) {
             /* no data, or the request is too big to fit in the buffer */
 
             if ((gotnow > 0) && (oci->bufptr != oci->buffer))
                 /* save the data we've already read */
                 memmove(oci->buffer, oci->bufptr, gotnow);
-            if (needed > oci->size) {
-                /* make buffer bigger to accomodate request */
-                char *ibuf;
-
-                ibuf = (char *) realloc(oci->buffer, needed);
-                if (!ibuf) {
-                    YieldControlDeath();
-                    return -1;
-                }
-                oci->size = needed;
-                oci->buffer = ibuf;
-            }
             oci->bufptr = oci->buffer;
             oci->bufcnt = gotnow;
         }
@@ -381,18 +559,11 @@ ReadRequestFromClient(ClientPtr client)
         }
         oci->bufcnt += result;
         gotnow += result;
-        /* free up some space after huge requests */
-        if ((oci->size > BUFWATERMARK) &&
-            (oci->bufcnt < BUFSIZE) && (needed < BUFSIZE)) {
-            char *ibuf;
-
-            ibuf = (char *) realloc(oci->buffer, BUFSIZE);
-            if (ibuf) {
-                oci->size = BUFSIZE;
-                oci->buffer = ibuf;
-                oci->bufptr = ibuf + oci->bufcnt - gotnow;
-            }
-        }
+        /* free up some space once the client's huge requests stop */
+        if ((oci->size > BUFSIZE) &&
+            (InputClass(max(oc->inputHighWater, gotnow)) <
+             InputClass(oci->size)))
+            ResizeInputBuffer(oci, max(oc->inputHighWater, gotnow));
         if (need_header && gotnow >= needed) {
             /* We wanted an xReq, now we've gotten it. */
             request = (xReq *) oci->bufptr;
@@ -550,14 +721,8 @@ InsertFakeRequest(ClientPtr client, char *data, int count)
     oci->lenLastReq = 0;
     gotnow = oci->bufcnt + oci->buffer - oci->bufptr;
     if ((gotnow + count) > oci->size) {
-        char *ibuf;
-
-        ibuf = (char *) realloc(oci->buffer, gotnow + count);
-        if (!ibuf)
+        if (!ResizeInputBuffer(oci, gotnow + count))
             return FALSE;
-        oci->size = gotnow + count;
-        oci->buffer = ibuf;
-        oci->bufptr = ibuf + oci->bufcnt - gotnow;
     }
     moveup = count - (oci->bufptr - oci->buffer);
     if (moveup > 0) {
@@ -718,6 +883,105 @@ SetCriticalOutputPending(void)
     CriticalOutputPending = TRUE;
 }
 
+static void
+FreeOutputChunk(ConnectionOutputChunkPtr chunk)
+{
+    if (!chunk->size)
+        free(chunk->data);
+    free(chunk);
+}
+
+static void
+FreeOutputChunks(ConnectionOutputPtr oco)
+{
+    ConnectionOutputChunkPtr chunk;
+
+    while ((chunk = oco->chunks)) {
+        oco->chunks = chunk->next;
+        FreeOutputChunk(chunk);
+    }
+    oco->lastChunk = NULL;
+}
+
+static void
+QueueOutputChunk(ConnectionOutputPtr oco, ConnectionOutputChunkPtr chunk)
+{
+    chunk->next = NULL;
+    if (oco->lastChunk)
+        oco->lastChunk->next = chunk;
+    else
+        oco->chunks = chunk;
+    oco->lastChunk = chunk;
+}
+
+/* Queue a buffer from malloc to be sent in place and freed once written */
+static Bool
+QueueOutputBuffer(ConnectionOutputPtr oco, void *buf, int count)
+{
+    ConnectionOutputChunkPtr chunk;
+
+    chunk = malloc(sizeof(ConnectionOutputChunk));
+    if (!chunk)
+        return FALSE;
+    chunk->data = buf;
+    chunk->size = 0;
+    chunk->count = count;
+    chunk->pad = padding_for_int32(count);
+    chunk->written = 0;
+    QueueOutputChunk(oco, chunk);
+    return TRUE;
+}
+
+/*
+ * Append count bytes of buf plus pad zero bytes to the pending output.
+ * They go in the flat buffer when nothing is queued behind it and there
+ * is room, else in a copy chunk at the end of the queue.
+ */
+static Bool
+AppendOutput(ConnectionOutputPtr oco, const char *buf, int count, int pad)
+{
+    ConnectionOutputChunkPtr chunk = oco->lastChunk;
+    char *dst;
+
+    if (!oco->chunks && oco->count + count + pad <= oco->size) {
+        dst = (char *) oco->buf + oco->count;
+        oco->count += count + pad;
+    }
+    else if (chunk && chunk->size &&
+             chunk->count + count + pad <= chunk->size) {
+        dst = chunk->data + chunk->count;
+        chunk->count += count + pad;
+    }
+    else {
+        int size = max(count + pad, BUFSIZE);
+
+        chunk = malloc(sizeof(ConnectionOutputChunk) + size);
+        if (!chunk)
+            return FALSE;
+        chunk->data = (char *) (chunk + 1);
+        chunk->size = size;
+        chunk->count = count + pad;
+        chunk->pad = 0;
+        chunk->written = 0;
+        QueueOutputChunk(oco, chunk);
+        dst = chunk->data;
+    }
+    memmove(dst, buf, count);
+    memset(dst + count, '\0', pad);
+    return TRUE;
+}
+
+static void
+AbortClientOutput(ClientPtr who, OsCommPtr oc)
+{
+    if (oc->trans_conn) {
+        _XSERVTransDisconnect(oc->trans_conn);
+        _XSERVTransClose(oc->trans_conn);
+        oc->trans_conn = NULL;
+    }
+    MarkClientException(who);
+}
+
 /*****************
  * WriteToClient
  *    Copies buf into ClientPtr.buf if it fits (with padding), else
@@ -731,6 +995,27 @@ SetCriticalOutputPending(void)
 
 int
 WriteToClient(ClientPtr who, int count, const void *__buf)
+{
+    return DoWriteToClient(who, count, __buf, FALSE);
+}
+
+/*****************
+ * WriteToClientAndFree
+ *    Like WriteToClient, but takes ownership of buf, which must come
+ *    from malloc.  Data that cannot be sent right away is queued by
+ *    reference instead of being copied, and buf is freed once it has
+ *    been written or the client is gone.  The caller must not touch
+ *    buf after the call.
+ *****************/
+
+int
+WriteToClientAndFree(ClientPtr who, int count, void *buf)
+{
+    return DoWriteToClient(who, count, buf, TRUE);
+}
+
+static int
+DoWriteToClient(ClientPtr who, int count, const void *__buf, Bool handOver)
 {
     OsCommPtr oc;
     ConnectionOutputPtr oco;
@@ -740,8 +1025,11 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
 #ifdef DEBUG_COMMUNICATION
     Bool multicount = FALSE;
 #endif
-    if (!count || !who || who == serverClient || who->clientGone)
+    if (!count || !who || who == serverClient || who->clientGone) {
+        if (handOver)
+            free((void *) buf);
         return 0;
+    }
     oc = who->osPrivate;
     oco = oc->output;
 #ifdef DEBUG_COMMUNICATION
@@ -790,12 +1078,9 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
             FreeOutputs = oco->next;
         }
         else if (!(oco = AllocateOutputBuffer())) {
-            if (oc->trans_conn) {
-                _XSERVTransDisconnect(oc->trans_conn);
-                _XSERVTransClose(oc->trans_conn);
-                oc->trans_conn = NULL;
-            }
-            MarkClientException(who);
+            AbortClientOutput(who, oc);
+            if (handOver)
+                free((void *) buf);
             return -1;
         }
         oc->output = oco;
@@ -843,6 +1128,28 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         }
     }
 #endif
+    /* Once output is queued in chunks, everything else has to wait
+       behind it until the client drains the queue. */
+    if (oco->chunks) {
+        Bool queued;
+
+        if (handOver)
+            queued = QueueOutputBuffer(oco, (void *) buf, count);
+        else
+            queued = AppendOutput(oco, buf, count, padBytes);
+        if (!queued) {
+            AbortClientOutput(who, oc);
+            FreeOutputChunks(oco);
+            oco->count = 0;
+            if (handOver)
+                free((void *) buf);
+            return -1;
+        }
+        NewOutputPending = TRUE;
+        FD_SET(oc->fd, &OutputPending);
+        return count;
+    }
+
     if (oco->count == 0 || oco->count + count + padBytes > oco->size) {
         FD_CLR(oc->fd, &OutputPending);
         if (!XFD_ANYSET(&OutputPending)) {
@@ -853,6 +1160,15 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         if (FlushCallback)
             CallCallbacks(&FlushCallback, NULL);
 
+        if (handOver) {
+            if (!QueueOutputBuffer(oco, (void *) buf, count)) {
+                AbortClientOutput(who, oc);
+                oco->count = 0;
+                free((void *) buf);
+                return -1;
+            }
+            return FlushClient(who, oc, NULL, 0) < 0 ? -1 : count;
+        }
         return FlushClient(who, oc, buf, count);
     }
 
@@ -864,11 +1180,15 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         memset(oco->buf + oco->count, '\0', padBytes);
         oco->count += padBytes;
     }
+    if (handOver)
+        free((void *) buf);
     return count;
 }
 
  /********************
  * FlushClient()
+ *    Writes the client's buffered output, then any queued chunks, then
+ *    extraBuf, gathering them into as few writev calls as possible.
  *    If the client isn't keeping up with us, then we try to continue
  *    buffering the data and set the apropriate bit in ClientsWritable
  *    (which is used by WaitFor in the select).  If the connection yields
@@ -883,65 +1203,93 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
     ConnectionOutputPtr oco = oc->output;
     int connection = oc->fd;
     XtransConnInfo trans_conn = oc->trans_conn;
-    struct iovec iov[3];
+    struct iovec iov[OUTPUT_IOVECS];
     static char padBuffer[3];
     const char *extraBuf = __extraBuf;
-    long written;
+    ConnectionOutputChunkPtr chunk;
+    long bufWritten, extraWritten;
     long padsize;
     long notWritten;
     long todo;
 
     if (!oco)
 	return 0;
-    written = 0;
+    bufWritten = extraWritten = 0;
     padsize = padding_for_int32(extraCount);
     notWritten = oco->count + extraCount + padsize;
+    for (chunk = oco->chunks; chunk; chunk = chunk->next)
+        notWritten += chunk->count + chunk->pad - chunk->written;
     if (!notWritten)
         return 0;
 
     todo = notWritten;
     while (notWritten) {
-        long before = written;  /* amount of whole thing written */
         long remain = todo;     /* amount to try this time, <= notWritten */
         int i = 0;
-        long len;
-
-        /* You could be very general here and have "in" and "out" iovecs
-         * and write a loop without using a macro, but what the heck.  This
-         * translates to:
-         *
-         *     how much of this piece is new?
-         *     if more new then we are trying this time, clamp
-         *     if nothing new
-         *         then bump down amount already written, for next piece
-         *         else put new stuff in iovec, will need all of next piece
-         *
-         * Note that todo had better be at least 1 or else we'll end up
-         * writing 0 iovecs.
+        long len, done;
+
+        /* Gather pieces in order until we run out of iovecs or reach
+         * todo.  Once one piece is cut short nothing after it can go
+         * in, so the stream stays in order.  todo had better be at
+         * least 1 or else we'll end up writing 0 iovecs.
          */
 #define InsertIOV(pointer, length) \
-	len = (length) - before; \
+	len = (length); \
 	if (len > remain) \
 	    len = remain; \
-	if (len <= 0) { \
-	    before = (-len); \
-	} else { \
+	if (len > 0 && i < OUTPUT_IOVECS) { \
 	    iov[i].iov_len = len; \
-	    iov[i].iov_base = (pointer) + before;	\
+	    iov[i].iov_base = (pointer); \
 	    i++; \
 	    remain -= len; \
-	    before = 0; \
-	}
-
-        InsertIOV((char *) oco->buf, oco->count)
-            InsertIOV((char *) extraBuf, extraCount)
+	    if (len < (length)) \
+	        remain = 0; \
+	} \
+	else if (len > 0) \
+	    remain = 0;
+
+        InsertIOV((char *) oco->buf + bufWritten, oco->count - bufWritten)
+        for (chunk = oco->chunks; chunk && remain; chunk = chunk->next) {
+            if (chunk->written < chunk->count) {
+                InsertIOV(chunk->data + chunk->written,
+                          chunk->count - chunk->written)
+                InsertIOV(padBuffer, chunk->pad)
+            }
+            else {
+                InsertIOV(padBuffer, chunk->count + chunk->pad - chunk->written)
+            }
+        }
+        if (extraWritten < extraCount) {
+            InsertIOV((char *) extraBuf + extraWritten,
+                      extraCount - extraWritten)
             InsertIOV(padBuffer, padsize)
+        }
+        else {
+            InsertIOV(padBuffer, extraCount + padsize - extraWritten)
+        }
+#undef InsertIOV
 
-            errno = 0;
+        errno = 0;
         if (trans_conn && (len = _XSERVTransWritev(trans_conn, iov, i)) >= 0) {
-            written += len;
             notWritten -= len;
             todo = notWritten;
+
+            /* hand the written bytes back out to the pieces, in order */
+            done = min(len, oco->count - bufWritten);
+            bufWritten += done;
+            len -= done;
+            while ((chunk = oco->chunks)) {
+                done = min(len, chunk->count + chunk->pad - chunk->written);
+                chunk->written += done;
+                len -= done;
+                if (chunk->written < chunk->count + chunk->pad)
+                    break;
+                oco->chunks = chunk->next;
+                if (!oco->chunks)
+                    oco->lastChunk = NULL;
+                FreeOutputChunk(chunk);
+            }
+            extraWritten += len;
         }
         else if (ETEST(errno)
 #ifdef SUNSYSV                  /* check for another brain-damaged OS bug */
@@ -957,43 +1305,27 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
             FD_SET(connection, &ClientsWriteBlocked);
             AnyClientsWriteBlocked = TRUE;
 
-            if (written < oco->count) {
-                if (written > 0) {
-                    oco->count -= written;
-                    memmove((char *) oco->buf,
-                            (char *) oco->buf + written, oco->count);
-                    written = 0;
-                }
-            }
-            else {
-                written -= oco->count;
-                oco->count = 0;
+            if (bufWritten > 0) {
+                oco->count -= bufWritten;
+                memmove((char *) oco->buf,
+                        (char *) oco->buf + bufWritten, oco->count);
             }
 
-            if (notWritten > oco->size) {
-                unsigned char *obuf;
+            /* Keep what is left of extraBuf behind everything else.  If
+               the amount written extended into the padding, then
+               "extraCount - extraWritten" may be less than 0 */
+            if (extraWritten < extraCount + padsize) {
+                long left = max(extraCount - extraWritten, 0);
 
-                obuf = (unsigned char *) realloc(oco->buf,
-                                                 notWritten + BUFSIZE);
-                if (!obuf) {
-                    _XSERVTransDisconnect(oc->trans_conn);
-                    _XSERVTransClose(oc->trans_conn);
-                    oc->trans_conn = NULL;
-                    MarkClientException(who);
+                if (!AppendOutput(oco, extraBuf + extraCount - left, left,
+                                  extraCount + padsize - extraWritten - left)) {
+                    AbortClientOutput(who, oc);
+                    FreeOutputChunks(oco);
                     oco->count = 0;
                     return -1;
                 }
-                oco->size = notWritten + BUFSIZE;
-                oco->buf = obuf;
             }
 
-            /* If the amount written extended into the padBuffer, then the
-               difference "extraCount - written" may be less than 0 */
-            if ((len = extraCount - written) > 0)
-                memmove((char *) oco->buf + oco->count,
-                        extraBuf + written, len);
-
-            oco->count = notWritten;    /* this will include the pad */
             /* return only the amount explicitly requested */
             return extraCount;
         }
@@ -1003,12 +1335,8 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
         }
 #endif
         else {
-            if (oc->trans_conn) {
-                _XSERVTransDisconnect(oc->trans_conn);
-                _XSERVTransClose(oc->trans_conn);
-                oc->trans_conn = NULL;
-            }
-            MarkClientException(who);
+            AbortClientOutput(who, oc);
+            FreeOutputChunks(oco);
             oco->count = 0;
             return -1;
         }
@@ -1042,12 +1370,11 @@ AllocateInputBuffer(void)
     oci = malloc(sizeof(ConnectionInput));
     if (!oci)
         return NULL;
-    oci->buffer = malloc(BUFSIZE);
+    oci->buffer = GetInputBuffer(BUFSIZE, &oci->size);
     if (!oci->buffer) {
         free(oci);
         return NULL;
     }
-    oci->size = BUFSIZE;
     oci->bufptr = oci->buffer;
     oci->bufcnt = 0;
     oci->lenLastReq = 0;
@@ -1070,9 +1397,24 @@ AllocateOutputBuffer(void)
     }
     oco->size = BUFSIZE;
     oco->count = 0;
+    oco->chunks = NULL;
+    oco->lastChunk = NULL;
     return oco;
 }
 
+/* Log how big a client's requests got, if it ever outgrew BUFSIZE */
+void
+LogInputStats(ClientPtr client)
+{
+    OsCommPtr oc = client->osPrivate;
+
+    if (oc->inputPeak > BUFSIZE)
+        LogMessageVerb(X_INFO, 3,
+                       "input: client %d: largest request %d bytes, "
+                       "buffer grown %u times\n",
+                       client->index, oc->inputPeak, oc->inputGrows);
+}
+
 void
 FreeOsBuffers(OsCommPtr oc)
 {
@@ -1082,8 +1424,8 @@ FreeOsBuffers(OsCommPtr oc)
     if (AvailableInput == oc)
         AvailableInput = (OsCommPtr) NULL;
     if ((oci = oc->input)) {
-        if (FreeInputs) {
-            free(oci->buffer);
+        if (FreeInputs || oci->size != BUFSIZE) {
+            PutInputBuffer(oci->buffer, oci->size);
             free(oci);
         }
         else {
@@ -1096,6 +1438,7 @@ FreeOsBuffers(OsCommPtr oc)
         }
     }
     if ((oco = oc->output)) {
+        FreeOutputChunks(oco);
         if (FreeOutputs) {
             free(oco->buf);
             free(oco);
@@ -1113,12 +1456,28 @@ ResetOsBuffers(void)
 {
     ConnectionInputPtr oci;
     ConnectionOutputPtr oco;
+    char *buf;
+    int i;
+
+    /* shrink what idle clients hold before the pools are emptied */
+    if (!TrimInputBuffers(TRUE) && InputTrimPending) {
+        TimerCancel(InputTrimTimer);
+        InputTrimPending = FALSE;
+    }
 
     while ((oci = FreeInputs)) {
         FreeInputs = oci->next;
         free(oci->buffer);
         free(oci);
     }
+    for (i = 0; i < INPUT_CLASSES; i++) {
+        while ((buf = InputPool[i])) {
+            InputPool[i] = *(char **) buf;
+            free(buf);
+        }
+        InputPoolCount[i] = 0;
+    }
+    InputPoolBytes = 0;
     while ((oco = FreeOutputs)) {
         FreeOutputs = oco->next;
         free(oco->buf);
@@ -145,6 +145,9 @@ typedef struct _osComm {
     int fd;
     ConnectionInputPtr input;
     ConnectionOutputPtr output;
+    int inputHighWater;         /* recent largest request, decays */
+    int inputPeak;              /* largest request ever */
+    unsigned int inputGrows;    /* times the input buffer had to grow */
     XID auth_id;                /* authorization id */
     CARD32 conn_time;           /* timestamp if not established, else 0  */
     struct _XtransConnInfo *trans_conn; /* transport connection object */
@@ -156,6 +159,8 @@ extern int FlushClient(ClientPtr /*who */ ,
                        int      /*extraCount */
     );
 
+extern void LogInputStats(ClientPtr /*client */ );
+
 extern void FreeOsBuffers(OsCommPtr     /*oc */
     );
 
@@ -191,6 +196,14 @@ typedef long int fd_mask;
 #define ffs mffs
 extern int mffs(fd_mask);
 
+#define POLL_BACKEND_SELECT	0
+#define POLL_BACKEND_EPOLL	1
+extern int PollBackend;
+extern void PollForgetFd(int fd);
+
+/* in inputthread.c */
+extern Bool InputThreadEnable;
+
 /* in access.c */
 extern Bool ComputeLocalClient(ClientPtr client);
 
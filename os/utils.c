@@ -117,6 +117,7 @@ __stdcall unsigned long GetTickCount(void);
 #include "opaque.h"
 
 #include "dixstruct.h"
+#include "reqstats.h"
 
 #include "xkbsrv.h"
 
@@ -592,6 +593,13 @@ UseMsg(void)
     ErrorF
         ("-dumbSched             Disable smart scheduling, enable old behavior\n");
     ErrorF("-schedInterval int     Set scheduler interval in msec\n");
+    ErrorF("-schedLatency int      Favour compositing clients, latency target in msec\n");
+    ErrorF("-reqstats              Time requests, dump statistics on a signal\n");
+    ErrorF("-reqstatssignal int    Signal that dumps statistics, 0 for none\n");
+    ErrorF("-pollBackend name      Wait for clients with select or epoll\n");
+#ifdef INPUTTHREAD
+    ErrorF("-noinputthread         Read input devices on the main thread\n");
+#endif
     ErrorF("-sigstop               Enable SIGSTOP based startup\n");
     ErrorF("+extension name        Enable extension\n");
     ErrorF("-extension name        Disable extension\n");
@@ -983,6 +991,32 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-reqstats") == 0) {
+            RequestStatsEnabled = TRUE;
+        }
+        else if (strcmp(argv[i], "-reqstatssignal") == 0) {
+            if (++i < argc) {
+                char *end;
+                long sig = strtol(argv[i], &end, 10);
+
+                if (*argv[i] == '\0' || *end != '\0' || sig < 0 ||
+                    sig >= NSIG || sig == SIGKILL || sig == SIGSTOP) {
+                    UseMsg();
+                    FatalError("Invalid -reqstatssignal: %s\n", argv[i]);
+                }
+                RequestStatsSignalNumber = sig;
+            }
+            else
+                UseMsg();
+        }
+        else if (strcmp(argv[i], "-schedLatency") == 0) {
+            if (++i < argc && atoi(argv[i]) > 0) {
+                SmartSchedulePolicy = SMART_POLICY_LATENCY;
+                SmartScheduleLatency = atoi(argv[i]);
+            }
+            else
+                UseMsg();
+        }
         else if (strcmp(argv[i], "-schedMax") == 0) {
             if (++i < argc) {
                 SmartScheduleMaxSlice = atoi(argv[i]);
@@ -990,6 +1024,25 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+#endif
+        else if (strcmp(argv[i], "-pollBackend") == 0) {
+            if (++i < argc) {
+                if (strcmp(argv[i], "select") == 0)
+                    PollBackend = POLL_BACKEND_SELECT;
+#ifdef HAVE_EPOLL_CREATE1
+                else if (strcmp(argv[i], "epoll") == 0)
+                    PollBackend = POLL_BACKEND_EPOLL;
+#endif
+                else
+                    FatalError("Unsupported poll backend: %s\n", argv[i]);
+            }
+            else
+                UseMsg();
+        }
+#ifdef INPUTTHREAD
+        else if (strcmp(argv[i], "-noinputthread") == 0) {
+            InputThreadEnable = FALSE;
+        }
 #endif
         else if (strcmp(argv[i], "-render") == 0) {
             if (++i < argc) {
@@ -1215,6 +1268,12 @@ SmartScheduleStopTimer(void)
 #endif
 }
 
+/*
+ * The latency policy needs a clock at least as fine as its target, or
+ * bulk clients could not be cut off at it.
+ */
+static long SmartScheduleTick = 1;
+
 void
 SmartScheduleStartTimer(void)
 {
@@ -1223,10 +1282,14 @@ SmartScheduleStartTimer(void)
 
     if (SmartScheduleDisable)
         return;
+    SmartScheduleTick = SmartScheduleInterval;
+    if (SmartSchedulePolicy == SMART_POLICY_LATENCY &&
+        SmartScheduleLatency < SmartScheduleTick)
+        SmartScheduleTick = SmartScheduleLatency;
     timer.it_interval.tv_sec = 0;
-    timer.it_interval.tv_usec = SmartScheduleInterval * 1000;
+    timer.it_interval.tv_usec = SmartScheduleTick * 1000;
     timer.it_value.tv_sec = 0;
-    timer.it_value.tv_usec = SmartScheduleInterval * 1000;
+    timer.it_value.tv_usec = SmartScheduleTick * 1000;
     setitimer(ITIMER_REAL, &timer, 0);
 #endif
 }
@@ -1234,7 +1297,7 @@ SmartScheduleStartTimer(void)
 static void
 SmartScheduleTimer(int sig)
 {
-    SmartScheduleTime += SmartScheduleInterval;
+    SmartScheduleTime += SmartScheduleTick;
 }
 
 void
@@ -1301,6 +1364,7 @@ static sigset_t PreviousSigIOMask;
 int
 OsBlockSIGIO(void)
 {
+    input_lock();
 #ifdef SIGIO
 #ifdef SIG_BLOCK
     if (sigio_blocked++ == 0) {
@@ -1328,9 +1392,12 @@ OsReleaseSIGIO(void)
     } else if (sigio_blocked < 0) {
         BUG_WARN(sigio_blocked < 0);
         sigio_blocked = 0;
+        /* unbalanced release; we do not hold the input lock either */
+        return;
     }
 #endif
 #endif
+    input_unlock();
 }
 
 void
@@ -128,6 +128,12 @@ proc_present_pixmap(ClientPtr client)
     if (nnotifies % sizeof (xPresentNotify))
         return BadLength;
 
+    /* Presenting clients are paced by vblank; schedule them promptly */
+    if (!client->smart_presents) {
+        client->smart_presents = TRUE;
+        SmartScheduleClientLatency(client, TRUE);
+    }
+
     nnotifies /= sizeof (xPresentNotify);
     if (nnotifies) {
         ret = present_create_notifies(client, nnotifies, (xPresentNotify *) (stuff + 1), &notifies);
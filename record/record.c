@@ -172,6 +172,32 @@ static DevPrivateKeyRec RecordClientPrivateKeyRec;
 #define RecordClientPrivate(_pClient) (RecordClientPrivatePtr) \
     dixLookupPrivate(&(_pClient)->devPrivates, RecordClientPrivateKey)
 
+/* Per-client dispatch table.  Lists the RCAPs of enabled contexts that
+ * record the client, so the callbacks below only look at contexts that
+ * care about it, and which major opcodes any of them want replies for,
+ * so unrecorded replies are passed over without looking at any context.
+ * Tables are rebuilt lazily: anything that changes which clients enabled
+ * contexts record bumps recordTableSerial.
+ */
+typedef struct {
+    unsigned long serial;       /* recordTableSerial this was built for */
+    int numRCAPs;               /* entries in ppRCAP */
+    int sizeRCAPs;              /* allocated size of ppRCAP */
+    RecordClientsAndProtocolPtr *ppRCAP;
+    CARD8 replyMajors[256 / 8]; /* reply major opcodes anybody records */
+} RecordClientTableRec, *RecordClientTablePtr;
+
+static DevPrivateKeyRec RecordClientTableKeyRec;
+
+#define RecordClientTableKey (&RecordClientTableKeyRec)
+
+static unsigned long recordTableSerial = 1;
+
+#define RecordInvalidateClientTables() (recordTableSerial++)
+
+#define RecordTableHasMajor(_bits, _major) \
+    ((_bits)[(_major) >> 3] & (1 << ((_major) & 7)))
+
 /***************************************************************************/
 
 /* global list of all contexts */
@@ -432,6 +458,88 @@ RecordFindClientOnContext(RecordContextPtr pContext,
     return NULL;
 }                               /* RecordFindClientOnContext */
 
+/* RecordClientTable
+ *
+ * Arguments:
+ *	pClient is the client whose dispatch table is wanted.
+ *
+ * Returns:
+ *	The client's dispatch table, rebuilt first if contexts or their
+ *	client lists have changed since it was last built.
+ *
+ * Side Effects:
+ *	The table's RCAP array may be reallocated.  If that fails, the
+ *	table is left short and is rebuilt on the next call.
+ */
+static RecordClientTablePtr
+RecordClientTable(ClientPtr pClient)
+{
+    RecordClientTablePtr pTable;
+    int eci;
+
+    pTable = dixGetPrivateAddr(&pClient->devPrivates, RecordClientTableKey);
+    if (pTable->serial == recordTableSerial)
+        return pTable;
+
+    pTable->numRCAPs = 0;
+    memset(pTable->replyMajors, 0, sizeof(pTable->replyMajors));
+    for (eci = 0; eci < numEnabledContexts; eci++) {
+        RecordClientsAndProtocolPtr pRCAP;
+
+        pRCAP = RecordFindClientOnContext(ppAllContexts[eci],
+                                          pClient->clientAsMask, NULL);
+        if (!pRCAP)
+            continue;
+
+        if (pTable->numRCAPs == pTable->sizeRCAPs) {
+            RecordClientsAndProtocolPtr *ppNew;
+
+            ppNew = realloc(pTable->ppRCAP, (pTable->sizeRCAPs + 4) *
+                            sizeof(RecordClientsAndProtocolPtr));
+            if (!ppNew)
+                return pTable;
+            pTable->ppRCAP = ppNew;
+            pTable->sizeRCAPs += 4;
+        }
+        pTable->ppRCAP[pTable->numRCAPs++] = pRCAP;
+
+        if (pRCAP->pReplyMajorOpSet) {
+            RecordSetIteratePtr pIter = NULL;
+            RecordSetInterval interval;
+
+            while ((pIter = RecordIterateSet(pRCAP->pReplyMajorOpSet,
+                                             pIter, &interval))) {
+                unsigned int j;
+
+                for (j = interval.first; j <= interval.last; j++)
+                    pTable->replyMajors[j >> 3] |= 1 << (j & 7);
+            }
+        }
+    }
+    pTable->serial = recordTableSerial;
+    return pTable;
+}                               /* RecordClientTable */
+
+/* RecordFreeClientTable
+ *
+ * Arguments:
+ *	pClient is a client that is going away.
+ *
+ * Returns: nothing.
+ *
+ * Side Effects:
+ *	Frees the client's dispatch table storage.
+ */
+static void
+RecordFreeClientTable(ClientPtr pClient)
+{
+    RecordClientTablePtr pTable;
+
+    pTable = dixGetPrivateAddr(&pClient->devPrivates, RecordClientTableKey);
+    free(pTable->ppRCAP);
+    memset(pTable, 0, sizeof(RecordClientTableRec));
+}                               /* RecordFreeClientTable */
+
 /* RecordABigRequest
  *
  * Arguments:
@@ -501,6 +609,7 @@ RecordARequest(ClientPtr client)
 {
     RecordContextPtr pContext;
     RecordClientsAndProtocolPtr pRCAP;
+    RecordClientTablePtr pTable;
     int i;
     RecordClientPrivatePtr pClientPriv;
 
@@ -508,10 +617,11 @@ RecordARequest(ClientPtr client)
     int majorop;
 
     majorop = stuff->reqType;
-    for (i = 0; i < numEnabledContexts; i++) {
-        pContext = ppAllContexts[i];
-        pRCAP = RecordFindClientOnContext(pContext, client->clientAsMask, NULL);
-        if (pRCAP && pRCAP->pRequestMajorOpSet &&
+    pTable = RecordClientTable(client);
+    for (i = 0; i < pTable->numRCAPs; i++) {
+        pRCAP = pTable->ppRCAP[i];
+        pContext = pRCAP->pContext;
+        if (pRCAP->pRequestMajorOpSet &&
             RecordIsMemberOfSet(pRCAP->pRequestMajorOpSet, majorop)) {
             if (majorop <= 127) {       /* core request */
 
@@ -549,7 +659,7 @@ RecordARequest(ClientPtr client)
                 }               /* end for each minor op info */
             }                   /* end extension request */
         }                       /* end this RCAP wants this major opcode */
-    }                           /* end for each context */
+    }                           /* end for each RCAP recording this client */
     pClientPriv = RecordClientPrivate(client);
     assert(pClientPriv);
     return (*pClientPriv->originalVector[majorop]) (client);
@@ -579,63 +689,67 @@ RecordAReply(CallbackListPtr *pcbl, void *nulldata, void *calldata)
 {
     RecordContextPtr pContext;
     RecordClientsAndProtocolPtr pRCAP;
-    int eci;
+    RecordClientTablePtr pTable;
+    int i;
     ReplyInfoRec *pri = (ReplyInfoRec *) calldata;
     ClientPtr client = pri->client;
+    int majorop = client->majorOp;
 
-    for (eci = 0; eci < numEnabledContexts; eci++) {
-        pContext = ppAllContexts[eci];
-        pRCAP = RecordFindClientOnContext(pContext, client->clientAsMask, NULL);
-        if (pRCAP) {
-            int majorop = client->majorOp;
+    pTable = RecordClientTable(client);
+    /* continued replies follow their start, which was recorded or not */
+    if (pri->startOfReply &&
+        !RecordTableHasMajor(pTable->replyMajors, majorop))
+        return;
 
-            if (pContext->continuedReply) {
+    for (i = 0; i < pTable->numRCAPs; i++) {
+        pRCAP = pTable->ppRCAP[i];
+        pContext = pRCAP->pContext;
+        if (pContext->continuedReply) {
+            RecordAProtocolElement(pContext, client, XRecordFromServer,
+                                   (void *) pri->replyData,
+                                   pri->dataLenBytes, pri->padBytes,
+                                   /* continuation */ -1);
+            if (!pri->bytesRemaining)
+                pContext->continuedReply = 0;
+        }
+        else if (pri->startOfReply && pRCAP->pReplyMajorOpSet &&
+                 RecordIsMemberOfSet(pRCAP->pReplyMajorOpSet, majorop)) {
+            if (majorop <= 127) {   /* core reply */
                 RecordAProtocolElement(pContext, client, XRecordFromServer,
                                        (void *) pri->replyData,
-                                       pri->dataLenBytes, pri->padBytes,
-                                       /* continuation */ -1);
-                if (!pri->bytesRemaining)
-                    pContext->continuedReply = 0;
+                                       pri->dataLenBytes, 0,
+                                       pri->bytesRemaining);
+                if (pri->bytesRemaining)
+                    pContext->continuedReply = 1;
             }
-            else if (pri->startOfReply && pRCAP->pReplyMajorOpSet &&
-                     RecordIsMemberOfSet(pRCAP->pReplyMajorOpSet, majorop)) {
-                if (majorop <= 127) {   /* core reply */
-                    RecordAProtocolElement(pContext, client, XRecordFromServer,
-                                           (void *) pri->replyData,
-                                           pri->dataLenBytes, 0,
-                                           pri->bytesRemaining);
-                    if (pri->bytesRemaining)
-                        pContext->continuedReply = 1;
-                }
-                else {          /* extension, check minor opcode */
-
-                    int minorop = client->minorOp;
-                    int numMinOpInfo;
-                    RecordMinorOpPtr pMinorOpInfo = pRCAP->pReplyMinOpInfo;
-
-                    assert(pMinorOpInfo);
-                    numMinOpInfo = pMinorOpInfo->count;
-                    pMinorOpInfo++;
-                    assert(numMinOpInfo);
-                    for (; numMinOpInfo; numMinOpInfo--, pMinorOpInfo++) {
-                        if (majorop >= pMinorOpInfo->major.first &&
-                            majorop <= pMinorOpInfo->major.last &&
-                            RecordIsMemberOfSet(pMinorOpInfo->major.pMinOpSet,
-                                                minorop)) {
-                            RecordAProtocolElement(pContext, client,
-                                                   XRecordFromServer,
-                                                   (void *) pri->replyData,
-                                                   pri->dataLenBytes, 0,
-                                                   pri->bytesRemaining);
-                            if (pri->bytesRemaining)
-                                pContext->continuedReply = 1;
-                            break;
-                        }
-                    }           /* end for each minor op info */
-                }               /* end extension reply */
-            }                   /* end continued reply vs. start of reply */
-        }                       /* end client is registered on this context */
-    }                           /* end for each context */
+            else {          /* extension, check minor opcode */
+
+                int minorop = client->minorOp;
+                int numMinOpInfo;
+                RecordMinorOpPtr pMinorOpInfo = pRCAP->pReplyMinOpInfo;
+
+                assert(pMinorOpInfo);
+                numMinOpInfo = pMinorOpInfo->count;
+                pMinorOpInfo++;
+                assert(numMinOpInfo);
+                for (; numMinOpInfo; numMinOpInfo--, pMinorOpInfo++) {
+                    if (majorop >= pMinorOpInfo->major.first &&
+                        majorop <= pMinorOpInfo->major.last &&
+                        RecordIsMemberOfSet(pMinorOpInfo->major.pMinOpSet,
+                                            minorop)) {
+                        RecordAProtocolElement(pContext, client,
+                                               XRecordFromServer,
+                                               (void *) pri->replyData,
+                                               pri->dataLenBytes, 0,
+                                               pri->bytesRemaining);
+                        if (pri->bytesRemaining)
+                            pContext->continuedReply = 1;
+                        break;
+                    }
+                }           /* end for each minor op info */
+            }               /* end extension reply */
+        }                   /* end continued reply vs. start of reply */
+    }                           /* end for each RCAP recording this client */
 }                               /* RecordAReply */
 
 /* RecordADeliveredEventOrError
@@ -660,14 +774,15 @@ RecordADeliveredEventOrError(CallbackListPtr *pcbl, void *nulldata,
     EventInfoRec *pei = (EventInfoRec *) calldata;
     RecordContextPtr pContext;
     RecordClientsAndProtocolPtr pRCAP;
-    int eci;                    /* enabled context index */
+    RecordClientTablePtr pTable;
+    int i;
     ClientPtr pClient = pei->client;
 
-    for (eci = 0; eci < numEnabledContexts; eci++) {
-        pContext = ppAllContexts[eci];
-        pRCAP = RecordFindClientOnContext(pContext, pClient->clientAsMask,
-                                          NULL);
-        if (pRCAP && (pRCAP->pDeliveredEventSet || pRCAP->pErrorSet)) {
+    pTable = RecordClientTable(pClient);
+    for (i = 0; i < pTable->numRCAPs; i++) {
+        pRCAP = pTable->ppRCAP[i];
+        pContext = pRCAP->pContext;
+        if (pRCAP->pDeliveredEventSet || pRCAP->pErrorSet) {
             int ev;             /* event index */
             xEvent *pev = pei->events;
 
@@ -698,8 +813,8 @@ RecordADeliveredEventOrError(CallbackListPtr *pcbl, void *nulldata,
                                            SIZEOF(xEvent), 0, 0);
                 }
             }                   /* end for each event */
-        }                       /* end this client is on this context */
-    }                           /* end for each enabled context */
+        }                       /* end this RCAP records events or errors */
+    }                           /* end for each RCAP recording this client */
 }                               /* RecordADeliveredEventOrError */
 
 static void
@@ -853,6 +968,8 @@ RecordInstallHooks(RecordClientsAndProtocolPtr pRCAP, XID oneclient)
     int i = 0;
     XID client;
 
+    RecordInvalidateClientTables();
+
     if (oneclient)
         client = oneclient;
     else
@@ -938,6 +1055,8 @@ RecordUninstallHooks(RecordClientsAndProtocolPtr pRCAP, XID oneclient)
     int i = 0;
     XID client;
 
+    RecordInvalidateClientTables();
+
     if (oneclient)
         client = oneclient;
     else
@@ -2332,6 +2451,7 @@ ProcRecordEnableContext(ClientPtr client)
 
     ++numEnabledContexts;
     assert(numEnabledContexts > 0);
+    RecordInvalidateClientTables();
 
     /* send StartOfData */
     RecordAProtocolElement(pContext, NULL, XRecordStartOfData, NULL, 0, 0, 0);
@@ -2387,6 +2507,7 @@ RecordDisableContext(RecordContextPtr pContext)
     }
     --numEnabledContexts;
     assert(numEnabledContexts >= 0);
+    RecordInvalidateClientTables();
 }                               /* RecordDisableContext */
 
 static int
@@ -2756,6 +2877,7 @@ RecordAClientStateChange(CallbackListPtr *pcbl, void *nulldata,
         }
 
         free(ppAllContextsCopy);
+        RecordFreeClientTable(pClient);
         break;
 
     default:
@@ -2801,6 +2923,10 @@ RecordExtensionInit(void)
     if (!dixRegisterPrivateKey(RecordClientPrivateKey, PRIVATE_CLIENT, 0))
         return;
 
+    if (!dixRegisterPrivateKey(RecordClientTableKey, PRIVATE_CLIENT,
+                               sizeof(RecordClientTableRec)))
+        return;
+
     ppAllContexts = NULL;
     numContexts = numEnabledContexts = numEnabledRCAPs = 0;
 
@@ -82,6 +82,8 @@ static GlyphHashSetRec glyphHashSets[] = {
 
 static GlyphHashRec globalGlyphs[GlyphFormatNum];
 
+static const int glyphDepths[GlyphFormatNum] = { 1, 4, 8, 16, 32 };
+
 void
 GlyphUninit(ScreenPtr pScreen)
 {
@@ -117,9 +119,21 @@ FindGlyphHashSet(CARD32 filled)
     return 0;
 }
 
-GlyphRefPtr
-FindGlyphRef(GlyphHashPtr hash,
-             CARD32 signature, Bool match, unsigned char sha1[20])
+/*
+ * The digest alone is not trusted to identify a glyph, so entries of the
+ * global tables also have to match the glyph metrics and bitmap when the
+ * caller has them.
+ */
+static Bool
+GlyphBitsMatch(GlyphPtr glyph, xGlyphInfo * gi, CARD8 *bits)
+{
+    return memcmp(&glyph->info, gi, sizeof(xGlyphInfo)) == 0 &&
+        memcmp(glyph->bits, bits, glyph->size - sizeof(xGlyphInfo)) == 0;
+}
+
+static GlyphRefPtr
+LookupGlyphRef(GlyphHashPtr hash, CARD32 signature, Bool match,
+               unsigned char sha1[20], xGlyphInfo * gi, CARD8 *bits)
 {
     CARD32 elt, step, s;
     GlyphPtr glyph;
@@ -146,7 +160,8 @@ FindGlyphRef(GlyphHashPtr hash,
                 break;
         }
         else if (s == signature &&
-                 (!match || memcmp(glyph->sha1, sha1, 20) == 0)) {
+                 (!match || (memcmp(glyph->sha1, sha1, 20) == 0 &&
+                             (!gi || GlyphBitsMatch(glyph, gi, bits))))) {
             break;
         }
         if (!step) {
@@ -161,9 +176,124 @@ FindGlyphRef(GlyphHashPtr hash,
     return gr;
 }
 
+GlyphRefPtr
+FindGlyphRef(GlyphHashPtr hash,
+             CARD32 signature, Bool match, unsigned char sha1[20])
+{
+    return LookupGlyphRef(hash, signature, match, sha1, NULL, NULL);
+}
+
+/* Find the slot for glyph itself in a global table */
+static GlyphRefPtr
+FindGlobalGlyphRef(int format, GlyphPtr glyph)
+{
+    return LookupGlyphRef(&globalGlyphs[format], *(CARD32 *) glyph->sha1,
+                          TRUE, glyph->sha1, &glyph->info, glyph->bits);
+}
+
+/*
+ * Glyph digests only find duplicates, which are then confirmed by
+ * comparing the bitmaps, so they don't need a cryptographic hash.  This
+ * one runs two 64-bit multiply-rotate lanes over the data and needs no
+ * allocation; the 20 byte digest is the two finalised lanes followed by
+ * the data length.
+ */
+#define GLYPH_HASH_P1	0x9E3779B185EBCA87ULL
+#define GLYPH_HASH_P2	0xC2B2AE3D27D4EB4FULL
+#define GLYPH_HASH_P3	0x165667B19E3779F9ULL
+
+typedef struct _GlyphHashContext {
+    uint64_t a, b;
+    uint64_t len;
+    unsigned char tail[16];
+    int ntail;
+} GlyphHashContextRec;
+
+static inline uint64_t
+GlyphHashRound(uint64_t acc, const unsigned char *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    acc += v * GLYPH_HASH_P2;
+    acc = (acc << 31) | (acc >> 33);
+    return acc * GLYPH_HASH_P1;
+}
+
+static inline uint64_t
+GlyphHashMix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static void
+GlyphHashUpdate(GlyphHashContextRec * ctx, const void *data, unsigned long size)
+{
+    const unsigned char *p = data;
+
+    ctx->len += size;
+    if (ctx->ntail) {
+        unsigned long n = min(size, 16 - ctx->ntail);
+
+        memcpy(ctx->tail + ctx->ntail, p, n);
+        ctx->ntail += n;
+        p += n;
+        size -= n;
+        if (ctx->ntail < 16)
+            return;
+        ctx->a = GlyphHashRound(ctx->a, ctx->tail);
+        ctx->b = GlyphHashRound(ctx->b, ctx->tail + 8);
+        ctx->ntail = 0;
+    }
+    for (; size >= 16; p += 16, size -= 16) {
+        ctx->a = GlyphHashRound(ctx->a, p);
+        ctx->b = GlyphHashRound(ctx->b, p + 8);
+    }
+    memcpy(ctx->tail, p, size);
+    ctx->ntail = size;
+}
+
+static void
+GlyphHashFinal(GlyphHashContextRec * ctx, unsigned char digest[20])
+{
+    uint64_t h1, h2;
+    CARD32 len = ctx->len;
+
+    memset(ctx->tail + ctx->ntail, 0, 16 - ctx->ntail);
+    h1 = GlyphHashRound(ctx->a ^ ctx->len, ctx->tail);
+    h2 = GlyphHashRound(ctx->b + GLYPH_HASH_P3, ctx->tail + 8);
+    h1 = GlyphHashMix(h1 + h2);
+    h2 = GlyphHashMix(h2 ^ (h1 * GLYPH_HASH_P3));
+    memcpy(digest, &h1, 8);
+    memcpy(digest + 8, &h2, 8);
+    memcpy(digest + 16, &len, 4);
+}
+
 int
 HashGlyph(xGlyphInfo * gi,
           CARD8 *bits, unsigned long size, unsigned char sha1[20])
+{
+    GlyphHashContextRec ctx;
+
+    ctx.a = GLYPH_HASH_P1 + GLYPH_HASH_P2;
+    ctx.b = GLYPH_HASH_P2;
+    ctx.len = 0;
+    ctx.ntail = 0;
+    GlyphHashUpdate(&ctx, gi, sizeof(xGlyphInfo));
+    GlyphHashUpdate(&ctx, bits, size);
+    GlyphHashFinal(&ctx, sha1);
+    return Success;
+}
+
+/* The SHA-1 digest HashGlyph used to compute, for comparison */
+int
+HashGlyphSHA1(xGlyphInfo * gi,
+              CARD8 *bits, unsigned long size, unsigned char sha1[20])
 {
     void *ctx = x_sha1_init();
     int success;
@@ -200,6 +330,33 @@ FindGlyphByHash(unsigned char sha1[20], int format)
         return NULL;
 }
 
+/* Find a glyph with this digest whose metrics and bitmap also match */
+GlyphPtr
+FindGlyphByBits(unsigned char sha1[20], int format,
+                xGlyphInfo * gi, CARD8 *bits)
+{
+    GlyphRefPtr gr;
+
+    if (!globalGlyphs[format].hashSet)
+        return NULL;
+
+    gr = LookupGlyphRef(&globalGlyphs[format], *(CARD32 *) sha1,
+                        TRUE, sha1, gi, bits);
+
+    if (gr->glyph && gr->glyph != DeletedGlyph)
+        return gr->glyph;
+    else
+        return NULL;
+}
+
+/* Size of the bitmap AddGlyphs sends for a glyph of this format */
+unsigned long
+GlyphBitsSize(xGlyphInfo * gi, int format)
+{
+    return (unsigned long) gi->height *
+        PixmapBytePad(gi->width, glyphDepths[format]);
+}
+
 #ifdef CHECK_DUPLICATES
 void
 DuplicateRef(GlyphPtr glyph, char *where)
@@ -253,7 +410,6 @@ FreeGlyph(GlyphPtr glyph, int format)
         GlyphRefPtr gr;
         int i;
         int first;
-        CARD32 signature;
 
         first = -1;
         for (i = 0; i < globalGlyphs[format].hashSet->size; i++)
@@ -263,8 +419,7 @@ FreeGlyph(GlyphPtr glyph, int format)
                 first = i;
             }
 
-        signature = *(CARD32 *) glyph->sha1;
-        gr = FindGlyphRef(&globalGlyphs[format], signature, TRUE, glyph->sha1);
+        gr = FindGlobalGlyphRef(format, glyph);
         if (gr - globalGlyphs[format].table != first)
             DuplicateRef(glyph, "Found wrong one");
         if (gr->glyph && gr->glyph != DeletedGlyph) {
@@ -287,8 +442,7 @@ AddGlyph(GlyphSetPtr glyphSet, GlyphPtr glyph, Glyph id)
     CheckDuplicates(&globalGlyphs[glyphSet->fdepth], "AddGlyph top global");
     /* Locate existing matching glyph */
     signature = *(CARD32 *) glyph->sha1;
-    gr = FindGlyphRef(&globalGlyphs[glyphSet->fdepth], signature,
-                      TRUE, glyph->sha1);
+    gr = FindGlobalGlyphRef(glyphSet->fdepth, glyph);
     if (gr->glyph && gr->glyph != DeletedGlyph && gr->glyph != glyph) {
         FreeGlyphPicture(glyph);
         dixFreeObjectWithPrivates(glyph, PRIVATE_GLYPH);
@@ -351,12 +505,13 @@ AllocateGlyph(xGlyphInfo * gi, int fdepth)
 
     head_size = sizeof(GlyphRec) + screenInfo.numScreens * sizeof(PicturePtr);
     size = (head_size + dixPrivatesSize(PRIVATE_GLYPH));
-    glyph = (GlyphPtr) malloc(size);
+    glyph = (GlyphPtr) malloc(size + GlyphBitsSize(gi, fdepth));
     if (!glyph)
         return 0;
     glyph->refcnt = 0;
-    glyph->size = size + sizeof(xGlyphInfo);
+    glyph->size = sizeof(xGlyphInfo) + GlyphBitsSize(gi, fdepth);
     glyph->info = *gi;
+    glyph->bits = (CARD8 *) glyph + size;
     dixInitPrivates(glyph, (char *) glyph + head_size, PRIVATE_GLYPH);
 
     for (i = 0; i < screenInfo.numScreens; i++) {
@@ -420,7 +575,11 @@ ResizeGlyphHash(GlyphHashPtr hash, CARD32 change, Bool global)
             glyph = hash->table[i].glyph;
             if (glyph && glyph != DeletedGlyph) {
                 s = hash->table[i].signature;
-                gr = FindGlyphRef(&newHash, s, global, glyph->sha1);
+                if (global)
+                    gr = LookupGlyphRef(&newHash, s, TRUE, glyph->sha1,
+                                        &glyph->info, glyph->bits);
+                else
+                    gr = FindGlyphRef(&newHash, s, FALSE, NULL);
 
                 gr->signature = s;
                 gr->glyph = glyph;
@@ -42,9 +42,10 @@
 typedef struct _Glyph {
     CARD32 refcnt;
     PrivateRec *devPrivates;
-    unsigned char sha1[20];
+    unsigned char sha1[20];     /* HashGlyph digest, not necessarily SHA-1 */
     CARD32 size;                /* info + bitmap */
     xGlyphInfo info;
+    CARD8 *bits;                /* copy of the bitmap, checked on dedup */
     /* per-screen pixmaps follow */
 } GlyphRec, *GlyphPtr;
 
@@ -101,11 +102,23 @@ FindGlyphRef(GlyphHashPtr hash,
 
 extern _X_EXPORT GlyphPtr FindGlyphByHash(unsigned char sha1[20], int format);
 
+extern _X_EXPORT GlyphPtr
+FindGlyphByBits(unsigned char sha1[20], int format,
+                xGlyphInfo * gi, CARD8 *bits);
+
 extern _X_EXPORT int
 
 HashGlyph(xGlyphInfo * gi,
           CARD8 *bits, unsigned long size, unsigned char sha1[20]);
 
+extern _X_EXPORT int
+
+HashGlyphSHA1(xGlyphInfo * gi,
+              CARD8 *bits, unsigned long size, unsigned char sha1[20]);
+
+extern _X_EXPORT unsigned long
+GlyphBitsSize(xGlyphInfo * gi, int format);
+
 extern _X_EXPORT void
  FreeGlyph(GlyphPtr glyph, int format);
 
@@ -1085,7 +1085,8 @@ ProcRenderAddGlyphs(ClientPtr client)
         if (err)
             goto bail;
 
-        glyph_new->glyph = FindGlyphByHash(glyph_new->sha1, glyphSet->fdepth);
+        glyph_new->glyph = FindGlyphByBits(glyph_new->sha1, glyphSet->fdepth,
+                                           &gi[i], bits);
 
         if (glyph_new->glyph && glyph_new->glyph != DeletedGlyph) {
             glyph_new->found = TRUE;
@@ -1164,6 +1165,7 @@ ProcRenderAddGlyphs(ClientPtr client)
             }
 
             memcpy(glyph_new->glyph->sha1, glyph_new->sha1, 20);
+            memcpy(glyph_new->glyph->bits, bits, size);
         }
 
         glyph_new->id = gids[i];
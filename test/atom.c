@@ -0,0 +1,183 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xatom.h>
+#include "misc.h"
+#include "dix.h"
+#include "os.h"
+#include "tests-common.h"
+
+#define CHECK_ATOMS 5000
+#define BENCH_ATOMS 100000
+
+/**
+ * Predefined atoms are interned at InitAtoms time and must keep their
+ * protocol-assigned values.
+ */
+static void
+atom_predefined(void)
+{
+    InitAtoms();
+
+    assert(MakeAtom("PRIMARY", strlen("PRIMARY"), FALSE) == XA_PRIMARY);
+    assert(MakeAtom("WM_TRANSIENT_FOR", strlen("WM_TRANSIENT_FOR"), FALSE) ==
+           XA_WM_TRANSIENT_FOR);
+    assert(strcmp(NameForAtom(XA_STRING), "STRING") == 0);
+    assert(ValidAtom(XA_LAST_PREDEFINED));
+    assert(!ValidAtom(XA_LAST_PREDEFINED + 1));
+    assert(NameForAtom(None) == NULL);
+    assert(NameForAtom(XA_LAST_PREDEFINED + 1) == NULL);
+}
+
+/**
+ * Lookups must compare the given length only, not rely on NUL
+ * termination, and must distinguish strings that are prefixes of each
+ * other.
+ */
+static void
+atom_lookup(void)
+{
+    const char *buf = "_NET_WM_NAME_EXTRA";
+    Atom a, b, c;
+
+    InitAtoms();
+
+    assert(MakeAtom("_NET_WM_NAME", 12, FALSE) == None);
+    a = MakeAtom(buf, 12, TRUE);
+    assert(a > XA_LAST_PREDEFINED);
+    assert(strcmp(NameForAtom(a), "_NET_WM_NAME") == 0);
+    assert(MakeAtom("_NET_WM_NAME", 12, FALSE) == a);
+    assert(MakeAtom("_NET_WM_NAME", 12, TRUE) == a);
+
+    b = MakeAtom(buf, 7, TRUE);
+    assert(b != a);
+    assert(strcmp(NameForAtom(b), "_NET_WM") == 0);
+
+    c = MakeAtom("", 0, TRUE);
+    assert(c != a && c != b);
+    assert(strcmp(NameForAtom(c), "") == 0);
+    assert(MakeAtom("", 0, FALSE) == c);
+}
+
+/**
+ * A client may send a name with an embedded NUL. Interning it again must
+ * find the same atom without reading past the stored copy, and it must
+ * stay distinct from the name up to the NUL.
+ */
+static void
+atom_embedded_nul(void)
+{
+    const char name[] = "_EMBEDDED\0NUL";
+    unsigned len = sizeof(name) - 1;
+    char *copy;
+    Atom a, b;
+
+    InitAtoms();
+
+    /* a heap copy, so an over-read is caught by a memory checker */
+    copy = malloc(len);
+    assert(copy);
+    memcpy(copy, name, len);
+
+    a = MakeAtom(copy, len, TRUE);
+    assert(a > XA_LAST_PREDEFINED);
+    assert(MakeAtom(copy, len, TRUE) == a);
+    assert(MakeAtom(name, len, FALSE) == a);
+    assert(strcmp(NameForAtom(a), "_EMBEDDED") == 0);
+
+    b = MakeAtom("_EMBEDDED", strlen("_EMBEDDED"), TRUE);
+    assert(b != a);
+    assert(MakeAtom(copy, len, FALSE) == a);
+
+    free(copy);
+    FreeAllAtoms();
+}
+
+/**
+ * Intern enough atoms to force several table resizes and check each maps
+ * back to its own name.  With report set, also print how long interning
+ * and looking them up took.
+ */
+static void
+atom_many(int count, Bool report)
+{
+    char name[32];
+    CARD64 start, made, found;
+    Atom first = None;
+    int i;
+
+    InitAtoms();
+
+    start = GetTimeInMicros();
+    for (i = 0; i < count; i++) {
+        Atom a;
+
+        snprintf(name, sizeof(name), "_TEST_ATOM_%d", i);
+        a = MakeAtom(name, strlen(name), TRUE);
+        assert(a == XA_LAST_PREDEFINED + 1 + i);
+        if (i == 0)
+            first = a;
+    }
+    made = GetTimeInMicros();
+
+    for (i = 0; i < count; i++) {
+        snprintf(name, sizeof(name), "_TEST_ATOM_%d", i);
+        assert(MakeAtom(name, strlen(name), FALSE) == first + i);
+    }
+    found = GetTimeInMicros();
+
+    for (i = 0; i < count; i++) {
+        snprintf(name, sizeof(name), "_TEST_ATOM_%d", i);
+        assert(strcmp(NameForAtom(first + i), name) == 0);
+    }
+
+    if (report)
+        printf("%d atoms: interned in %llu us, looked up in %llu us\n",
+               count, (unsigned long long) (made - start),
+               (unsigned long long) (found - made));
+
+    FreeAllAtoms();
+    assert(!ValidAtom(first));
+}
+
+int
+main(int argc, char **argv)
+{
+    atom_predefined();
+    atom_lookup();
+    atom_embedded_nul();
+    atom_many(CHECK_ATOMS, FALSE);
+
+    if (run_benchmarks(argc, argv))
+        atom_many(BENCH_ATOMS, TRUE);
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE
+ *  OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "misc.h"
+#include "scrnintstr.h"
+#include "regionstr.h"
+#include "privates.h"
+#include "damage.h"
+#include "tests-common.h"
+
+/* glyph cells along text lines, one pixel apart so none merge */
+#define CELLS_PER_ROW 40
+
+static ScreenRec screen;
+static int reports;
+static RegionRec reported;
+
+static void
+damage_report(DamagePtr pDamage, RegionPtr pRegion, void *closure)
+{
+    reports++;
+    RegionCopy(&reported, pRegion);
+}
+
+static void
+damage_init(void)
+{
+    test_screen_init(&screen);
+    assert(DamageSetup(&screen));
+    RegionNull(&reported);
+}
+
+static void
+cell_box(BoxPtr box, int i)
+{
+    box->x1 = (i % CELLS_PER_ROW) * 8;
+    box->y1 = (i / CELLS_PER_ROW) * 16;
+    box->x2 = box->x1 + 7;
+    box->y2 = box->y1 + 15;
+}
+
+/* report cells first..first+n-1 as one op each, and add them to exact */
+static void
+damage_cells(DamagePtr pDamage, RegionPtr exact, int first, int n)
+{
+    RegionRec op;
+    BoxRec box;
+    int i;
+
+    for (i = first; i < first + n; i++) {
+        cell_box(&box, i);
+        RegionInit(&op, &box, 1);
+        DamageReportDamage(pDamage, &op);
+        RegionUnion(exact, exact, &op);
+        RegionUninit(&op);
+    }
+}
+
+static DamagePtr
+damage_create(DamageReportLevel level, int maxBoxes)
+{
+    DamagePtr pDamage;
+
+    pDamage = DamageCreate(damage_report, NULL, level, TRUE, &screen, NULL);
+    assert(pDamage);
+    DamageSetBatching(pDamage, maxBoxes);
+    reports = 0;
+    return pDamage;
+}
+
+/**
+ * Below the limit a batched damage ends up with exactly the region
+ * unbatched damage would have, and raw reports still come per op.
+ */
+static void
+damage_batch_exact(void)
+{
+    DamagePtr pDamage = damage_create(DamageReportRawRegion,
+                                      DAMAGE_BATCH_LIMIT);
+    RegionRec exact, row;
+    BoxRec box;
+
+    RegionNull(&exact);
+    damage_cells(pDamage, &exact, 0, 100);
+    assert(reports == 100);
+    cell_box(&box, 99);
+    assert(RegionNumRects(&reported) == 1);
+    assert(memcmp(RegionExtents(&reported), &box, sizeof(box)) == 0);
+    assert(RegionEqual(DamageRegion(pDamage), &exact));
+
+    /* the first row is repainted */
+    box.x1 = 0;
+    box.y1 = 0;
+    box.x2 = CELLS_PER_ROW * 8;
+    box.y2 = 16;
+    RegionInit(&row, &box, 1);
+    damage_cells(pDamage, &exact, 100, 10);
+    assert(DamageSubtract(pDamage, &row));
+    RegionSubtract(&exact, &exact, &row);
+    assert(RegionEqual(DamageRegion(pDamage), &exact));
+
+    DamageEmpty(pDamage);
+    damage_cells(pDamage, &exact, 0, 1);
+    DamageEmpty(pDamage);
+    assert(!RegionNotEmpty(DamageRegion(pDamage)));
+
+    RegionUninit(&row);
+    RegionUninit(&exact);
+    DamageDestroy(pDamage);
+}
+
+/**
+ * However many ops come in, the region never has more boxes than the
+ * limit and still covers everything that was drawn.
+ */
+static void
+damage_batch_bounded(void)
+{
+    DamagePtr pDamage = damage_create(DamageReportNonEmpty, 16);
+    RegionRec exact, missed;
+    RegionPtr pRegion;
+    int i;
+
+    RegionNull(&exact);
+    RegionNull(&missed);
+    for (i = 0; i < 400; i += 20) {
+        damage_cells(pDamage, &exact, i, 20);
+        pRegion = DamageRegion(pDamage);
+        assert(RegionNumRects(pRegion) <= 16);
+        RegionSubtract(&missed, &exact, pRegion);
+        assert(!RegionNotEmpty(&missed));
+        assert(memcmp(RegionExtents(pRegion), RegionExtents(&exact),
+                      sizeof(BoxRec)) == 0);
+    }
+    /* only the first op found the damage empty */
+    assert(reports == 1);
+
+    RegionUninit(&missed);
+    RegionUninit(&exact);
+    DamageDestroy(pDamage);
+}
+
+/**
+ * Delta damage still reports only what was not damaged before.
+ */
+static void
+damage_batch_delta(void)
+{
+    DamagePtr pDamage = damage_create(DamageReportDeltaRegion,
+                                      DAMAGE_BATCH_LIMIT);
+    RegionRec exact;
+
+    RegionNull(&exact);
+    damage_cells(pDamage, &exact, 0, 50);
+    assert(reports == 50);
+    damage_cells(pDamage, &exact, 25, 50);
+    assert(reports == 75);
+    assert(RegionEqual(DamageRegion(pDamage), &exact));
+
+    RegionUninit(&exact);
+    DamageDestroy(pDamage);
+}
+
+/**
+ * Turning batching off merges what is pending and goes back to exact
+ * regions of any size.
+ */
+static void
+damage_batch_off(void)
+{
+    DamagePtr pDamage = damage_create(DamageReportNone, 16);
+    RegionRec exact;
+
+    RegionNull(&exact);
+    damage_cells(pDamage, &exact, 0, 10);
+    DamageSetBatching(pDamage, 0);
+    assert(RegionEqual(DamageRegion(pDamage), &exact));
+    damage_cells(pDamage, &exact, 10, 390);
+    assert(RegionNumRects(DamageRegion(pDamage)) == 400);
+    assert(RegionEqual(DamageRegion(pDamage), &exact));
+
+    RegionUninit(&exact);
+    DamageDestroy(pDamage);
+}
+
+int
+main(int argc, char **argv)
+{
+    InitRegions();
+    dixResetPrivates();
+    damage_init();
+
+    damage_batch_exact();
+    damage_batch_bounded();
+    damage_batch_delta();
+    damage_batch_off();
+
+    RegionUninit(&reported);
+    return 0;
+}
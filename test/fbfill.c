@@ -0,0 +1,250 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE
+ *  OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "misc.h"
+#include "scrnintstr.h"
+#include "gcstruct.h"
+#include "privates.h"
+#include "fb.h"
+#include "tests-common.h"
+
+#define WIDTH   512
+#define HEIGHT  384
+
+#define NRECTS  500
+#define BENCH_REQUESTS 2000
+
+static ScreenRec screen;
+
+static void
+fbfill_init(void)
+{
+    test_screen_init(&screen);
+    assert(fbAllocatePrivates(&screen));
+}
+
+static PixmapPtr
+make_pixmap(void)
+{
+    PixmapPtr pixmap = test_pixmap_create(&screen, WIDTH, HEIGHT, 24, 32);
+
+    assert(pixmap);
+    return pixmap;
+}
+
+/* what fbValidateGC would set up for a solid fill */
+static GCPtr
+make_gc(int alu, CARD32 pixel, RegionPtr clip)
+{
+    GCPtr gc = dixAllocateScreenObjectWithPrivates(&screen, GC, PRIVATE_GC);
+    FbGCPrivPtr priv;
+
+    assert(gc);
+    gc->pScreen = &screen;
+    gc->depth = 24;
+    gc->alu = alu;
+    gc->planemask = FB_ALLONES;
+    gc->fgPixel = pixel;
+    gc->fillStyle = FillSolid;
+    gc->pCompositeClip = clip;
+
+    priv = fbGetGCPrivate(gc);
+    priv->and = fbAnd(alu, pixel, FB_ALLONES);
+    priv->xor = fbXor(alu, pixel, FB_ALLONES);
+    priv->bpp = 32;
+    return gc;
+}
+
+static void
+free_gc(GCPtr gc)
+{
+    dixFreeObjectWithPrivates(gc, PRIVATE_GC);
+}
+
+/* a grid of clip boxes with gaps between them */
+static RegionPtr
+make_clip(int cols, int rows)
+{
+    xRectangle rects[64];
+    int i, n = 0;
+
+    assert(cols * rows <= 64);
+    for (i = 0; i < cols * rows; i++) {
+        rects[n].x = (i % cols) * WIDTH / cols;
+        rects[n].y = (i / cols) * HEIGHT / rows;
+        rects[n].width = WIDTH / cols - 3;
+        rects[n].height = HEIGHT / rows - 2;
+        n++;
+    }
+    return RegionFromRects(n, rects, CT_UNSORTED);
+}
+
+/* terminal-sized cells, some of them overlapping or off the edges */
+static void
+make_rects(xRectangle *rects, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        rects[i].x = (rand() % (WIDTH + 16)) - 8;
+        rects[i].y = (rand() % (HEIGHT + 16)) - 8;
+        rects[i].width = 1 + rand() % 12;
+        rects[i].height = 1 + rand() % 18;
+    }
+}
+
+/**
+ * The fill before the batched solid path: every rectangle is clipped
+ * against every clip box and filled on its own.
+ */
+static void
+per_box_fill(DrawablePtr drawable, GCPtr gc, int nrect, xRectangle *prect)
+{
+    RegionPtr clip = fbGetCompositeClip(gc);
+    BoxPtr pbox;
+    int x1, y1, x2, y2;
+    int n;
+
+    while (nrect--) {
+        pbox = RegionRects(clip);
+        for (n = RegionNumRects(clip); n--; pbox++) {
+            x1 = max(prect->x + drawable->x, pbox->x1);
+            y1 = max(prect->y + drawable->y, pbox->y1);
+            x2 = min(prect->x + drawable->x + (int) prect->width, pbox->x2);
+            y2 = min(prect->y + drawable->y + (int) prect->height, pbox->y2);
+            if (x1 < x2 && y1 < y2)
+                fbFill(drawable, gc, x1, y1, x2 - x1, y2 - y1);
+        }
+        prect++;
+    }
+}
+
+static void
+compare_fills(int alu, RegionPtr clip)
+{
+    PixmapPtr expect = make_pixmap();
+    PixmapPtr got = make_pixmap();
+    GCPtr gc = make_gc(alu, 0x00123456, clip);
+    xRectangle rects[NRECTS];
+
+    make_rects(rects, NRECTS);
+    per_box_fill(&expect->drawable, gc, NRECTS, rects);
+    fbPolyFillRect(&got->drawable, gc, NRECTS, rects);
+    assert(memcmp(expect->devPrivate.ptr, got->devPrivate.ptr,
+                  WIDTH * HEIGHT * 4) == 0);
+
+    /* too few rectangles for the sweep */
+    per_box_fill(&expect->drawable, gc, 3, rects);
+    fbPolyFillRect(&got->drawable, gc, 3, rects);
+    assert(memcmp(expect->devPrivate.ptr, got->devPrivate.ptr,
+                  WIDTH * HEIGHT * 4) == 0);
+
+    free_gc(gc);
+    test_pixmap_destroy(expect);
+    test_pixmap_destroy(got);
+}
+
+/**
+ * The batched path must draw exactly what clipping each rectangle on its
+ * own does, also for rops where overlapping rectangles must not merge.
+ */
+static void
+fbfill_solid(void)
+{
+    RegionPtr one = make_clip(1, 1);
+    RegionPtr grid = make_clip(8, 4);
+
+    compare_fills(GXcopy, one);
+    compare_fills(GXcopy, grid);
+    compare_fills(GXor, grid);
+    compare_fills(GXxor, one);
+    compare_fills(GXxor, grid);
+
+    RegionDestroy(one);
+    RegionDestroy(grid);
+}
+
+static void
+bench_clip(const char *name, RegionPtr clip)
+{
+    PixmapPtr pixmap = make_pixmap();
+    GCPtr gc = make_gc(GXcopy, 0x00123456, clip);
+    xRectangle rects[NRECTS];
+    CARD64 start, per_box, batched;
+    int i;
+
+    make_rects(rects, NRECTS);
+
+    start = GetTimeInMicros();
+    for (i = 0; i < BENCH_REQUESTS; i++)
+        per_box_fill(&pixmap->drawable, gc, NRECTS, rects);
+    per_box = GetTimeInMicros() - start;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < BENCH_REQUESTS; i++)
+        fbPolyFillRect(&pixmap->drawable, gc, NRECTS, rects);
+    batched = GetTimeInMicros() - start;
+
+    printf("PolyFillRectangle %d rects, %s clip: per box %.1f us/request, "
+           "batched %.1f us/request\n", NRECTS, name,
+           (double) per_box / BENCH_REQUESTS,
+           (double) batched / BENCH_REQUESTS);
+
+    free_gc(gc);
+    test_pixmap_destroy(pixmap);
+}
+
+static void
+fbfill_bench(void)
+{
+    RegionPtr one = make_clip(1, 1);
+    RegionPtr grid = make_clip(8, 4);
+
+    bench_clip("1 box", one);
+    bench_clip("32 box", grid);
+
+    RegionDestroy(one);
+    RegionDestroy(grid);
+}
+
+int
+main(int argc, char **argv)
+{
+    dixResetPrivates();
+    fbfill_init();
+    srand(0);
+
+    fbfill_solid();
+    if (run_benchmarks(argc, argv))
+        fbfill_bench();
+
+    return 0;
+}
@@ -0,0 +1,337 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "misc.h"
+#include "scrnintstr.h"
+#include "privates.h"
+#include "fb.h"
+#include "picturestr.h"
+#include "mipict.h"
+#include "fbpict.h"
+#include "glyphstr.h"
+#include "tests-common.h"
+
+#define BENCH_COMPOSITES 200000
+
+#define RED     0xffff0000
+#define BLUE    0xff0000ff
+
+static ScreenRec screen;
+static PictureScreenRec picture_screen;
+static PictFormatRec a8r8g8b8;
+
+static void
+fbpict_init(void)
+{
+    test_screen_init(&screen);
+
+    assert(dixRegisterPrivateKey(&PictureScreenPrivateKeyRec,
+                                 PRIVATE_SCREEN, 0));
+
+    memset(&picture_screen, 0, sizeof(picture_screen));
+    picture_screen.CreatePicture = miCreatePicture;
+    picture_screen.DestroyPicture = miDestroyPicture;
+    picture_screen.ChangePictureClip = miChangePictureClip;
+    picture_screen.DestroyPictureClip = miDestroyPictureClip;
+    picture_screen.ChangePicture = miChangePicture;
+    picture_screen.ValidatePicture = miValidatePicture;
+    picture_screen.ChangePictureTransform = miChangePictureTransform;
+    picture_screen.ChangePictureFilter = miChangePictureFilter;
+    picture_screen.RealizeGlyph = miRealizeGlyph;
+    picture_screen.UnrealizeGlyph = fbUnrealizeGlyph;
+    SetPictureScreen(&screen, &picture_screen);
+
+    assert(fbPictureCacheInit(&screen));
+    assert(fbGlyphCacheInit());
+
+    memset(&a8r8g8b8, 0, sizeof(a8r8g8b8));
+    a8r8g8b8.type = PictTypeDirect;
+    a8r8g8b8.depth = 32;
+    a8r8g8b8.format = PICT_a8r8g8b8;
+}
+
+static PixmapPtr
+make_pixmap(int width, int height, CARD32 pixel)
+{
+    PixmapPtr pixmap = test_pixmap_create(&screen, width, height, 32, 32);
+    CARD32 *bits = pixmap->devPrivate.ptr;
+    int i;
+
+    for (i = 0; i < width * height; i++)
+        bits[i] = pixel;
+    return pixmap;
+}
+
+static PicturePtr
+make_picture(PixmapPtr pixmap)
+{
+    PicturePtr pict;
+    int error;
+
+    pict = CreatePicture(0, &pixmap->drawable, &a8r8g8b8, 0, NULL,
+                         serverClient, &error);
+    assert(pict && error == Success);
+    ValidatePicture(pict);
+    return pict;
+}
+
+static void
+free_picture(PicturePtr pict)
+{
+    PictureScreenPtr ps = GetPictureScreen(&screen);
+
+    /* FreePicture would hand the pixmap to pScreen->DestroyPixmap */
+    (*ps->DestroyPicture) (pict);
+    (*ps->DestroyPictureClip) (pict);
+    free(pict->transform);
+    dixFreeObjectWithPrivates(pict, PRIVATE_PICTURE);
+}
+
+static CARD32
+pixel_at(PixmapPtr pixmap, int x, int y)
+{
+    CARD32 *bits = pixmap->devPrivate.ptr;
+
+    return bits[y * (pixmap->devKind / 4) + x];
+}
+
+/**
+ * Changes made through the picture hooks must not be hidden by the
+ * images fbComposite keeps around.
+ */
+static void
+fbpict_cache_invalidation(void)
+{
+    PixmapPtr src_pix = make_pixmap(1, 1, RED);
+    PixmapPtr dst_pix = make_pixmap(8, 8, 0);
+    PicturePtr src = make_picture(src_pix);
+    PicturePtr dst = make_picture(dst_pix);
+    XID repeat = TRUE;
+    CARD32 *blue;
+
+    /* no repeat: only the first pixel is covered */
+    fbComposite(PictOpSrc, src, NULL, dst, 0, 0, 0, 0, 0, 0, 8, 8);
+    assert(pixel_at(dst_pix, 0, 0) == RED);
+    assert(pixel_at(dst_pix, 7, 7) == 0);
+
+    /* same call again, now from the cached images */
+    fbComposite(PictOpSrc, src, NULL, dst, 0, 0, 0, 0, 0, 0, 8, 8);
+    assert(pixel_at(dst_pix, 7, 7) == 0);
+
+    assert(ChangePicture(src, CPRepeat, &repeat, NULL, serverClient)
+           == Success);
+    ValidatePicture(src);
+    fbComposite(PictOpSrc, src, NULL, dst, 0, 0, 0, 0, 0, 0, 8, 8);
+    assert(pixel_at(dst_pix, 7, 7) == RED);
+
+    /* new storage behind the same pixmap */
+    blue = malloc(4);
+    *blue = BLUE;
+    free(src_pix->devPrivate.ptr);
+    src_pix->devPrivate.ptr = blue;
+    fbComposite(PictOpSrc, src, NULL, dst, 0, 0, 0, 0, 0, 0, 8, 8);
+    assert(pixel_at(dst_pix, 0, 0) == BLUE);
+    assert(pixel_at(dst_pix, 7, 7) == BLUE);
+
+    free_picture(src);
+    free_picture(dst);
+    test_pixmap_destroy(src_pix);
+    test_pixmap_destroy(dst_pix);
+}
+
+static GlyphPtr
+make_glyph(CARD32 pixel)
+{
+    xGlyphInfo gi = { .width = 8, .height = 8, .xOff = 8 };
+    GlyphPtr glyph = AllocateGlyph(&gi, 32);
+
+    assert(glyph);
+    SetGlyphPicture(glyph, &screen, make_picture(make_pixmap(8, 8, pixel)));
+    return glyph;
+}
+
+static void
+free_glyph(GlyphPtr glyph)
+{
+    PicturePtr pict = GetGlyphPicture(glyph, &screen);
+    PixmapPtr pixmap = (PixmapPtr) pict->pDrawable;
+
+    fbUnrealizeGlyph(&screen, glyph);
+    free_picture(pict);
+    test_pixmap_destroy(pixmap);
+    dixFreeObjectWithPrivates(glyph, PRIVATE_GLYPH);
+}
+
+static void
+draw_glyph(PicturePtr src, PicturePtr dst, GlyphPtr glyph)
+{
+    GlyphListRec list = { .xOff = 0, .yOff = 0, .len = 1 };
+
+    fbGlyphs(PictOpSrc, src, dst, NULL, 0, 0, 1, &list, &glyph);
+}
+
+/**
+ * With a budget, fbGlyphs keeps only the most recently drawn glyphs.
+ */
+static void
+fbpict_glyph_cache(void)
+{
+    PixmapPtr src_pix = make_pixmap(1, 1, RED);
+    PixmapPtr dst_pix = make_pixmap(8, 8, 0);
+    PicturePtr src = make_picture(src_pix);
+    PicturePtr dst = make_picture(dst_pix);
+    XID repeat = TRUE;
+    FbGlyphCacheStatsRec stats;
+    GlyphPtr glyphs[3];
+    int i;
+
+    assert(ChangePicture(src, CPRepeat, &repeat, NULL, serverClient)
+           == Success);
+    ValidatePicture(src);
+
+    for (i = 0; i < 3; i++)
+        glyphs[i] = make_glyph(BLUE);
+
+    /* room for two 8x8 a8r8g8b8 glyphs */
+    fbSetGlyphCacheBudget(2 * 8 * 8 * 4);
+
+    for (i = 0; i < 3; i++)
+        draw_glyph(src, dst, glyphs[i]);
+    assert(pixel_at(dst_pix, 7, 7) == RED);
+
+    fbGetGlyphCacheStats(&stats);
+    assert(stats.misses == 3);
+    assert(stats.hits == 0);
+    assert(stats.evictions == 1);
+    assert(stats.glyphs == 2);
+    assert(stats.bytes <= stats.budget);
+
+    /* the first glyph went, the other two are still there */
+    draw_glyph(src, dst, glyphs[2]);
+    draw_glyph(src, dst, glyphs[1]);
+    fbGetGlyphCacheStats(&stats);
+    assert(stats.hits == 2);
+    assert(stats.misses == 3);
+
+    /* glyphs[2] is now the least recently used */
+    draw_glyph(src, dst, glyphs[0]);
+    fbGetGlyphCacheStats(&stats);
+    assert(stats.misses == 4);
+    assert(stats.evictions == 2);
+    draw_glyph(src, dst, glyphs[1]);
+    fbGetGlyphCacheStats(&stats);
+    assert(stats.hits == 3);
+
+    free_glyph(glyphs[1]);
+    fbGetGlyphCacheStats(&stats);
+    assert(stats.glyphs == 1);
+    assert(stats.bytes == 8 * 8 * 4);
+
+    free_glyph(glyphs[0]);
+    free_glyph(glyphs[2]);
+    fbGetGlyphCacheStats(&stats);
+    assert(stats.glyphs == 0);
+    assert(stats.bytes == 0);
+
+    fbSetGlyphCacheBudget(0);
+    fbDestroyGlyphCache();
+
+    free_picture(src);
+    free_picture(dst);
+    test_pixmap_destroy(src_pix);
+    test_pixmap_destroy(dst_pix);
+}
+
+static void
+uncached_composite(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+                   CARD16 width, CARD16 height)
+{
+    pixman_image_t *src, *dest;
+    int src_xoff, src_yoff;
+    int dst_xoff, dst_yoff;
+
+    src = image_from_pict(pSrc, FALSE, &src_xoff, &src_yoff);
+    dest = image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
+    if (src && dest)
+        pixman_image_composite(op, src, NULL, dest, src_xoff, src_yoff,
+                               0, 0, dst_xoff, dst_yoff, width, height);
+    free_pixman_pict(pSrc, src);
+    free_pixman_pict(pDst, dest);
+}
+
+/**
+ * Small composites are dominated by setting up the pixman images; compare
+ * building them on every call with reusing the cached ones.
+ */
+static void
+fbpict_bench(void)
+{
+    PixmapPtr src_pix = make_pixmap(16, 16, RED);
+    PixmapPtr dst_pix = make_pixmap(64, 64, 0);
+    PicturePtr src = make_picture(src_pix);
+    PicturePtr dst = make_picture(dst_pix);
+    CARD64 start, uncached, cached;
+    int i;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < BENCH_COMPOSITES; i++)
+        uncached_composite(PictOpOver, src, dst, 16, 16);
+    uncached = GetTimeInMicros() - start;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < BENCH_COMPOSITES; i++)
+        fbComposite(PictOpOver, src, NULL, dst, 0, 0, 0, 0, 0, 0, 16, 16);
+    cached = GetTimeInMicros() - start;
+
+    printf("fbComposite 16x16 over: uncached %.1f ns/call, "
+           "cached %.1f ns/call\n",
+           uncached * 1000.0 / BENCH_COMPOSITES,
+           cached * 1000.0 / BENCH_COMPOSITES);
+
+    free_picture(src);
+    free_picture(dst);
+    test_pixmap_destroy(src_pix);
+    test_pixmap_destroy(dst_pix);
+}
+
+int
+main(int argc, char **argv)
+{
+    dixResetPrivates();
+    fbpict_init();
+
+    fbpict_cache_invalidation();
+    fbpict_glyph_cache();
+
+    if (run_benchmarks(argc, argv))
+        fbpict_bench();
+
+    return 0;
+}
@@ -342,6 +342,79 @@ fixes_pointer_barrier_clamp_test(void)
     assert(cy == barrier.y1);
 }
 
+/**
+ * Every barrier a motion is blocked by must be in the index range the
+ * motion looks at, also after barriers were removed again.
+ */
+static void
+fixes_pointer_barrier_index_test(void)
+{
+    struct BarrierIndex index = { { 0 } };
+    struct PointerBarrier barriers[200];
+    int i, j, n, first, last;
+    double distance;
+
+    for (i = 0; i < 200; i++) {
+        struct PointerBarrier *b = &barriers[i];
+        int at = rand() % 2000, from = rand() % 2000 - 1, to = rand() % 2000;
+
+        /* some rays, open at one end */
+        if (from > to || from < 0) {
+            from = -1;
+            if (rand() % 2) {
+                from = to;
+                to = -1;
+            }
+        }
+        if (i % 2) {
+            b->x1 = b->x2 = at;
+            b->y1 = from;
+            b->y2 = to;
+        }
+        else {
+            b->y1 = b->y2 = at;
+            b->x1 = from;
+            b->x2 = to;
+        }
+        b->directions = 0;
+        assert(barrier_index_add(&index, b));
+    }
+
+    for (n = 0; n < 2; n++) {
+        for (j = 0; j < 5000; j++) {
+            int x1 = rand() % 2000, y1 = rand() % 2000;
+            int x2 = x1 + rand() % 81 - 40, y2 = y1 + rand() % 81 - 40;
+            int found = 0, expected = 0;
+
+            barrier_axis_range(&index.vertical, x1, x2, &first, &last);
+            for (i = first; i < last; i++)
+                if (barrier_is_blocking(index.vertical.barriers[i],
+                                        x1, y1, x2, y2, &distance))
+                    found++;
+            barrier_axis_range(&index.horizontal, y1, y2, &first, &last);
+            for (i = first; i < last; i++)
+                if (barrier_is_blocking(index.horizontal.barriers[i],
+                                        x1, y1, x2, y2, &distance))
+                    found++;
+
+            for (i = 0; i < 200; i++)
+                if ((n == 0 || i % 3) &&
+                    barrier_is_blocking(&barriers[i], x1, y1, x2, y2,
+                                        &distance))
+                    expected++;
+            assert(found == expected);
+        }
+
+        /* drop every third barrier and look again */
+        for (i = 0; n == 0 && i < 200; i += 3)
+            barrier_index_remove(&index, &barriers[i]);
+    }
+
+    assert(index.vertical.num + index.horizontal.num == 200 - 67);
+    barrier_index_free(&index);
+    assert(index.vertical.num == 0 && index.horizontal.num == 0);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -349,6 +422,7 @@ main(int argc, char **argv)
     fixes_pointer_barriers_test();
     fixes_pointer_barrier_direction_test();
     fixes_pointer_barrier_clamp_test();
+    fixes_pointer_barrier_index_test();
 
     return 0;
 }
@@ -0,0 +1,194 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "misc.h"
+#include "scrnintstr.h"
+#include "privates.h"
+#include "picturestr.h"
+#include "glyphstr.h"
+#include "tests-common.h"
+
+#define BENCH_GLYPHS 50000
+
+typedef int (*HashGlyphProc) (xGlyphInfo * gi, CARD8 *bits,
+                              unsigned long size, unsigned char sha1[20]);
+
+static void
+make_glyph(int seed, xGlyphInfo * gi, CARD8 *bits, unsigned long size)
+{
+    unsigned long i;
+
+    memset(gi, 0, sizeof(*gi));
+    gi->width = 12;
+    gi->height = 16;
+    gi->xOff = 12;
+    for (i = 0; i < size; i++)
+        bits[i] = (seed * 131 + i * 7) ^ (seed >> 8);
+}
+
+static GlyphPtr
+new_glyph(GlyphSetPtr glyphSet, xGlyphInfo * gi, CARD8 *bits,
+          unsigned char sha1[20])
+{
+    GlyphPtr glyph = AllocateGlyph(gi, glyphSet->fdepth);
+
+    assert(glyph);
+    memcpy(glyph->sha1, sha1, 20);
+    memcpy(glyph->bits, bits, GlyphBitsSize(gi, glyphSet->fdepth));
+    return glyph;
+}
+
+/**
+ * The digest covers the metrics and every byte of the bitmap, and is
+ * stable from call to call.
+ */
+static void
+glyph_hash(void)
+{
+    xGlyphInfo gi;
+    CARD8 bits[192];
+    unsigned char a[20], b[20];
+
+    make_glyph(1, &gi, bits, sizeof(bits));
+    assert(HashGlyph(&gi, bits, sizeof(bits), a) == Success);
+    assert(HashGlyph(&gi, bits, sizeof(bits), b) == Success);
+    assert(memcmp(a, b, 20) == 0);
+
+    bits[191] ^= 1;
+    HashGlyph(&gi, bits, sizeof(bits), b);
+    assert(memcmp(a, b, 20) != 0);
+    bits[191] ^= 1;
+
+    gi.xOff++;
+    HashGlyph(&gi, bits, sizeof(bits), b);
+    assert(memcmp(a, b, 20) != 0);
+    gi.xOff--;
+
+    HashGlyph(&gi, bits, sizeof(bits) - 1, b);
+    assert(memcmp(a, b, 20) != 0);
+}
+
+/**
+ * Two different glyphs that end up with the same digest must not be
+ * merged.
+ */
+static void
+glyph_collision(void)
+{
+    GlyphSetPtr glyphSet = AllocateGlyphSet(GlyphFormat8, NULL);
+    xGlyphInfo gi;
+    CARD8 bits[192], other[192];
+    unsigned char sha1[20];
+    GlyphPtr a, b;
+
+    assert(glyphSet);
+    make_glyph(1, &gi, bits, sizeof(bits));
+    make_glyph(2, &gi, other, sizeof(other));
+    assert(GlyphBitsSize(&gi, GlyphFormat8) == sizeof(bits));
+    HashGlyph(&gi, bits, sizeof(bits), sha1);
+
+    assert(ResizeGlyphSet(glyphSet, 2));
+    a = new_glyph(glyphSet, &gi, bits, sha1);
+    AddGlyph(glyphSet, a, 1);
+    assert(FindGlyphByBits(sha1, GlyphFormat8, &gi, bits) == a);
+
+    /* forge a glyph with a's digest but other bits */
+    assert(FindGlyphByHash(sha1, GlyphFormat8) == a);
+    assert(FindGlyphByBits(sha1, GlyphFormat8, &gi, other) == NULL);
+    b = new_glyph(glyphSet, &gi, other, sha1);
+    AddGlyph(glyphSet, b, 2);
+
+    assert(FindGlyph(glyphSet, 1) == a);
+    assert(FindGlyph(glyphSet, 2) == b);
+    assert(FindGlyphByBits(sha1, GlyphFormat8, &gi, other) == b);
+
+    FreeGlyphSet(glyphSet, 0);
+}
+
+/**
+ * Time what AddGlyphs does per glyph short of rendering it: hash the
+ * bitmap, look for an existing copy and add the new glyph.
+ */
+static CARD64
+glyph_add_time(HashGlyphProc hash, Bool verify)
+{
+    GlyphSetPtr glyphSet = AllocateGlyphSet(GlyphFormat8, NULL);
+    xGlyphInfo gi;
+    CARD8 bits[192];
+    unsigned char sha1[20];
+    CARD64 start, end;
+    int i;
+
+    assert(glyphSet);
+    start = GetTimeInMicros();
+    for (i = 0; i < BENCH_GLYPHS; i++) {
+        GlyphPtr glyph;
+
+        make_glyph(i, &gi, bits, sizeof(bits));
+        assert(hash(&gi, bits, sizeof(bits), sha1) == Success);
+        if (verify)
+            glyph = FindGlyphByBits(sha1, GlyphFormat8, &gi, bits);
+        else
+            glyph = FindGlyphByHash(sha1, GlyphFormat8);
+        if (!glyph)
+            glyph = new_glyph(glyphSet, &gi, bits, sha1);
+        assert(ResizeGlyphSet(glyphSet, 1));
+        AddGlyph(glyphSet, glyph, i);
+    }
+    end = GetTimeInMicros();
+
+    FreeGlyphSet(glyphSet, 0);
+    return end - start;
+}
+
+static void
+glyph_bench(void)
+{
+    CARD64 sha1 = glyph_add_time(HashGlyphSHA1, FALSE);
+    CARD64 fast = glyph_add_time(HashGlyph, TRUE);
+
+    printf("%d glyphs added: %llu us with SHA-1, %llu us with HashGlyph\n",
+           BENCH_GLYPHS, (unsigned long long) sha1,
+           (unsigned long long) fast);
+}
+
+int
+main(int argc, char **argv)
+{
+    dixResetPrivates();
+
+    glyph_hash();
+    glyph_collision();
+
+    if (run_benchmarks(argc, argv))
+        glyph_bench();
+
+    return 0;
+}
@@ -26,8 +26,11 @@
 #endif
 
 #include <stdint.h>
+#include <string.h>
 #include "misc.h"
 #include "scrnintstr.h"
+#include "dixstruct.h"
+#include "resource.h"
 
 ScreenInfo screenInfo;
 
@@ -155,11 +158,87 @@ dix_update_desktop_dimensions(void)
     assert_dimensions(-w2, -h2, w2, h2);
 }
 
+#define FREE_ORDER_RESOURCES 1000
+
+static XID free_order_ids[2 * FREE_ORDER_RESOURCES];
+static Bool free_order_later[2 * FREE_ORDER_RESOURCES];
+static int free_order_count;
+
+static int
+free_order_delete(void *value, XID id)
+{
+    int i;
+
+    /* a resource added to an ID goes before the one it was added to */
+    if (!value)
+        for (i = 0; i < free_order_count; i++)
+            assert(free_order_ids[i] != id || free_order_later[i]);
+    free_order_later[free_order_count] = value != NULL;
+    free_order_ids[free_order_count++] = id;
+    return Success;
+}
+
+/**
+ * FreeClientResources goes through the hash buckets in order and takes
+ * the newest resource of each chain first, whatever its type.  That must
+ * hold whether or not a resize is in flight.
+ */
+static void
+dix_free_client_resources(void)
+{
+    ClientRec server, client;
+    RESTYPE first, second;
+    XID base;
+    int i, n;
+
+    memset(&server, 0, sizeof(server));
+    memset(&client, 0, sizeof(client));
+    serverClient = &server;
+    assert(InitClientResources(&server));
+    first = CreateNewResourceType(free_order_delete, "FreeOrderFirst");
+    second = CreateNewResourceType(free_order_delete, "FreeOrderSecond");
+    assert(first && second);
+
+    client.index = 1;
+    client.clientAsMask = (XID) 1 << CLIENTOFFSET;
+    base = client.clientAsMask;
+
+    for (n = 8; n <= FREE_ORDER_RESOURCES; n *= 5) {
+        assert(InitClientResources(&client));
+
+        /* every ID gets a resource of the newer type, the even ones then
+         * get one of the older type as well */
+        for (i = 0; i < n; i++)
+            assert(AddResource(base + i, second, NULL));
+        for (i = 0; i < n; i += 2)
+            assert(AddResource(base + i, first, &client));
+
+        free_order_count = 0;
+        FreeClientResources(&client);
+        assert(free_order_count == n + (n + 1) / 2);
+
+        /* a table this small hashes these IDs to themselves */
+        if (n <= 64) {
+            int k = 0;
+
+            for (i = 0; i < n; i++) {
+                if (i % 2 == 0)
+                    assert(free_order_ids[k++] == base + i);
+                assert(free_order_ids[k++] == base + i);
+            }
+        }
+    }
+
+    FreeClientResources(&server);
+    serverClient = NULL;
+}
+
 int
 main(int argc, char **argv)
 {
     dix_version_compare();
     dix_update_desktop_dimensions();
+    dix_free_client_resources();
 
     return 0;
 }
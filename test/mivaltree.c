@@ -0,0 +1,288 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/extensions/shapeconst.h>
+#include "misc.h"
+#include "scrnintstr.h"
+#include "windowstr.h"
+#include "regionstr.h"
+#include "mi.h"
+#include "tests-common.h"
+
+#define NWINDOWS 9
+
+/*
+ * One window tree per validation mode.  Window i of one tree is window i
+ * of the other, and 'exposed' collects what WindowExposures was handed
+ * for it since the last check.
+ */
+typedef struct {
+    WindowPtr windows[NWINDOWS];
+    RegionRec exposed[NWINDOWS];
+} TestTreeRec, *TestTreePtr;
+
+static ScreenRec screen;
+static TestTreePtr current;
+
+static void
+record_exposures(WindowPtr pWin, RegionPtr prgn, RegionPtr other_exposed)
+{
+    RegionPtr exposed = &current->exposed[pWin->drawable.id];
+
+    RegionUnion(exposed, exposed, prgn);
+}
+
+static Bool
+position_window(WindowPtr pWin, int x, int y)
+{
+    return TRUE;
+}
+
+static void
+mivaltree_init(void)
+{
+    test_screen_init(&screen);
+    screen.width = 400;
+    screen.height = 300;
+    screen.MarkWindow = miMarkWindow;
+    screen.MarkOverlappedWindows = miMarkOverlappedWindows;
+    screen.ValidateTree = miValidateTree;
+    screen.HandleExposures = miHandleValidateExposures;
+    screen.WindowExposures = record_exposures;
+    screen.PositionWindow = position_window;
+}
+
+static WindowPtr
+make_window(TestTreePtr tree, int id, WindowPtr parent,
+            int x, int y, int w, int h)
+{
+    WindowPtr pWin = calloc(1, sizeof(WindowRec));
+
+    assert(pWin);
+    pWin->drawable.type = DRAWABLE_WINDOW;
+    pWin->drawable.pScreen = &screen;
+    pWin->drawable.id = id;
+    pWin->drawable.width = w;
+    pWin->drawable.height = h;
+    pWin->origin.x = x;
+    pWin->origin.y = y;
+    pWin->drawable.x = x + (parent ? parent->drawable.x : 0);
+    pWin->drawable.y = y + (parent ? parent->drawable.y : 0);
+    pWin->winGravity = NorthWestGravity;
+    pWin->bitGravity = ForgetGravity;
+    pWin->backgroundState = None;
+    pWin->mapped = pWin->realized = pWin->viewable = TRUE;
+    pWin->parent = parent;
+    pWin->optional = calloc(1, sizeof(WindowOptRec));
+    assert(pWin->optional);
+    RegionNull(&pWin->clipList);
+    RegionNull(&pWin->borderClip);
+
+    if (parent) {
+        pWin->visibility = VisibilityNotViewable;
+        pWin->nextSib = parent->firstChild;
+        if (parent->firstChild)
+            parent->firstChild->prevSib = pWin;
+        else
+            parent->lastChild = pWin;
+        parent->firstChild = pWin;
+        SetWinSize(pWin);
+        SetBorderSize(pWin);
+    }
+    else {
+        BoxRec box = { 0, 0, w, h };
+
+        pWin->visibility = VisibilityUnobscured;
+        RegionInit(&pWin->winSize, &box, 1);
+        RegionInit(&pWin->borderSize, &box, 1);
+        RegionInit(&pWin->clipList, &box, 1);
+        RegionInit(&pWin->borderClip, &box, 1);
+    }
+
+    tree->windows[id] = pWin;
+    RegionNull(&tree->exposed[id]);
+    return pWin;
+}
+
+/*
+ * A toplevel with two children that each have two levels of children of
+ * their own, and a second toplevel overlapping it.  Both are then mapped
+ * the way MapWindow would.
+ */
+static void
+build_tree(TestTreePtr tree)
+{
+    WindowPtr root, top, b1, c1, b2, d1, other;
+    WindowPtr pLayerWin;
+
+    root = make_window(tree, 0, NULL, 0, 0, 400, 300);
+    top = make_window(tree, 1, root, 20, 20, 300, 220);
+    b1 = make_window(tree, 2, top, 10, 10, 120, 100);
+    c1 = make_window(tree, 3, b1, 10, 10, 80, 60);
+    make_window(tree, 4, c1, 5, 5, 40, 30);
+    b2 = make_window(tree, 5, top, 150, 10, 120, 150);
+    d1 = make_window(tree, 6, b2, 60, 70, 50, 50);
+    make_window(tree, 7, d1, 5, 5, 30, 30);
+    other = make_window(tree, 8, root, 200, 150, 150, 100);
+
+    current = tree;
+    miMarkOverlappedWindows(top, top, &pLayerWin);
+    miMarkOverlappedWindows(other, other, &pLayerWin);
+    miValidateTree(root, other, VTMap);
+    miHandleValidateExposures(root);
+}
+
+static void
+free_tree(TestTreePtr tree)
+{
+    int i;
+
+    for (i = 0; i < NWINDOWS; i++) {
+        WindowPtr pWin = tree->windows[i];
+
+        if (pWin->optional->boundingShape)
+            RegionDestroy(pWin->optional->boundingShape);
+        free(pWin->optional);
+        RegionUninit(&pWin->winSize);
+        RegionUninit(&pWin->borderSize);
+        RegionUninit(&pWin->clipList);
+        RegionUninit(&pWin->borderClip);
+        RegionUninit(&tree->exposed[i]);
+        free(pWin);
+    }
+}
+
+/*
+ * Both trees must have the same clips and have seen the same exposures,
+ * and every window's validation data must have been consumed.
+ */
+static void
+compare_trees(TestTreePtr full, TestTreePtr incremental)
+{
+    int i;
+
+    for (i = 0; i < NWINDOWS; i++) {
+        WindowPtr a = full->windows[i];
+        WindowPtr b = incremental->windows[i];
+
+        assert(!a->valdata && !b->valdata);
+        assert(RegionEqual(&a->clipList, &b->clipList));
+        assert(RegionEqual(&a->borderClip, &b->borderClip));
+        assert(a->visibility == b->visibility);
+        assert(RegionEqual(&full->exposed[i], &incremental->exposed[i]));
+        RegionEmpty(&full->exposed[i]);
+        RegionEmpty(&incremental->exposed[i]);
+    }
+}
+
+static void
+shape_window(TestTreePtr tree, int id, int w, int h)
+{
+    WindowPtr pWin = tree->windows[id];
+    BoxRec box = { 0, 0, w, h };
+
+    if (pWin->optional->boundingShape)
+        RegionDestroy(pWin->optional->boundingShape);
+    pWin->optional->boundingShape = RegionCreate(&box, 1);
+    current = tree;
+    miSetShape(pWin, ShapeBounding);
+}
+
+static void
+resize_window(TestTreePtr tree, int id, int w, int h)
+{
+    WindowPtr pWin = tree->windows[id];
+
+    current = tree;
+    miSlideAndSizeWindow(pWin, pWin->origin.x, pWin->origin.y, w, h,
+                         NullWindow);
+}
+
+/* Do the same to window id of both trees, the way each mode does it */
+static void
+apply_both(TestTreePtr full, TestTreePtr incremental,
+           void (*op) (TestTreePtr, int, int, int), int id, int w, int h)
+{
+    miIncrementalValidate = FALSE;
+    (*op) (full, id, w, h);
+    miIncrementalValidate = TRUE;
+    (*op) (incremental, id, w, h);
+    compare_trees(full, incremental);
+}
+
+/**
+ * Shaping or shrinking a window leaves nested children with empty or far
+ * away borderSizes.  They are marked all the same and have to come out
+ * of an incremental validation with their clips and exposures computed,
+ * exactly as a full one leaves them.
+ */
+static void
+mivaltree_incremental(void)
+{
+    TestTreeRec full, incremental;
+
+    miIncrementalValidate = FALSE;
+    build_tree(&full);
+    miIncrementalValidate = TRUE;
+    build_tree(&incremental);
+    compare_trees(&full, &incremental);
+
+    /* shape the second child down so that its children fall outside */
+    apply_both(&full, &incremental, shape_window, 5, 50, 50);
+    assert(!RegionNotEmpty(&incremental.windows[6]->borderSize));
+    assert(!RegionNotEmpty(&incremental.windows[7]->clipList));
+
+    /* and back */
+    apply_both(&full, &incremental, shape_window, 5, 120, 150);
+    assert(RegionNotEmpty(&incremental.windows[7]->clipList));
+
+    /* shrink the toplevel so that most of its inferiors are cut off */
+    apply_both(&full, &incremental, resize_window, 1, 30, 20);
+    assert(!RegionNotEmpty(&incremental.windows[4]->borderSize));
+    assert(!RegionNotEmpty(&incremental.windows[7]->borderSize));
+
+    /* and grow it again */
+    apply_both(&full, &incremental, resize_window, 1, 300, 220);
+    assert(RegionNotEmpty(&incremental.windows[4]->clipList));
+
+    free_tree(&full);
+    free_tree(&incremental);
+}
+
+int
+main(int argc, char **argv)
+{
+    mivaltree_init();
+
+    mivaltree_incremental();
+
+    return 0;
+}
@@ -0,0 +1,388 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE
+ *  OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "misc.h"
+#include "regionstr.h"
+#include "gc.h"
+#include "tests-common.h"
+
+/* coverage is checked on a grid, with coordinates from -ORIGIN on */
+#define GRID    320
+#define ORIGIN  32
+
+#define BENCH_RUNS 200
+
+static unsigned char expect[GRID][GRID];
+static unsigned char got[GRID][GRID];
+
+static void
+paint_rects(unsigned char grid[GRID][GRID], xRectangle *rects, int n)
+{
+    int i, x, y;
+
+    for (i = 0; i < n; i++)
+        for (y = rects[i].y; y < rects[i].y + rects[i].height; y++)
+            for (x = rects[i].x; x < rects[i].x + rects[i].width; x++)
+                grid[y + ORIGIN][x + ORIGIN] = 1;
+}
+
+/**
+ * The region must be y-x banded the way every region operation leaves
+ * it, and cover exactly what expect covers.
+ */
+static void
+check_region(RegionPtr reg)
+{
+    BoxPtr box = RegionRects(reg);
+    int n = RegionNumRects(reg);
+    BoxRec extents = { MAXSHORT, MAXSHORT, MINSHORT, MINSHORT };
+    int i, j, x, y;
+
+    assert(!RegionNar(reg));
+    assert(n != 1 || !reg->data);
+    for (i = 0; i < n; i++) {
+        assert(box[i].x1 < box[i].x2 && box[i].y1 < box[i].y2);
+        extents.x1 = min(extents.x1, box[i].x1);
+        extents.y1 = min(extents.y1, box[i].y1);
+        extents.x2 = max(extents.x2, box[i].x2);
+        extents.y2 = max(extents.y2, box[i].y2);
+        if (i == 0)
+            continue;
+        if (box[i].y1 == box[i - 1].y1) {
+            /* same band: sorted, and not touching */
+            assert(box[i].y2 == box[i - 1].y2);
+            assert(box[i].x1 > box[i - 1].x2);
+        }
+        else
+            assert(box[i].y1 >= box[i - 1].y2);
+    }
+
+    /* adjacent bands with the same boxes must have been coalesced */
+    for (i = 0; i < n; i = j) {
+        int len, next;
+
+        for (j = i; j < n && box[j].y1 == box[i].y1; j++);
+        len = j - i;
+        for (next = j; next < n && box[next].y1 == box[j].y1; next++);
+        if (j == n || box[j].y1 != box[i].y2 || next - j != len)
+            continue;
+        for (x = 0; x < len; x++)
+            if (box[i + x].x1 != box[j + x].x1 ||
+                box[i + x].x2 != box[j + x].x2)
+                break;
+        assert(x != len);
+    }
+
+    if (n)
+        assert(memcmp(&extents, &reg->extents, sizeof(extents)) == 0);
+
+    memset(got, 0, sizeof(got));
+    for (i = 0; i < n; i++)
+        for (y = box[i].y1; y < box[i].y2; y++)
+            for (x = box[i].x1; x < box[i].x2; x++)
+                got[y + ORIGIN][x + ORIGIN] = 1;
+    assert(memcmp(expect, got, sizeof(got)) == 0);
+}
+
+static void
+rect_to_box(BoxPtr box, xRectangle *rect)
+{
+    box->x1 = rect->x;
+    box->y1 = rect->y;
+    box->x2 = rect->x + rect->width;
+    box->y2 = rect->y + rect->height;
+}
+
+/* overlapping toplevels, some hanging off the top left */
+static void
+make_windows(xRectangle *rects, int n)
+{
+    int i, w, h;
+
+    for (i = 0; i < n; i++) {
+        rects[i].x = rand() % (GRID - 2 * ORIGIN) - ORIGIN;
+        rects[i].y = rand() % (GRID - 2 * ORIGIN) - ORIGIN;
+        w = 8 + rand() % 112;
+        h = 8 + rand() % 82;
+        rects[i].width = min(w, GRID - ORIGIN - rects[i].x);
+        rects[i].height = min(h, GRID - ORIGIN - rects[i].y);
+    }
+}
+
+/* what a terminal damages: glyph cells along text lines */
+static void
+make_damage(xRectangle *rects, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        rects[i].x = (rand() % 36) * 7;
+        rects[i].y = (rand() % 18) * 15;
+        rects[i].width = 7 * (1 + rand() % 3);
+        rects[i].height = 15;
+    }
+}
+
+/* a grid of cells in y-x order, as a client drawing a table sends them */
+static void
+make_grid(xRectangle *rects, int n, Bool reverse)
+{
+    int i, cell;
+
+    for (i = 0; i < n; i++) {
+        cell = reverse ? n - 1 - i : i;
+        rects[i].x = (cell % 32) * 8 - ORIGIN;
+        rects[i].y = (cell / 32) * 6 - ORIGIN;
+        rects[i].width = 6;
+        rects[i].height = 4 + (cell % 3);
+    }
+}
+
+static void
+check_from_rects(xRectangle *rects, int n)
+{
+    RegionPtr reg;
+
+    memset(expect, 0, sizeof(expect));
+    paint_rects(expect, rects, n);
+    reg = RegionFromRects(n, rects, CT_UNSORTED);
+    check_region(reg);
+    RegionDestroy(reg);
+}
+
+/**
+ * RegionFromRects sorts and merges whatever it gets: few or many
+ * rectangles, in order, backwards, repeated or overlapping.
+ */
+static void
+region_from_rects(void)
+{
+    xRectangle rects[1024];
+
+    make_windows(rects, 5);
+    check_from_rects(rects, 5);
+    make_windows(rects, 300);
+    check_from_rects(rects, 300);
+    make_damage(rects, 1024);
+    check_from_rects(rects, 1024);
+    make_grid(rects, 1024, FALSE);
+    check_from_rects(rects, 1024);
+    make_grid(rects, 1024, TRUE);
+    check_from_rects(rects, 1024);
+    make_grid(rects, 40, TRUE);
+    check_from_rects(rects, 40);
+
+    make_windows(rects, 512);
+    memcpy(rects + 512, rects, 512 * sizeof(xRectangle));
+    check_from_rects(rects, 1024);
+}
+
+/**
+ * Union, intersection and subtraction of a window stack with damage,
+ * and the clip list of a window behind the stack.
+ */
+static void
+region_ops(void)
+{
+    static unsigned char a[GRID][GRID], b[GRID][GRID];
+    xRectangle windows[64], damage[512];
+    RegionRec result, clip;
+    RegionPtr ra, rb;
+    BoxRec box, screen = { -ORIGIN, -ORIGIN, GRID - ORIGIN, GRID - ORIGIN };
+    int i, x, y;
+
+    make_windows(windows, 64);
+    make_damage(damage, 512);
+    memset(a, 0, sizeof(a));
+    memset(b, 0, sizeof(b));
+    paint_rects(a, windows, 64);
+    paint_rects(b, damage, 512);
+    ra = RegionFromRects(64, windows, CT_UNSORTED);
+    rb = RegionFromRects(512, damage, CT_UNSORTED);
+    RegionNull(&result);
+
+    RegionUnion(&result, ra, rb);
+    for (y = 0; y < GRID; y++)
+        for (x = 0; x < GRID; x++)
+            expect[y][x] = a[y][x] | b[y][x];
+    check_region(&result);
+
+    RegionIntersect(&result, ra, rb);
+    for (y = 0; y < GRID; y++)
+        for (x = 0; x < GRID; x++)
+            expect[y][x] = a[y][x] & b[y][x];
+    check_region(&result);
+
+    RegionSubtract(&result, ra, rb);
+    for (y = 0; y < GRID; y++)
+        for (x = 0; x < GRID; x++)
+            expect[y][x] = a[y][x] & !b[y][x];
+    check_region(&result);
+
+    /* the screen with every window subtracted one after the other */
+    RegionInit(&clip, &screen, 1);
+    memset(expect, 1, sizeof(expect));
+    for (i = 0; i < 64; i++) {
+        rect_to_box(&box, &windows[i]);
+        RegionReset(&result, &box);
+        RegionSubtract(&clip, &clip, &result);
+        for (y = windows[i].y; y < windows[i].y + windows[i].height; y++)
+            for (x = windows[i].x; x < windows[i].x + windows[i].width; x++)
+                expect[y + ORIGIN][x + ORIGIN] = 0;
+    }
+    check_region(&clip);
+
+    RegionUninit(&clip);
+    RegionUninit(&result);
+    RegionDestroy(ra);
+    RegionDestroy(rb);
+}
+
+/**
+ * miValidateTree builds the union of a parent's children by appending
+ * their regions unsorted and validating once.
+ */
+static void
+region_append_validate(void)
+{
+    xRectangle windows[200];
+    RegionRec childUnion, child;
+    BoxRec box;
+    Bool overlap;
+    int i;
+
+    make_windows(windows, 200);
+    memset(expect, 0, sizeof(expect));
+    paint_rects(expect, windows, 200);
+
+    RegionNull(&childUnion);
+    for (i = 0; i < 200; i++) {
+        rect_to_box(&box, &windows[i]);
+        RegionInit(&child, &box, 1);
+        assert(RegionAppend(&childUnion, &child));
+    }
+    assert(RegionValidate(&childUnion, &overlap));
+    assert(overlap);
+    check_region(&childUnion);
+    RegionUninit(&childUnion);
+}
+
+static void
+bench_from_rects(const char *name, xRectangle *rects, int n)
+{
+    CARD64 start, elapsed;
+    int i;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < BENCH_RUNS; i++)
+        RegionDestroy(RegionFromRects(n, rects, CT_UNSORTED));
+    elapsed = GetTimeInMicros() - start;
+    printf("RegionFromRects %d %s: %.1f us\n", n, name,
+           (double) elapsed / BENCH_RUNS);
+}
+
+static void
+region_bench(void)
+{
+    xRectangle windows[300], damage[2048];
+    RegionRec childUnion, child, clip, result;
+    RegionPtr rw, rd;
+    BoxRec box, screen = { -ORIGIN, -ORIGIN, GRID - ORIGIN, GRID - ORIGIN };
+    CARD64 start, validate, ops;
+    Bool overlap;
+    int i, j;
+
+    make_windows(windows, 300);
+    make_damage(damage, 2048);
+    bench_from_rects("windows", windows, 300);
+    bench_from_rects("damage rects", damage, 2048);
+    make_grid(damage, 2048, FALSE);
+    bench_from_rects("sorted cells", damage, 2048);
+    make_grid(damage, 2048, TRUE);
+    bench_from_rects("reversed cells", damage, 2048);
+
+    /* the child union of a busy parent, as miValidateTree computes it */
+    start = GetTimeInMicros();
+    for (j = 0; j < BENCH_RUNS; j++) {
+        RegionNull(&childUnion);
+        for (i = 0; i < 300; i++) {
+            rect_to_box(&box, &windows[i]);
+            RegionInit(&child, &box, 1);
+            RegionAppend(&childUnion, &child);
+        }
+        RegionValidate(&childUnion, &overlap);
+        RegionUninit(&childUnion);
+    }
+    validate = GetTimeInMicros() - start;
+    printf("RegionValidate of 300 windows: %.1f us\n",
+           (double) validate / BENCH_RUNS);
+
+    /* clip the stack against the screen, then clip damage by it */
+    make_damage(damage, 2048);
+    rw = RegionFromRects(300, windows, CT_UNSORTED);
+    rd = RegionFromRects(2048, damage, CT_UNSORTED);
+    RegionNull(&result);
+    start = GetTimeInMicros();
+    for (j = 0; j < BENCH_RUNS; j++) {
+        RegionInit(&clip, &screen, 1);
+        for (i = 0; i < 300; i++) {
+            rect_to_box(&box, &windows[i]);
+            RegionReset(&result, &box);
+            RegionSubtract(&clip, &clip, &result);
+        }
+        RegionUnion(&result, &clip, rd);
+        RegionIntersect(&result, rw, rd);
+        RegionSubtract(&result, rd, rw);
+        RegionUninit(&clip);
+    }
+    ops = GetTimeInMicros() - start;
+    printf("window stack subtract, damage union/intersect/subtract: "
+           "%.1f us\n", (double) ops / BENCH_RUNS);
+
+    RegionUninit(&result);
+    RegionDestroy(rw);
+    RegionDestroy(rd);
+}
+
+int
+main(int argc, char **argv)
+{
+    InitRegions();
+    srand(0);
+
+    region_from_rects();
+    region_ops();
+    region_append_validate();
+    if (run_benchmarks(argc, argv))
+        region_bench();
+
+    return 0;
+}
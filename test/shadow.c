@@ -0,0 +1,212 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "misc.h"
+#include "scrnintstr.h"
+#include "regionstr.h"
+#include "pixmapstr.h"
+#include "shadow.h"
+#include "shrotblock.h"
+#include "tests-common.h"
+
+#define SHA_WIDTH   1920
+#define SHA_HEIGHT  1080
+#define BENCH_FRAMES 20
+
+static ScreenRec screen;
+static PixmapPtr shadow;
+static DamageRec damage;
+static shadowBufRec buf;
+static CARD8 *framebuffer;
+static int fb_stride;
+
+static const char *kernel_names[] = {
+    [SHADOW_ROTATE_KERNEL_NONE] = "per-pixel",
+    [SHADOW_ROTATE_KERNEL_SCALAR] = "blocked",
+    [SHADOW_ROTATE_KERNEL_SSE2] = "blocked sse2",
+    [SHADOW_ROTATE_KERNEL_NEON] = "blocked neon",
+};
+
+static void *
+window_linear(ScreenPtr pScreen, CARD32 row, CARD32 offset, int mode,
+              CARD32 *size, void *closure)
+{
+    *size = fb_stride - offset;
+    return framebuffer + row * fb_stride + offset;
+}
+
+/*
+ * A window that only maps 40 bytes at a time, like a banked frame
+ * buffer would.
+ */
+static void *
+window_banked(ScreenPtr pScreen, CARD32 row, CARD32 offset, int mode,
+              CARD32 *size, void *closure)
+{
+    *size = min(40, fb_stride - offset);
+    return framebuffer + row * fb_stride + offset;
+}
+
+static void
+shadow_init(int bpp)
+{
+    CARD32 *bits;
+    int i, n;
+
+    test_screen_init(&screen);
+    screen.width = SHA_WIDTH;
+    screen.height = SHA_HEIGHT;
+
+    if (shadow)
+        test_pixmap_destroy(shadow);
+    shadow = test_pixmap_create(&screen, SHA_WIDTH, SHA_HEIGHT,
+                                bpp == 32 ? 24 : 16, bpp);
+    n = shadow->devKind * SHA_HEIGHT / 4;
+    bits = shadow->devPrivate.ptr;
+    for (i = 0; i < n; i++)
+        bits[i] = i * 2654435761u;
+
+    free(framebuffer);
+    fb_stride = SHA_HEIGHT * bpp / 8;
+    framebuffer = malloc(fb_stride * SHA_WIDTH);
+    assert(framebuffer);
+
+    memset(&damage, 0, sizeof(damage));
+    RegionNull(&damage.damage);
+
+    memset(&buf, 0, sizeof(buf));
+    buf.pDamage = &damage;
+    buf.pPixmap = shadow;
+    buf.window = window_linear;
+}
+
+static void
+run_update(ShadowUpdateProc update, ShadowRotateKernel kernel, BoxPtr box)
+{
+    assert(shadowRotateSetKernel(kernel));
+    RegionReset(&damage.damage, box);
+    memset(framebuffer, 0x5a, fb_stride * SHA_WIDTH);
+    (*update) (&screen, &buf);
+}
+
+/**
+ * Every kernel produces the same frame buffer contents as the per-pixel
+ * loops, for whole-screen and odd-sized damage, through linear and
+ * banked windows.
+ */
+static void
+shadow_rotate_exact(int randr, ShadowUpdateProc rotate,
+                    ShadowUpdateProc rotateYX)
+{
+    BoxRec boxes[] = {
+        {0, 0, SHA_WIDTH, SHA_HEIGHT},
+        {3, 5, 517, 301},
+        {SHA_WIDTH - 13, SHA_HEIGHT - 7, SHA_WIDTH, SHA_HEIGHT},
+        {10, 10, 11, 13},
+    };
+    ShadowWindowProc windows[] = { window_linear, window_banked };
+    ShadowUpdateProc updates[] = { shadowUpdateRotatePacked, rotate, rotateYX };
+    size_t size = fb_stride * SHA_WIDTH;
+    CARD8 *expected = malloc(size);
+    ShadowRotateKernel kernel;
+    int i, u, w;
+
+    assert(expected);
+    buf.randr = randr;
+    for (w = 0; w < ARRAY_SIZE(windows); w++) {
+        buf.window = windows[w];
+        for (i = 0; i < ARRAY_SIZE(boxes); i++) {
+            for (u = 0; u < ARRAY_SIZE(updates); u++) {
+                /* the YX updates assume a linear frame buffer */
+                if (!updates[u] || (u == 2 && w > 0))
+                    continue;
+                run_update(updates[u], SHADOW_ROTATE_KERNEL_NONE, &boxes[i]);
+                memcpy(expected, framebuffer, size);
+                for (kernel = SHADOW_ROTATE_KERNEL_SCALAR;
+                     kernel <= SHADOW_ROTATE_KERNEL_NEON; kernel++) {
+                    if (!shadowRotateSetKernel(kernel))
+                        continue;
+                    run_update(updates[u], kernel, &boxes[i]);
+                    assert(memcmp(expected, framebuffer, size) == 0);
+                }
+            }
+        }
+    }
+    buf.window = window_linear;
+    free(expected);
+}
+
+static void
+shadow_rotate_bench(int bpp)
+{
+    BoxRec box = { 0, 0, SHA_WIDTH, SHA_HEIGHT };
+    ShadowRotateKernel kernel;
+    CARD64 start, elapsed;
+    int i;
+
+    buf.randr = SHADOW_ROTATE_90;
+    for (kernel = SHADOW_ROTATE_KERNEL_NONE;
+         kernel <= SHADOW_ROTATE_KERNEL_NEON; kernel++) {
+        if (!shadowRotateSetKernel(kernel))
+            continue;
+        run_update(shadowUpdateRotatePacked, kernel, &box);
+        start = GetTimeInMicros();
+        for (i = 0; i < BENCH_FRAMES; i++)
+            (*shadowUpdateRotatePacked) (&screen, &buf);
+        elapsed = GetTimeInMicros() - start;
+        printf("rotate %dx%d %dbpp by 90, %s: %.2f ms/frame\n",
+               SHA_WIDTH, SHA_HEIGHT, bpp, kernel_names[kernel],
+               elapsed / 1000.0 / BENCH_FRAMES);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    ShadowRotateKernel best = shadowRotateGetKernel();
+    Bool bench = run_benchmarks(argc, argv);
+
+    shadow_init(16);
+    shadow_rotate_exact(SHADOW_ROTATE_90, shadowUpdateRotate16_90,
+                        shadowUpdateRotate16_90YX);
+    shadow_rotate_exact(SHADOW_ROTATE_270, shadowUpdateRotate16_270,
+                        shadowUpdateRotate16_270YX);
+    if (bench)
+        shadow_rotate_bench(16);
+
+    shadow_init(32);
+    shadow_rotate_exact(SHADOW_ROTATE_90, shadowUpdateRotate32_90, NULL);
+    shadow_rotate_exact(SHADOW_ROTATE_270, shadowUpdateRotate32_270, NULL);
+    if (bench)
+        shadow_rotate_bench(32);
+
+    assert(shadowRotateSetKernel(best));
+    return 0;
+}
@@ -0,0 +1,330 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE
+ *  OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "misc.h"
+#include "dix.h"
+#include "windowstr.h"
+#include "inputstr.h"
+#include "mi.h"
+#include "tests-common.h"
+
+#define SCREEN_WIDTH    1920
+#define SCREEN_HEIGHT   1080
+
+#define WIDE_TOPLEVELS  600
+#define DEEP_LEVELS     40
+#define DEEP_SIBLINGS   40
+
+#define CHECK_MOTIONS   20000
+#define BENCH_MOTIONS   200000
+
+static WindowPtr
+make_window(WindowPtr parent, int x, int y, int w, int h, Bool mapped)
+{
+    WindowPtr pWin = calloc(1, sizeof(WindowRec));
+
+    assert(pWin);
+    pWin->drawable.type = DRAWABLE_WINDOW;
+    pWin->drawable.x = x;
+    pWin->drawable.y = y;
+    pWin->drawable.width = w;
+    pWin->drawable.height = h;
+    pWin->cursorIsNone = TRUE;
+    pWin->mapped = mapped;
+    pWin->realized = mapped && (!parent || parent->realized);
+    pWin->parent = parent;
+
+    if (!parent) {
+        pWin->optional = calloc(1, sizeof(WindowOptRec));
+        assert(pWin->optional);
+    }
+    else {
+        /* new windows go on top */
+        pWin->nextSib = parent->firstChild;
+        if (parent->firstChild)
+            parent->firstChild->prevSib = pWin;
+        else
+            parent->lastChild = pWin;
+        parent->firstChild = pWin;
+    }
+    return pWin;
+}
+
+static void
+free_tree(WindowPtr pWin)
+{
+    WindowPtr pChild, pNext;
+
+    for (pChild = pWin->firstChild; pChild; pChild = pNext) {
+        pNext = pChild->nextSib;
+        free_tree(pChild);
+    }
+    if (pWin->optional) {
+        free(pWin->optional->pickIndex);
+        free(pWin->optional);
+    }
+    free(pWin);
+}
+
+static void
+init_sprite(SpritePtr sprite, WindowPtr root)
+{
+    memset(sprite, 0, sizeof(*sprite));
+    sprite->spriteTraceSize = 10;
+    sprite->spriteTrace = calloc(sprite->spriteTraceSize, sizeof(WindowPtr));
+    assert(sprite->spriteTrace);
+    sprite->spriteTrace[0] = root;
+    sprite->spriteTraceGood = 1;
+}
+
+/**
+ * What miSpriteTrace did before it learnt to index wide parents: test
+ * every sibling front to back and descend into the first hit.
+ */
+static WindowPtr
+linear_trace(SpritePtr sprite, int x, int y)
+{
+    WindowPtr pWin;
+
+    sprite->spriteTraceGood = 1;
+    pWin = sprite->spriteTrace[0]->firstChild;
+    while (pWin) {
+        if (pWin->mapped &&
+            x >= pWin->drawable.x - (int) pWin->borderWidth &&
+            x < pWin->drawable.x + (int) pWin->drawable.width +
+            (int) pWin->borderWidth &&
+            y >= pWin->drawable.y - (int) pWin->borderWidth &&
+            y < pWin->drawable.y + (int) pWin->drawable.height +
+            (int) pWin->borderWidth) {
+            if (sprite->spriteTraceGood >= sprite->spriteTraceSize) {
+                sprite->spriteTraceSize += 10;
+                sprite->spriteTrace = realloc(sprite->spriteTrace,
+                                              sprite->spriteTraceSize *
+                                              sizeof(WindowPtr));
+            }
+            sprite->spriteTrace[sprite->spriteTraceGood++] = pWin;
+            pWin = pWin->firstChild;
+        }
+        else
+            pWin = pWin->nextSib;
+    }
+    return sprite->spriteTrace[sprite->spriteTraceGood - 1];
+}
+
+/* a desktop, hundreds of toplevels with a few children each, some unmapped */
+static WindowPtr
+make_wide_tree(void)
+{
+    WindowPtr root = make_window(NULL, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT,
+                                 TRUE);
+    WindowPtr top;
+    int i, j, w, h;
+
+    make_window(root, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, TRUE);
+    for (i = 0; i < WIDE_TOPLEVELS; i++) {
+        w = 20 + rand() % 400;
+        h = 20 + rand() % 300;
+        top = make_window(root, rand() % SCREEN_WIDTH - 40,
+                          rand() % SCREEN_HEIGHT - 40, w, h,
+                          rand() % 10 != 0);
+        top->borderWidth = rand() % 3;
+        for (j = 0; j < 3; j++)
+            make_window(top, top->drawable.x + rand() % w,
+                        top->drawable.y + rand() % h, 10 + rand() % 40,
+                        10 + rand() % 40, TRUE);
+    }
+    return root;
+}
+
+/* nested windows, each level also holding a crowd of small siblings */
+static WindowPtr
+make_deep_tree(void)
+{
+    WindowPtr root = make_window(NULL, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT,
+                                 TRUE);
+    WindowPtr parent = root;
+    int i, j;
+
+    for (i = 0; i < DEEP_LEVELS; i++) {
+        WindowPtr child = make_window(parent, parent->drawable.x + 4,
+                                      parent->drawable.y + 4,
+                                      parent->drawable.width - 8,
+                                      parent->drawable.height - 8, TRUE);
+
+        for (j = 0; j < DEEP_SIBLINGS; j++)
+            make_window(parent, rand() % SCREEN_WIDTH, rand() % SCREEN_HEIGHT,
+                        5 + rand() % 30, 5 + rand() % 30, TRUE);
+        parent = child;
+    }
+    return root;
+}
+
+static void
+compare_traces(WindowPtr root)
+{
+    SpriteRec expect, got;
+    int i, x, y;
+
+    init_sprite(&expect, root);
+    init_sprite(&got, root);
+    for (i = 0; i < CHECK_MOTIONS; i++) {
+        x = rand() % SCREEN_WIDTH;
+        y = rand() % SCREEN_HEIGHT;
+        assert(linear_trace(&expect, x, y) == miXYToWindow(NULL, &got, x, y));
+        assert(expect.spriteTraceGood == got.spriteTraceGood);
+        assert(memcmp(expect.spriteTrace, got.spriteTrace,
+                      got.spriteTraceGood * sizeof(WindowPtr)) == 0);
+    }
+    free(expect.spriteTrace);
+    free(got.spriteTrace);
+}
+
+/* move, restack and unmap some toplevels the way ConfigureWindow would */
+static void
+shuffle_toplevels(WindowPtr root)
+{
+    WindowPtr pWin, pNext;
+
+    for (pWin = root->firstChild; pWin; pWin = pNext) {
+        pNext = pWin->nextSib;
+        switch (rand() % 8) {
+        case 0:
+            pWin->drawable.x += 50;
+            break;
+        case 1:
+            pWin->mapped = !pWin->mapped;
+            break;
+        case 2:
+            /* raise */
+            if (pWin->prevSib) {
+                pWin->prevSib->nextSib = pWin->nextSib;
+                if (pWin->nextSib)
+                    pWin->nextSib->prevSib = pWin->prevSib;
+                else
+                    root->lastChild = pWin->prevSib;
+                pWin->prevSib = NULL;
+                pWin->nextSib = root->firstChild;
+                root->firstChild->prevSib = pWin;
+                root->firstChild = pWin;
+            }
+            break;
+        }
+    }
+    WindowsRestructured();
+}
+
+/**
+ * Picking through the index must find exactly what walking every sibling
+ * finds, also right after windows were moved, restacked or unmapped.
+ */
+static void
+spritetrace_index(void)
+{
+    WindowPtr wide = make_wide_tree();
+    WindowPtr deep = make_deep_tree();
+    int i;
+
+    compare_traces(wide);
+    compare_traces(deep);
+    assert(wide->optional->pickIndex);
+    assert(deep->optional->pickIndex);
+
+    for (i = 0; i < 4; i++) {
+        shuffle_toplevels(wide);
+        compare_traces(wide);
+    }
+
+    free_tree(wide);
+    free_tree(deep);
+}
+
+static void
+bench_tree(const char *name, WindowPtr root)
+{
+    SpriteRec sprite;
+    CARD64 start, linear, indexed;
+    int *xs = malloc(BENCH_MOTIONS * sizeof(int));
+    int *ys = malloc(BENCH_MOTIONS * sizeof(int));
+    int i;
+
+    assert(xs && ys);
+    /* a pointer wandering across the screen */
+    xs[0] = SCREEN_WIDTH / 2;
+    ys[0] = SCREEN_HEIGHT / 2;
+    for (i = 1; i < BENCH_MOTIONS; i++) {
+        xs[i] = (xs[i - 1] + rand() % 21 - 10 + SCREEN_WIDTH) % SCREEN_WIDTH;
+        ys[i] = (ys[i - 1] + rand() % 21 - 10 + SCREEN_HEIGHT) % SCREEN_HEIGHT;
+    }
+
+    init_sprite(&sprite, root);
+    start = GetTimeInMicros();
+    for (i = 0; i < BENCH_MOTIONS; i++)
+        linear_trace(&sprite, xs[i], ys[i]);
+    linear = GetTimeInMicros() - start;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < BENCH_MOTIONS; i++)
+        miXYToWindow(NULL, &sprite, xs[i], ys[i]);
+    indexed = GetTimeInMicros() - start;
+
+    printf("XYToWindow %s tree: sibling walk %.1f ns/motion, "
+           "indexed %.1f ns/motion\n", name,
+           linear * 1000.0 / BENCH_MOTIONS, indexed * 1000.0 / BENCH_MOTIONS);
+
+    free(sprite.spriteTrace);
+    free(xs);
+    free(ys);
+}
+
+static void
+spritetrace_bench(void)
+{
+    WindowPtr wide = make_wide_tree();
+    WindowPtr deep = make_deep_tree();
+
+    bench_tree("wide", wide);
+    bench_tree("deep", deep);
+
+    free_tree(wide);
+    free_tree(deep);
+}
+
+int
+main(int argc, char **argv)
+{
+    srand(0);
+
+    spritetrace_index();
+    if (run_benchmarks(argc, argv))
+        spritetrace_bench();
+
+    return 0;
+}
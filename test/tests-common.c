@@ -0,0 +1,80 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tests-common.h"
+
+Bool
+run_benchmarks(int argc, char **argv)
+{
+    int i;
+
+    for (i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--bench") == 0)
+            return TRUE;
+    return FALSE;
+}
+
+void
+test_screen_init(ScreenPtr pScreen)
+{
+    memset(pScreen, 0, sizeof(*pScreen));
+    screenInfo.numScreens = 1;
+    screenInfo.screens[0] = pScreen;
+}
+
+PixmapPtr
+test_pixmap_create(ScreenPtr pScreen, int width, int height, int depth,
+                   int bpp)
+{
+    PixmapPtr pixmap = calloc(1, sizeof(PixmapRec));
+    int stride = ((width * bpp + 31) / 32) * 4;
+    void *bits = calloc(height, stride);
+
+    assert(pixmap && bits);
+    pixmap->drawable.type = DRAWABLE_PIXMAP;
+    pixmap->drawable.depth = depth;
+    pixmap->drawable.bitsPerPixel = bpp;
+    pixmap->drawable.width = width;
+    pixmap->drawable.height = height;
+    pixmap->drawable.pScreen = pScreen;
+    pixmap->drawable.serialNumber = NEXT_SERIAL_NUMBER;
+    pixmap->refcnt = 1;
+    pixmap->devKind = stride;
+    pixmap->devPrivate.ptr = bits;
+    return pixmap;
+}
+
+void
+test_pixmap_destroy(PixmapPtr pixmap)
+{
+    free(pixmap->devPrivate.ptr);
+    free(pixmap);
+}
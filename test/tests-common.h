@@ -0,0 +1,44 @@
+/**
+ * Copyright © 2026 agent <agent@local>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef TESTS_COMMON_H
+#define TESTS_COMMON_H
+
+#include "misc.h"
+#include "scrnintstr.h"
+#include "pixmapstr.h"
+
+/* Timing runs are slow and machine dependent, so make check skips them.
+ * Run a test as "test --bench" to get its numbers. */
+extern Bool run_benchmarks(int argc, char **argv);
+
+/* Clear pScreen and make it the only screen */
+extern void test_screen_init(ScreenPtr pScreen);
+
+/* A pixmap on pScreen with zeroed bits, without going through the DDX */
+extern PixmapPtr test_pixmap_create(ScreenPtr pScreen, int width, int height,
+                                    int depth, int bpp);
+extern void test_pixmap_destroy(PixmapPtr pixmap);
+
+#endif                          /* TESTS_COMMON_H */
@@ -26,17 +26,69 @@
 #endif
 
 #include <stdint.h>
+#include <stdlib.h>
 #include "inputstr.h"
 #include "assert.h"
 #include "scrnintstr.h"
 
+/**
+ * The map must agree with a plain array of ids through adds, removes,
+ * colliding ids and growing.
+ */
+static void
+touch_id_map(void)
+{
+    TouchIdMapRec map;
+    uint32_t ids[64];
+    int i, j, n = 0;
+
+    memset(&map, 0, sizeof(map));
+    /* an empty map finds nothing and ignores changes */
+    TouchIdMapAdd(&map, 1, 0);
+    assert(TouchIdMapFind(&map, 1) == -1);
+    TouchIdMapRemove(&map, 1);
+
+    assert(TouchIdMapInit(&map, 4));
+    for (i = 0; i < 20000; i++) {
+        /* multiples of 64 share their low bits */
+        uint32_t id = (rand() % 2) ? rand() % 200 : (rand() % 50) * 64;
+
+        for (j = 0; j < n && ids[j] != id; j++);
+        if (j < n) {
+            assert(TouchIdMapFind(&map, id) == j);
+            TouchIdMapRemove(&map, id);
+            ids[j] = ids[--n];
+            /* the moved id keeps its old index in the map */
+            if (j < n) {
+                TouchIdMapRemove(&map, ids[j]);
+                TouchIdMapAdd(&map, ids[j], j);
+            }
+        }
+        else if (n < 64) {
+            assert(TouchIdMapFind(&map, id) == -1);
+            TouchIdMapAdd(&map, id, n);
+            ids[n++] = id;
+        }
+        assert(map.count == n);
+        for (j = 0; j < n; j++)
+            assert(TouchIdMapFind(&map, ids[j]) == j);
+    }
+    TouchIdMapFree(&map);
+    assert(!map.slots);
+}
+
+/**
+ * A touch beyond the DDX touches is dropped, the work proc then grows
+ * them and rebuilds the id map so the next one fits.
+ */
 static void
-touch_grow_queue(void)
+touch_grow_pool(void)
 {
     DeviceIntRec dev;
     ValuatorClassRec val;
     TouchClassRec touch;
-    size_t size, new_size;
+    DDXTouchPointInfoPtr ti;
+    int size = 10, new_size = size + size / 2 + 1;
     int i;
 
     memset(&dev, 0, sizeof(dev));
@@ -44,45 +96,54 @@ touch_grow_queue(void)
     dev.id = 2;
     dev.valuator = &val;
     val.numAxes = 5;
+    memset(&touch, 0, sizeof(touch));
+    touch.mode = XIDirectTouch;
     dev.touch = &touch;
     inputInfo.devices = &dev;
 
-    size = 5;
-
     dev.last.num_touches = size;
     dev.last.touches = calloc(dev.last.num_touches, sizeof(*dev.last.touches));
     assert(dev.last.touches);
+    assert(TouchIdMapInit(&dev.last.touch_ids, size));
+
     for (i = 0; i < size; i++) {
-        dev.last.touches[i].active = TRUE;
-        dev.last.touches[i].ddx_id = i;
-        dev.last.touches[i].client_id = i * 2;
+        ti = TouchFindByDDXID(&dev, 1000 + i * 7, TRUE);
+        assert(ti == &dev.last.touches[i]);
+        assert(ti->emulate_pointer == (i == 0));
     }
 
     /* no more space, should've scheduled a workproc */
     assert(TouchBeginDDXTouch(&dev, 1234) == NULL);
     ProcessWorkQueue();
-
-    new_size = size + size / 2 + 1;
     assert(dev.last.num_touches == new_size);
 
-    /* make sure we haven't touched those */
-    for (i = 0; i < size; i++) {
-        DDXTouchPointInfoPtr t = &dev.last.touches[i];
+    /* the map was rebuilt big enough not to grow in the signal handler */
+    assert(dev.last.touch_ids.slots);
+    assert(dev.last.touch_ids.count == size);
+    assert(dev.last.touch_ids.mask + 1 >= 2 * new_size);
+    for (i = 0; i < size; i++)
+        assert(TouchFindByDDXID(&dev, 1000 + i * 7, FALSE) ==
+               &dev.last.touches[i]);
 
-        assert(t->active == TRUE);
-        assert(t->ddx_id == i);
-        assert(t->client_id == i * 2);
-    }
+    /* the dropped touch fits now */
+    ti = TouchFindByDDXID(&dev, 1234, TRUE);
+    assert(ti == &dev.last.touches[size]);
+    assert(!ti->emulate_pointer);
+    assert(TouchFindByDDXID(&dev, 1234, FALSE) == ti);
 
-    /* make sure those are zero-initialized */
-    for (i = size; i < new_size; i++) {
-        DDXTouchPointInfoPtr t = &dev.last.touches[i];
+    /* lift a finger, put one down */
+    TouchEndDDXTouch(&dev, &dev.last.touches[3]);
+    assert(TouchFindByDDXID(&dev, 1000 + 3 * 7, FALSE) == NULL);
+    ti = TouchFindByDDXID(&dev, 4321, TRUE);
+    assert(ti == &dev.last.touches[3]);
+    assert(TouchFindByDDXID(&dev, 4321, FALSE) == ti);
 
-        assert(t->active == FALSE);
-        assert(t->client_id == 0);
-        assert(t->ddx_id == 0);
-    }
+    for (i = 0; i < new_size; i++)
+        TouchEndDDXTouch(&dev, &dev.last.touches[i]);
+    assert(dev.last.touch_ids.count == 0);
 
+    TouchIdMapFree(&dev.last.touch_ids);
+    free(dev.last.touches);
     free(dev.name);
 }
 
@@ -148,11 +209,17 @@ touch_find_ddxid(void)
     dev.last.touches[2].active = FALSE;
     ti = TouchFindByDDXID(&dev, 30, TRUE);
     assert(ti == &dev.last.touches[2]);
-    /* but still grow anyway */
+
+    /* the workproc grew it outside the signal handler */
     ProcessWorkQueue();
+    assert(dev.last.num_touches == size + size / 2 + 1);
+    assert(TouchFindByDDXID(&dev, 30, FALSE) == &dev.last.touches[2]);
     ti = TouchFindByDDXID(&dev, 40, TRUE);
     assert(ti == &dev.last.touches[size]);
+    assert(TouchFindByDDXID(&dev, 40, FALSE) == ti);
 
+    TouchIdMapFree(&dev.last.touch_ids);
+    free(dev.last.touches);
     free(dev.name);
 }
 
@@ -279,7 +346,8 @@ touch_init(void)
 int
 main(int argc, char **argv)
 {
-    touch_grow_queue();
+    touch_id_map();
+    touch_grow_pool();
     touch_find_ddxid();
     touch_begin_ddxtouch();
     touch_init();
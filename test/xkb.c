@@ -163,12 +163,63 @@ xkb_set_get_rules_test(void)
     assert(strcmp(rmlvo.options, rmlvo_backup.options) == 0);
 }
 
+/**
+ * Copy a keymap with a geometry into another one.
+ * Free the source, then replace the geometry of a third copy.
+ *
+ * Result: the copies share one geometry, which lives until the last
+ * keymap using it is freed and is not affected by the replacement.
+ */
+static void
+xkb_geometry_sharing_test(void)
+{
+    XkbDescPtr a = XkbAllocKeyboard();
+    XkbDescPtr b = XkbAllocKeyboard();
+    XkbDescPtr c = XkbAllocKeyboard();
+    XkbGeometrySizesRec sizes = {
+        .which = XkbGeomAllMask,
+        .num_properties = 1,
+    };
+    XkbGeometryPtr geom;
+
+    assert(a && b && c);
+    assert(XkbAllocGeometry(a, &sizes) == Success);
+    geom = a->geom;
+    assert(XkbAddGeomProperty(geom, "type", "test"));
+
+    assert(XkbCopyKeymap(b, a));
+    assert(XkbCopyKeymap(c, a));
+    assert(b->geom == geom);
+    assert(c->geom == geom);
+
+    XkbFreeKeyboard(a, XkbAllComponentsMask, TRUE);
+    assert(b->geom->num_properties == 1);
+    assert(strcmp(b->geom->properties[0].value, "test") == 0);
+
+    /* what SetGeometry does: free the old one, allocate a new one */
+    XkbFreeGeometry(c->geom, XkbGeomAllMask, TRUE);
+    c->geom = NULL;
+    assert(XkbAllocGeometry(c, &sizes) == Success);
+    assert(c->geom != geom);
+    assert(b->geom == geom);
+    assert(strcmp(b->geom->properties[0].value, "test") == 0);
+
+    /* b held the last reference to the original geometry */
+    assert(XkbCopyKeymap(b, c));
+    assert(b->geom == c->geom);
+
+    XkbFreeKeyboard(b, XkbAllComponentsMask, TRUE);
+    assert(c->geom->num_properties == 0);
+    XkbFreeKeyboard(c, XkbAllComponentsMask, TRUE);
+}
+
 int
 main(int argc, char **argv)
 {
     xkb_set_get_rules_test();
     xkb_get_rules_test();
     xkb_set_rules_test();
+    xkb_geometry_sharing_test();
 
     return 0;
 }
@@ -352,6 +352,12 @@ XkbFreeGeometry(XkbGeometryPtr geom, unsigned which, Bool freeMap)
 {
     if (geom == NULL)
         return;
+    if (geom->refcnt > 1) {
+        /* still in use by another keymap, which may not lose parts */
+        BUG_RETURN(!freeMap);
+        geom->refcnt--;
+        return;
+    }
     if (freeMap)
         which = XkbGeomAllMask;
     if ((which & XkbGeomPropertiesMask) && (geom->properties != NULL))
@@ -377,6 +383,17 @@ XkbFreeGeometry(XkbGeometryPtr geom, unsigned which, Bool freeMap)
     return;
 }
 
+/**
+ * Take another reference to geom, to be dropped with XkbFreeGeometry.
+ */
+XkbGeometryPtr
+XkbRefGeometry(XkbGeometryPtr geom)
+{
+    if (geom)
+        geom->refcnt = max(geom->refcnt, 1) + 1;
+    return geom;
+}
+
 /***====================================================================***/
 
 /**
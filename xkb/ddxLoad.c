@@ -32,6 +32,11 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include <stdio.h>
 #include <ctype.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#endif
 #include <X11/X.h>
 #include <X11/Xos.h>
 #include <X11/Xproto.h>
@@ -44,6 +49,7 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <xkbsrv.h>
 #include <X11/extensions/XI.h>
 #include "xkb.h"
+#include "xsha1.h"
 
         /*
          * If XKM_OUTPUT_DIR specifies a path without a leading slash, it is
@@ -69,7 +75,8 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #endif
 
 static unsigned
-LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn);
+LoadXKM(unsigned want, unsigned need, const char *keymap, Bool keep,
+        XkbDescPtr *xkbRtrn);
 
 static void
 OutputDirectory(char *outdir, size_t size)
@@ -292,40 +299,46 @@ XkbDDXLoadKeymapFromString(DeviceIntPtr keybd,
         return 0;
     }
 
-    have = LoadXKM(want, need, map_name, xkbRtrn);
+    have = LoadXKM(want, need, map_name, FALSE, xkbRtrn);
     free(map_name);
 
     return have;
 }
 
-static FILE *
-XkbDDXOpenConfigFile(const char *mapName, char *fileNameRtrn, int fileNameRtrnLen)
+static void
+XkbDDXXkmPath(const char *mapName, char *buf, int bufLen)
 {
-    char buf[PATH_MAX], xkm_output_dir[PATH_MAX];
-    FILE *file;
+    char xkm_output_dir[PATH_MAX];
 
     buf[0] = '\0';
-    if (mapName != NULL) {
-        OutputDirectory(xkm_output_dir, sizeof(xkm_output_dir));
-        if ((XkbBaseDirectory != NULL) && (xkm_output_dir[0] != '/')
+    if (mapName == NULL)
+        return;
+    OutputDirectory(xkm_output_dir, sizeof(xkm_output_dir));
+    if ((XkbBaseDirectory != NULL) && (xkm_output_dir[0] != '/')
 #ifdef WIN32
-            && (!isalpha(xkm_output_dir[0]) || xkm_output_dir[1] != ':')
+        && (!isalpha(xkm_output_dir[0]) || xkm_output_dir[1] != ':')
 #endif
-            ) {
-            if (snprintf(buf, PATH_MAX, "%s/%s%s.xkm", XkbBaseDirectory,
-                         xkm_output_dir, mapName) >= PATH_MAX)
-                buf[0] = '\0';
-        }
-        else {
-            if (snprintf(buf, PATH_MAX, "%s%s.xkm", xkm_output_dir, mapName)
-                >= PATH_MAX)
-                buf[0] = '\0';
-        }
-        if (buf[0] != '\0')
-            file = fopen(buf, "rb");
-        else
-            file = NULL;
+        ) {
+        if (snprintf(buf, bufLen, "%s/%s%s.xkm", XkbBaseDirectory,
+                     xkm_output_dir, mapName) >= bufLen)
+            buf[0] = '\0';
+    }
+    else {
+        if (snprintf(buf, bufLen, "%s%s.xkm", xkm_output_dir, mapName)
+            >= bufLen)
+            buf[0] = '\0';
     }
+}
+
+static FILE *
+XkbDDXOpenConfigFile(const char *mapName, char *fileNameRtrn, int fileNameRtrnLen)
+{
+    char buf[PATH_MAX];
+    FILE *file;
+
+    XkbDDXXkmPath(mapName, buf, sizeof(buf));
+    if (buf[0] != '\0')
+        file = fopen(buf, "rb");
     else
         file = NULL;
     if ((fileNameRtrn != NULL) && (fileNameRtrnLen > 0)) {
@@ -334,8 +347,13 @@ XkbDDXOpenConfigFile(const char *mapName, char *fileNameRtrn, int fileNameRtrnLe
     return file;
 }
 
+/**
+ * Read the compiled keymap back in.  The file is removed afterwards unless
+ * keep is set, in which case it is only removed if it fails to load.
+ */
 static unsigned
-LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn)
+LoadXKM(unsigned want, unsigned need, const char *keymap, Bool keep,
+        XkbDescPtr *xkbRtrn)
 {
     FILE *file;
     char fileName[PATH_MAX];
@@ -359,10 +377,273 @@ LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn)
                (*xkbRtrn)->defined);
     }
     fclose(file);
-    (void) unlink(fileName);
+    if (!keep)
+        (void) unlink(fileName);
     return (need | want) & (~missing);
 }
 
+#ifndef WIN32
+/*
+ * Compiled keymaps are kept in XKM_OUTPUT_DIR as server-<sha1>.xkm, so
+ * that a server starting up or a keyboard being plugged in with the same
+ * configuration as before does not have to run xkbcomp again.
+ *
+ * The hash covers everything that decides what xkbcomp produces: the
+ * component names the rules picked for the RMLVO, the requested
+ * components, the xkm format, and the modification times of the xkb data
+ * directories and of the xkbcomp binary.  Installing new xkb data or a
+ * new xkbcomp therefore misses the cache.  Editing a data file in place
+ * does not change its directory; touch the directory afterwards.
+ *
+ * The cache is only used when XKM_OUTPUT_DIR is a real directory owned
+ * by the server that nobody else can write to, and entries are opened
+ * without following symlinks.  Each hit refreshes an entry's mtime;
+ * entries unused for XKB_CACHE_MAX_AGE are removed whenever a new one
+ * is stored.
+ */
+#define XKB_CACHE_MAX_AGE	(30 * 24 * 60 * 60)
+#define XKB_CACHE_NAME_LEN	(sizeof("server-") - 1 + 40)
+
+static const char *xkb_cache_subdirs[] = {
+    "", "/rules", "/keycodes", "/types", "/compat", "/symbols", "/geometry"
+};
+
+static Bool
+XkbHashStat(void *ctx, const char *path)
+{
+    struct stat st;
+    struct {
+        dev_t dev;
+        ino_t ino;
+        off_t size;
+        time_t mtime;
+    } key;
+
+    if (stat(path, &st) != 0)
+        return FALSE;
+    memset(&key, 0, sizeof(key));
+    key.dev = st.st_dev;
+    key.ino = st.st_ino;
+    key.size = st.st_size;
+    key.mtime = st.st_mtime;
+    return x_sha1_update(ctx, &key, sizeof(key));
+}
+
+static Bool
+XkbHashString(void *ctx, const char *str)
+{
+    /* include the terminator so "ab","c" and "a","bc" differ */
+    if (!str)
+        return x_sha1_update(ctx, (void *) "\377", 1);
+    return x_sha1_update(ctx, (void *) str, strlen(str) + 1);
+}
+
+/* Where XkbDDXXkmPath puts the cache, without the trailing separator */
+static Bool
+XkbCacheDirectory(char *buf, int bufLen)
+{
+    char outdir[PATH_MAX];
+    int len;
+
+    OutputDirectory(outdir, sizeof(outdir));
+    if (strcmp(outdir, XKM_OUTPUT_DIR) != 0)
+        return FALSE;
+    if (outdir[0] != '/')
+        len = snprintf(buf, bufLen, "%s/%s", XkbBaseDirectory, outdir);
+    else
+        len = snprintf(buf, bufLen, "%s", outdir);
+    if (len <= 0 || len >= bufLen)
+        return FALSE;
+    while (len > 1 && buf[len - 1] == '/')
+        buf[--len] = '\0';
+    return TRUE;
+}
+
+/* Only cache where nobody else can write; /tmp is shared. */
+static Bool
+XkbCacheDirectorySafe(void)
+{
+    char dir[PATH_MAX];
+    struct stat st;
+
+    if (!XkbCacheDirectory(dir, sizeof(dir)) || lstat(dir, &st) != 0)
+        return FALSE;
+    return S_ISDIR(st.st_mode) && st.st_uid == geteuid() &&
+        !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+static Bool
+XkbIsCacheEntry(const char *name)
+{
+    int i;
+
+    if (strncmp(name, "server-", strlen("server-")) != 0 ||
+        strlen(name) != XKB_CACHE_NAME_LEN + strlen(".xkm") ||
+        strcmp(name + XKB_CACHE_NAME_LEN, ".xkm") != 0)
+        return FALSE;
+    for (i = strlen("server-"); i < XKB_CACHE_NAME_LEN; i++)
+        if (!isxdigit((unsigned char) name[i]))
+            return FALSE;
+    return TRUE;
+}
+
+/* Remove our cache entries that have not been used for a while. */
+static void
+XkbPruneKeymapCache(void)
+{
+    char dir[PATH_MAX], path[PATH_MAX];
+    struct dirent *ent;
+    struct stat st;
+    time_t now;
+    DIR *d;
+
+    if (!XkbCacheDirectory(dir, sizeof(dir)) || !(d = opendir(dir)))
+        return;
+    now = time(NULL);
+    while ((ent = readdir(d))) {
+        if (!XkbIsCacheEntry(ent->d_name))
+            continue;
+        if (snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name) >=
+            sizeof(path))
+            continue;
+        if (lstat(path, &st) != 0 || !S_ISREG(st.st_mode) ||
+            st.st_uid != geteuid())
+            continue;
+        if (now - st.st_mtime > XKB_CACHE_MAX_AGE) {
+            LogMessageVerb(X_INFO, 4, "XKB: Removing stale cached keymap %s\n",
+                           path);
+            (void) unlink(path);
+        }
+    }
+    closedir(d);
+}
+
+static Bool
+XkbKeymapCacheName(XkbComponentNamesPtr names, unsigned want, unsigned need,
+                   char *nameRtrn, int nameRtrnLen)
+{
+    unsigned char sha1[20];
+    char path[PATH_MAX];
+    unsigned key[3];
+    void *ctx;
+    Bool ok;
+    int i;
+
+    if (XkbBaseDirectory == NULL || XkbBinDirectory == NULL ||
+        !XkbCacheDirectorySafe())
+        return FALSE;
+
+    ctx = x_sha1_init();
+    if (!ctx)
+        return FALSE;
+
+    key[0] = want;
+    key[1] = need;
+    key[2] = XkmFileVersion;
+    ok = x_sha1_update(ctx, key, sizeof(key)) &&
+        XkbHashString(ctx, names->keycodes) &&
+        XkbHashString(ctx, names->types) &&
+        XkbHashString(ctx, names->compat) &&
+        XkbHashString(ctx, names->symbols) &&
+        XkbHashString(ctx, names->geometry) &&
+        XkbHashString(ctx, XkbBaseDirectory);
+
+    for (i = 0; ok && i < ARRAY_SIZE(xkb_cache_subdirs); i++) {
+        snprintf(path, sizeof(path), "%s%s", XkbBaseDirectory,
+                 xkb_cache_subdirs[i]);
+        ok = XkbHashStat(ctx, path);
+    }
+    if (ok) {
+        snprintf(path, sizeof(path), "%s%sxkbcomp", XkbBinDirectory,
+                 PATHSEPARATOR);
+        ok = XkbHashStat(ctx, path);
+    }
+
+    if (!x_sha1_final(ctx, sha1) || !ok)
+        return FALSE;
+
+    if (nameRtrnLen < strlen("server-") + 2 * sizeof(sha1) + 1)
+        return FALSE;
+    strcpy(nameRtrn, "server-");
+    for (i = 0; i < sizeof(sha1); i++)
+        sprintf(nameRtrn + strlen("server-") + 2 * i, "%02x", sha1[i]);
+    return TRUE;
+}
+
+/**
+ * Load a keymap from the cache if there is a usable one.  Entries that
+ * do not provide what we need, fail to parse or are not ours are removed
+ * so that the next compile replaces them.
+ */
+static unsigned
+XkbLoadCachedKeymap(const char *cacheName, unsigned want, unsigned need,
+                    XkbDescPtr *xkbRtrn)
+{
+    char path[PATH_MAX];
+    struct stat st;
+    unsigned provided;
+    FILE *file;
+    int fd;
+
+    XkbDDXXkmPath(cacheName, path, sizeof(path));
+    if (path[0] == '\0')
+        return 0;
+    fd = open(path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_uid != geteuid()) {
+        LogMessage(X_WARNING, "XKB: Ignoring cached keymap %s, "
+                   "not a file owned by the server\n", path);
+        close(fd);
+        return 0;
+    }
+    file = fdopen(fd, "rb");
+    if (!file) {
+        close(fd);
+        return 0;
+    }
+
+    provided = (need | want) & ~XkmReadFile(file, need, want, xkbRtrn);
+    /* keep entries in use from being pruned */
+    if (*xkbRtrn)
+        (void) futimens(fd, NULL);
+    fclose(file);
+    if (*xkbRtrn == NULL) {
+        LogMessage(X_ERROR, "Error loading keymap %s\n", path);
+        (void) unlink(path);
+        return 0;
+    }
+    if ((provided & need) != need) {
+        XkbFreeKeyboard(*xkbRtrn, 0, TRUE);
+        *xkbRtrn = NULL;
+        (void) unlink(path);
+        return 0;
+    }
+    LogMessageVerb(X_INFO, 4, "XKB: Using cached keymap %s\n", path);
+    return provided;
+}
+
+/**
+ * Move a freshly compiled keymap into the cache.  rename() is atomic, so
+ * another server looking at the cache never sees half a file.
+ */
+static Bool
+XkbStoreCachedKeymap(const char *mapName, const char *cacheName)
+{
+    char from[PATH_MAX], to[PATH_MAX];
+
+    XkbDDXXkmPath(mapName, from, sizeof(from));
+    XkbDDXXkmPath(cacheName, to, sizeof(to));
+    if (from[0] == '\0' || to[0] == '\0')
+        return FALSE;
+    if (rename(from, to) != 0)
+        return FALSE;
+    XkbPruneKeymapCache();
+    return TRUE;
+}
+#endif
+
 unsigned
 XkbDDXLoadKeymapByNames(DeviceIntPtr keybd,
                         XkbComponentNamesPtr names,
@@ -371,6 +652,11 @@ XkbDDXLoadKeymapByNames(DeviceIntPtr keybd,
                         XkbDescPtr *xkbRtrn, char *nameRtrn, int nameRtrnLen)
 {
     XkbDescPtr xkb;
+#ifndef WIN32
+    char cacheName[64];
+    Bool cached = FALSE;
+    unsigned provided;
+#endif
 
     *xkbRtrn = NULL;
     if ((keybd == NULL) || (keybd->key == NULL) ||
@@ -385,13 +671,38 @@ XkbDDXLoadKeymapByNames(DeviceIntPtr keybd,
                    keybd->name ? keybd->name : "(unnamed keyboard)");
         return 0;
     }
-    else if (!XkbDDXCompileKeymapByNames(xkb, names, want, need,
-                                         nameRtrn, nameRtrnLen)) {
+
+#ifndef WIN32
+    /* With an existing keymap, xkbcomp's input depends on more than the
+     * names, so only the initial compile for a device goes to the cache */
+    if (xkb == NULL)
+        cached = XkbKeymapCacheName(names, want, need,
+                                    cacheName, sizeof(cacheName));
+    if (cached) {
+        provided = XkbLoadCachedKeymap(cacheName, want, need, xkbRtrn);
+        if (*xkbRtrn) {
+            if (nameRtrn)
+                strlcpy(nameRtrn, cacheName, nameRtrnLen);
+            return provided;
+        }
+    }
+#endif
+
+    if (!XkbDDXCompileKeymapByNames(xkb, names, want, need,
+                                    nameRtrn, nameRtrnLen)) {
         LogMessage(X_ERROR, "XKB: Couldn't compile keymap\n");
         return 0;
     }
 
-    return LoadXKM(want, need, nameRtrn, xkbRtrn);
+#ifndef WIN32
+    if (cached && XkbStoreCachedKeymap(nameRtrn, cacheName)) {
+        if (nameRtrn)
+            strlcpy(nameRtrn, cacheName, nameRtrnLen);
+        return XkbLoadCachedKeymap(cacheName, want, need, xkbRtrn);
+    }
+#endif
+
+    return LoadXKM(want, need, nameRtrn, FALSE, xkbRtrn);
 }
 
 Bool
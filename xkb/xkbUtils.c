@@ -1398,501 +1398,19 @@ _XkbCopyCompat(XkbDescPtr src, XkbDescPtr dst)
     return TRUE;
 }
 
+/*
+ * Geometry is shared rather than copied: it is the largest part of most
+ * keymaps and nothing changes it in place, SetGeometry installs a new one.
+ * Pivoting the master between slaves with the same geometry is then just
+ * a reference count update.
+ */
 static Bool
 _XkbCopyGeom(XkbDescPtr src, XkbDescPtr dst)
 {
-    void *tmp = NULL;
-    int i = 0, j = 0, k = 0;
-    XkbColorPtr scolor = NULL, dcolor = NULL;
-    XkbDoodadPtr sdoodad = NULL, ddoodad = NULL;
-    XkbOutlinePtr soutline = NULL, doutline = NULL;
-    XkbPropertyPtr sprop = NULL, dprop = NULL;
-    XkbRowPtr srow = NULL, drow = NULL;
-    XkbSectionPtr ssection = NULL, dsection = NULL;
-    XkbShapePtr sshape = NULL, dshape = NULL;
-
-    /* geometry */
-    if (src->geom) {
-        if (!dst->geom) {
-            dst->geom = calloc(sizeof(XkbGeometryRec), 1);
-            if (!dst->geom)
-                return FALSE;
-        }
-
-        /* properties */
-        if (src->geom->num_properties) {
-            /* If we've got more properties in the destination than
-             * the source, run through and free all the excess ones
-             * first. */
-            if (src->geom->num_properties < dst->geom->sz_properties) {
-                for (i = src->geom->num_properties, dprop =
-                     dst->geom->properties + i; i < dst->geom->num_properties;
-                     i++, dprop++) {
-                    free(dprop->name);
-                    free(dprop->value);
-                }
-            }
-
-            /* Reallocate and clear all new items if the buffer grows. */
-            if (!XkbGeomRealloc
-                ((void **) &dst->geom->properties, dst->geom->sz_properties,
-                 src->geom->num_properties, sizeof(XkbPropertyRec),
-                 XKB_GEOM_CLEAR_EXCESS))
-                return FALSE;
-            /* We don't set num_properties as we need it to try and avoid
-             * too much reallocing. */
-            dst->geom->sz_properties = src->geom->num_properties;
-
-            for (i = 0,
-                 sprop = src->geom->properties,
-                 dprop = dst->geom->properties;
-                 i < src->geom->num_properties; i++, sprop++, dprop++) {
-                if (i < dst->geom->num_properties) {
-                    if (strlen(sprop->name) != strlen(dprop->name)) {
-                        tmp = realloc(dprop->name, strlen(sprop->name) + 1);
-                        if (!tmp)
-                            return FALSE;
-                        dprop->name = tmp;
-                    }
-                    if (strlen(sprop->value) != strlen(dprop->value)) {
-                        tmp = realloc(dprop->value, strlen(sprop->value) + 1);
-                        if (!tmp)
-                            return FALSE;
-                        dprop->value = tmp;
-                    }
-                    strcpy(dprop->name, sprop->name);
-                    strcpy(dprop->value, sprop->value);
-                }
-                else {
-                    dprop->name = xstrdup(sprop->name);
-                    dprop->value = xstrdup(sprop->value);
-                }
-            }
-
-            /* ... which is already src->geom->num_properties. */
-            dst->geom->num_properties = dst->geom->sz_properties;
-        }
-        else {
-            if (dst->geom->sz_properties) {
-                for (i = 0, dprop = dst->geom->properties;
-                     i < dst->geom->num_properties; i++, dprop++) {
-                    free(dprop->name);
-                    free(dprop->value);
-                }
-                free(dst->geom->properties);
-                dst->geom->properties = NULL;
-            }
-
-            dst->geom->num_properties = 0;
-            dst->geom->sz_properties = 0;
-        }
-
-        /* colors */
-        if (src->geom->num_colors) {
-            if (src->geom->num_colors < dst->geom->sz_colors) {
-                for (i = src->geom->num_colors, dcolor = dst->geom->colors + i;
-                     i < dst->geom->num_colors; i++, dcolor++) {
-                    free(dcolor->spec);
-                }
-            }
-
-            /* Reallocate and clear all new items if the buffer grows. */
-            if (!XkbGeomRealloc
-                ((void **) &dst->geom->colors, dst->geom->sz_colors,
-                 src->geom->num_colors, sizeof(XkbColorRec),
-                 XKB_GEOM_CLEAR_EXCESS))
-                return FALSE;
-            dst->geom->sz_colors = src->geom->num_colors;
-
-            for (i = 0,
-                 scolor = src->geom->colors,
-                 dcolor = dst->geom->colors;
-                 i < src->geom->num_colors; i++, scolor++, dcolor++) {
-                if (i < dst->geom->num_colors) {
-                    if (strlen(scolor->spec) != strlen(dcolor->spec)) {
-                        tmp = realloc(dcolor->spec, strlen(scolor->spec) + 1);
-                        if (!tmp)
-                            return FALSE;
-                        dcolor->spec = tmp;
-                    }
-                    strcpy(dcolor->spec, scolor->spec);
-                }
-                else {
-                    dcolor->spec = xstrdup(scolor->spec);
-                }
-                dcolor->pixel = scolor->pixel;
-            }
-
-            dst->geom->num_colors = dst->geom->sz_colors;
-        }
-        else {
-            if (dst->geom->sz_colors) {
-                for (i = 0, dcolor = dst->geom->colors;
-                     i < dst->geom->num_colors; i++, dcolor++) {
-                    free(dcolor->spec);
-                }
-                free(dst->geom->colors);
-                dst->geom->colors = NULL;
-            }
-
-            dst->geom->num_colors = 0;
-            dst->geom->sz_colors = 0;
-        }
-
-        /* shapes */
-        /* shapes break down into outlines, which break down into points. */
-        if (dst->geom->num_shapes) {
-            for (i = 0, dshape = dst->geom->shapes;
-                 i < dst->geom->num_shapes; i++, dshape++) {
-                for (j = 0, doutline = dshape->outlines;
-                     j < dshape->num_outlines; j++, doutline++) {
-                    if (doutline->sz_points)
-                        free(doutline->points);
-                }
-
-                if (dshape->sz_outlines) {
-                    free(dshape->outlines);
-                    dshape->outlines = NULL;
-                }
-
-                dshape->num_outlines = 0;
-                dshape->sz_outlines = 0;
-            }
-        }
-
-        if (src->geom->num_shapes) {
-            /* Reallocate and clear all items. */
-            if (!XkbGeomRealloc
-                ((void **) &dst->geom->shapes, dst->geom->sz_shapes,
-                 src->geom->num_shapes, sizeof(XkbShapeRec),
-                 XKB_GEOM_CLEAR_ALL))
-                return FALSE;
-
-            for (i = 0, sshape = src->geom->shapes, dshape = dst->geom->shapes;
-                 i < src->geom->num_shapes; i++, sshape++, dshape++) {
-                if (sshape->num_outlines) {
-                    tmp = calloc(sshape->num_outlines, sizeof(XkbOutlineRec));
-                    if (!tmp)
-                        return FALSE;
-                    dshape->outlines = tmp;
-
-                    for (j = 0,
-                         soutline = sshape->outlines,
-                         doutline = dshape->outlines;
-                         j < sshape->num_outlines;
-                         j++, soutline++, doutline++) {
-                        if (soutline->num_points) {
-                            tmp = malloc(soutline->num_points *
-                                         sizeof(XkbPointRec));
-                            if (!tmp)
-                                return FALSE;
-                            doutline->points = tmp;
-
-                            memcpy(doutline->points, soutline->points,
-                                   soutline->num_points * sizeof(XkbPointRec));
-
-                            doutline->corner_radius = soutline->corner_radius;
-                        }
-
-                        doutline->num_points = soutline->num_points;
-                        doutline->sz_points = soutline->num_points;
-                    }
-                }
-
-                dshape->num_outlines = sshape->num_outlines;
-                dshape->sz_outlines = sshape->num_outlines;
-                dshape->name = sshape->name;
-                dshape->bounds = sshape->bounds;
-
-                dshape->approx = NULL;
-                if (sshape->approx && sshape->num_outlines > 0) {
-
-                    const ptrdiff_t approx_idx =
-                        sshape->approx - sshape->outlines;
-
-                    if (approx_idx < dshape->num_outlines) {
-                        dshape->approx = dshape->outlines + approx_idx;
-                    }
-                    else {
-                        LogMessage(X_WARNING, "XKB: approx outline "
-                                   "index is out of range\n");
-                    }
-                }
-
-                dshape->primary = NULL;
-                if (sshape->primary && sshape->num_outlines > 0) {
-
-                    const ptrdiff_t primary_idx =
-                        sshape->primary - sshape->outlines;
-
-                    if (primary_idx < dshape->num_outlines) {
-                        dshape->primary = dshape->outlines + primary_idx;
-                    }
-                    else {
-                        LogMessage(X_WARNING, "XKB: primary outline "
-                                   "index is out of range\n");
-                    }
-                }
-            }
-
-            dst->geom->num_shapes = src->geom->num_shapes;
-            dst->geom->sz_shapes = src->geom->num_shapes;
-        }
-        else {
-            if (dst->geom->sz_shapes) {
-                free(dst->geom->shapes);
-            }
-            dst->geom->shapes = NULL;
-            dst->geom->num_shapes = 0;
-            dst->geom->sz_shapes = 0;
-        }
-
-        /* sections */
-        /* sections break down into doodads, and also into rows, which break
-         * down into keys. */
-        if (dst->geom->num_sections) {
-            for (i = 0, dsection = dst->geom->sections;
-                 i < dst->geom->num_sections; i++, dsection++) {
-                for (j = 0, drow = dsection->rows;
-                     j < dsection->num_rows; j++, drow++) {
-                    if (drow->num_keys)
-                        free(drow->keys);
-                }
-
-                if (dsection->num_rows)
-                    free(dsection->rows);
-
-                /* cut and waste from geom/doodad below. */
-                for (j = 0, ddoodad = dsection->doodads;
-                     j < dsection->num_doodads; j++, ddoodad++) {
-                    if (ddoodad->any.type == XkbTextDoodad) {
-                        free(ddoodad->text.text);
-                        ddoodad->text.text = NULL;
-                        free(ddoodad->text.font);
-                        ddoodad->text.font = NULL;
-                    }
-                    else if (ddoodad->any.type == XkbLogoDoodad) {
-                        free(ddoodad->logo.logo_name);
-                        ddoodad->logo.logo_name = NULL;
-                    }
-                }
-
-                free(dsection->doodads);
-            }
-
-            dst->geom->num_sections = 0;
-        }
-
-        if (src->geom->num_sections) {
-            /* Reallocate and clear all items. */
-            if (!XkbGeomRealloc
-                ((void **) &dst->geom->sections, dst->geom->sz_sections,
-                 src->geom->num_sections, sizeof(XkbSectionRec),
-                 XKB_GEOM_CLEAR_ALL))
-                return FALSE;
-            dst->geom->num_sections = src->geom->num_sections;
-            dst->geom->sz_sections = src->geom->num_sections;
-
-            for (i = 0,
-                 ssection = src->geom->sections,
-                 dsection = dst->geom->sections;
-                 i < src->geom->num_sections; i++, ssection++, dsection++) {
-                *dsection = *ssection;
-                if (ssection->num_rows) {
-                    tmp = calloc(ssection->num_rows, sizeof(XkbRowRec));
-                    if (!tmp)
-                        return FALSE;
-                    dsection->rows = tmp;
-                }
-                dsection->num_rows = ssection->num_rows;
-                dsection->sz_rows = ssection->num_rows;
-
-                for (j = 0, srow = ssection->rows, drow = dsection->rows;
-                     j < ssection->num_rows; j++, srow++, drow++) {
-                    if (srow->num_keys) {
-                        tmp = malloc(srow->num_keys * sizeof(XkbKeyRec));
-                        if (!tmp)
-                            return FALSE;
-                        drow->keys = tmp;
-                        memcpy(drow->keys, srow->keys,
-                               srow->num_keys * sizeof(XkbKeyRec));
-                    }
-                    drow->num_keys = srow->num_keys;
-                    drow->sz_keys = srow->num_keys;
-                    drow->top = srow->top;
-                    drow->left = srow->left;
-                    drow->vertical = srow->vertical;
-                    drow->bounds = srow->bounds;
-                }
-
-                if (ssection->num_doodads) {
-                    tmp = calloc(ssection->num_doodads, sizeof(XkbDoodadRec));
-                    if (!tmp)
-                        return FALSE;
-                    dsection->doodads = tmp;
-                }
-                else {
-                    dsection->doodads = NULL;
-                }
-
-                dsection->sz_doodads = ssection->num_doodads;
-                for (k = 0,
-                     sdoodad = ssection->doodads,
-                     ddoodad = dsection->doodads;
-                     k < ssection->num_doodads; k++, sdoodad++, ddoodad++) {
-                    memcpy(ddoodad, sdoodad, sizeof(XkbDoodadRec));
-                    if (sdoodad->any.type == XkbTextDoodad) {
-                        if (sdoodad->text.text)
-                            ddoodad->text.text = strdup(sdoodad->text.text);
-                        if (sdoodad->text.font)
-                            ddoodad->text.font = strdup(sdoodad->text.font);
-                    }
-                    else if (sdoodad->any.type == XkbLogoDoodad) {
-                        if (sdoodad->logo.logo_name)
-                            ddoodad->logo.logo_name =
-                                strdup(sdoodad->logo.logo_name);
-                    }
-                }
-                dsection->overlays = NULL;
-                dsection->sz_overlays = 0;
-                dsection->num_overlays = 0;
-            }
-        }
-        else {
-            if (dst->geom->sz_sections) {
-                free(dst->geom->sections);
-            }
-
-            dst->geom->sections = NULL;
-            dst->geom->num_sections = 0;
-            dst->geom->sz_sections = 0;
-        }
-
-        /* doodads */
-        if (dst->geom->num_doodads) {
-            for (i = src->geom->num_doodads,
-                 ddoodad = dst->geom->doodads +
-                 src->geom->num_doodads;
-                 i < dst->geom->num_doodads; i++, ddoodad++) {
-                if (ddoodad->any.type == XkbTextDoodad) {
-                    free(ddoodad->text.text);
-                    ddoodad->text.text = NULL;
-                    free(ddoodad->text.font);
-                    ddoodad->text.font = NULL;
-                }
-                else if (ddoodad->any.type == XkbLogoDoodad) {
-                    free(ddoodad->logo.logo_name);
-                    ddoodad->logo.logo_name = NULL;
-                }
-            }
-            dst->geom->num_doodads = 0;
-        }
-
-        if (src->geom->num_doodads) {
-            /* Reallocate and clear all items. */
-            if (!XkbGeomRealloc
-                ((void **) &dst->geom->doodads, dst->geom->sz_doodads,
-                 src->geom->num_doodads, sizeof(XkbDoodadRec),
-                 XKB_GEOM_CLEAR_ALL))
-                return FALSE;
-
-            dst->geom->sz_doodads = src->geom->num_doodads;
-
-            for (i = 0,
-                 sdoodad = src->geom->doodads,
-                 ddoodad = dst->geom->doodads;
-                 i < src->geom->num_doodads; i++, sdoodad++, ddoodad++) {
-                memcpy(ddoodad, sdoodad, sizeof(XkbDoodadRec));
-                if (sdoodad->any.type == XkbTextDoodad) {
-                    if (sdoodad->text.text)
-                        ddoodad->text.text = strdup(sdoodad->text.text);
-                    if (sdoodad->text.font)
-                        ddoodad->text.font = strdup(sdoodad->text.font);
-                }
-                else if (sdoodad->any.type == XkbLogoDoodad) {
-                    if (sdoodad->logo.logo_name)
-                        ddoodad->logo.logo_name =
-                            strdup(sdoodad->logo.logo_name);
-                }
-            }
-
-            dst->geom->num_doodads = dst->geom->sz_doodads;
-        }
-        else {
-            if (dst->geom->sz_doodads) {
-                free(dst->geom->doodads);
-            }
-
-            dst->geom->doodads = NULL;
-            dst->geom->num_doodads = 0;
-            dst->geom->sz_doodads = 0;
-        }
-
-        /* key aliases */
-        if (src->geom->num_key_aliases) {
-            /* Reallocate but don't clear any items. There is no need
-             * to clear anything because data is immediately copied
-             * over the whole memory area with memcpy. */
-            if (!XkbGeomRealloc
-                ((void **) &dst->geom->key_aliases, dst->geom->sz_key_aliases,
-                 src->geom->num_key_aliases, 2 * XkbKeyNameLength,
-                 XKB_GEOM_CLEAR_NONE))
-                return FALSE;
-
-            dst->geom->sz_key_aliases = src->geom->num_key_aliases;
-
-            memcpy(dst->geom->key_aliases, src->geom->key_aliases,
-                   src->geom->num_key_aliases * 2 * XkbKeyNameLength);
-
-            dst->geom->num_key_aliases = dst->geom->sz_key_aliases;
-        }
-        else {
-            free(dst->geom->key_aliases);
-            dst->geom->key_aliases = NULL;
-            dst->geom->num_key_aliases = 0;
-            dst->geom->sz_key_aliases = 0;
-        }
-
-        /* font */
-        if (src->geom->label_font) {
-            if (!dst->geom->label_font) {
-                tmp = malloc(strlen(src->geom->label_font) + 1);
-                if (!tmp)
-                    return FALSE;
-                dst->geom->label_font = tmp;
-            }
-            else if (strlen(src->geom->label_font) !=
-                     strlen(dst->geom->label_font)) {
-                tmp = realloc(dst->geom->label_font,
-                              strlen(src->geom->label_font) + 1);
-                if (!tmp)
-                    return FALSE;
-                dst->geom->label_font = tmp;
-            }
-
-            strcpy(dst->geom->label_font, src->geom->label_font);
-            i = XkbGeomColorIndex(src->geom, src->geom->label_color);
-            dst->geom->label_color = &(dst->geom->colors[i]);
-            i = XkbGeomColorIndex(src->geom, src->geom->base_color);
-            dst->geom->base_color = &(dst->geom->colors[i]);
-        }
-        else {
-            free(dst->geom->label_font);
-            dst->geom->label_font = NULL;
-            dst->geom->label_color = NULL;
-            dst->geom->base_color = NULL;
-        }
-
-        dst->geom->name = src->geom->name;
-        dst->geom->width_mm = src->geom->width_mm;
-        dst->geom->height_mm = src->geom->height_mm;
-    }
-    else {
-        if (dst->geom) {
-            /* I LOVE THE DIFFERENT CALL SIGNATURE.  REALLY, I DO. */
-            XkbFreeGeometry(dst->geom, XkbGeomAllMask, TRUE);
-            dst->geom = NULL;
-        }
+    if (src->geom != dst->geom) {
+        /* I LOVE THE DIFFERENT CALL SIGNATURE.  REALLY, I DO. */
+        XkbFreeGeometry(dst->geom, XkbGeomAllMask, TRUE);
+        dst->geom = XkbRefGeometry(src->geom);
     }
 
     return TRUE;
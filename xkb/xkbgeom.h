@@ -53,6 +53,7 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #define	XkbFreeGeomOutlines		SrvXkbFreeGeomOutlines
 #define XkbFreeGeomShapes		SrvXkbFreeGeomShapes
 #define XkbFreeGeometry			SrvXkbFreeGeometry
+#define XkbRefGeometry			SrvXkbRefGeometry
 
 typedef struct _XkbProperty {
     char *name;
@@ -280,6 +281,10 @@ typedef struct _XkbGeometry {
     XkbSectionPtr sections;
     XkbDoodadPtr doodads;
     XkbKeyAliasPtr key_aliases;
+    /* Geometry is never changed in place once loaded, only replaced, so
+     * keymaps copied from each other share it.  0 and 1 both mean a
+     * single owner. */
+    unsigned int refcnt;
 } XkbGeometryRec;
 
 #define	XkbGeomColorIndex(g,c)	((int)((c)-&(g)->colors[0]))
@@ -467,6 +472,10 @@ extern void
                  Bool           /* freeMap */
     );
 
+extern XkbGeometryPtr
+ XkbRefGeometry(XkbGeometryPtr /* geom */
+    );
+
 extern Bool
  XkbGeomRealloc(void ** /* buffer */ ,
                 int /* szItems */ ,